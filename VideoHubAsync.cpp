@@ -0,0 +1,402 @@
+﻿// VideoHubAsync.cpp
+// Compile as x64 with C++20 (coroutines). Uses Winsock. Implementation of VideoHubAsync.h.
+
+#include "VideoHubAsync.h"
+
+#pragma comment(lib, "Ws2_32.lib")
+
+HubLoop::~HubLoop() {
+    for (auto* hub : hubs_) {
+        CloseHubSession(hub->session);
+        hub->loop = nullptr;
+    }
+}
+
+// Brief comment: runs a spawned task and counts it as finished, also when it threw
+HubTask<> HubLoop::Own(HubLoop& loop, HubTask<> task) {
+    try {
+        co_await task;
+    }
+    catch (...) {
+    }
+    --loop.tasks_;
+}
+
+void HubLoop::spawn(HubTask<> task) {
+    ++tasks_;
+    auto h = Own(*this, std::move(task)).release();
+    h.promise().detached = true;
+    h.resume();
+}
+
+void HubLoop::run() {
+    stopped_ = false;
+    while (!stopped_ && tasks_ > 0) runOnce(50);
+}
+
+void HubLoop::attach(AsyncHub& hub) {
+    if (hub.loop == this) return;
+    hub.loop = this;
+    hubs_.push_back(&hub);
+}
+
+void HubLoop::remove(AsyncHub& hub) {
+    if (hub.loop != this) return;
+    failHub(hub);
+    hubs_.remove(&hub);
+    hub.loop = nullptr;
+}
+
+// --------------------- Connect ---------------------
+
+// Brief comment: drops the current connection and starts resolving the hub address
+void HubLoop::startConnect(AsyncHub& hub) {
+    failHub(hub);   // a reconnect ends the operations of the old connection
+    ResetHubSession(hub.session);
+    hub.addrs.clear();
+    hub.changes.clear();
+
+    ResolvedAddress literal;
+    if (ParseAddressLiteral(hub.session.ip, literal)) {
+        hub.addrs.push_back(literal);
+        tryNextAddress(hub);
+        return;
+    }
+    SharedHubResolver().prefetch(hub.session.ip);
+    hub.phase = AsyncHub::Phase::Resolving;
+}
+
+// Brief comment: starts a non-blocking connect to the next address, or gives up
+void HubLoop::tryNextAddress(AsyncHub& hub) {
+    while (!hub.addrs.empty()) {
+        ResolvedAddress a = hub.addrs.front();
+        hub.addrs.erase(hub.addrs.begin());
+        SetAddressPort(a, hub.session.port);
+        SOCKET s = socket(a.addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET) continue;
+        u_long nonBlocking = 1;
+        ioctlsocket(s, FIONBIO, &nonBlocking);
+        ::connect(s, (sockaddr*)&a.addr, a.len);
+        hub.session.sock = s;
+        hub.phase = AsyncHub::Phase::Connecting;
+        return;
+    }
+    connectDone(hub, false);
+}
+
+// Brief comment: ends a connect attempt and resumes everyone waiting for it
+void HubLoop::connectDone(AsyncHub& hub, bool ok) {
+    if (ok) {
+        hub.session.preludeDone = true;
+        hub.phase = AsyncHub::Phase::Ready;
+    }
+    else {
+        CloseHubSession(hub.session);
+        hub.phase = AsyncHub::Phase::Idle;
+    }
+    for (auto* w : hub.connectWaits) post(w);
+    hub.connectWaits.clear();
+}
+
+// Brief comment: connection lost or closed; fails every operation waiting for this hub
+void HubLoop::failHub(AsyncHub& hub) {
+    CloseHubSession(hub.session);
+    hub.phase = AsyncHub::Phase::Idle;
+    for (auto* w : hub.connectWaits) post(w);
+    hub.connectWaits.clear();
+    for (auto& slot : hub.acks)
+        if (slot.wait) post(slot.wait);
+    hub.acks.clear();
+    if (hub.changeWait) post(hub.changeWait);
+    hub.changeWait = nullptr;
+    hub.changeOut = nullptr;
+}
+
+void HubLoop::ConnectAwaiter::await_suspend(std::coroutine_handle<> h) {
+    handle = h;
+    deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    loop.attach(hub);
+    if (hub.phase == AsyncHub::Phase::Idle || hub.phase == AsyncHub::Phase::Ready) {
+        hub.connectDeadline = deadline;
+        loop.startConnect(hub);
+    }
+    if (hub.phase == AsyncHub::Phase::Idle) loop.post(this);   // failed at once (no usable address)
+    else hub.connectWaits.push_back(this);
+}
+
+// --------------------- Commands ---------------------
+
+bool HubLoop::SalvoAwaiter::await_ready() {
+    acked.clear();
+    if (!hub.ready()) return true;
+    if (!WriteSalvoBlocks(hub.session, blocks, sent)) {
+        loop.failHub(hub);
+        return true;
+    }
+    if (sent.empty()) {
+        ok = true;
+        return true;
+    }
+    HubAckSlot slot;
+    slot.expected = sent.size();
+    slot.acked.assign(sent.size(), false);
+    slot.ok = &ok;
+    slot.out = &acked;
+    hub.acks.push_back(std::move(slot));
+    return false;
+}
+
+void HubLoop::SalvoAwaiter::await_suspend(std::coroutine_handle<> h) {
+    handle = h;
+    deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    hub.acks.back().wait = this;
+}
+
+std::optional<std::vector<bool>> HubLoop::SalvoAwaiter::await_resume() {
+    if (!ok) return std::nullopt;
+    std::vector<bool> result(blocks.size(), false);
+    for (size_t n = 0; n < sent.size() && n < acked.size(); ++n) result[sent[n]] = acked[n];
+    return result;
+}
+
+bool HubLoop::ChangeAwaiter::await_ready() {
+    if (!hub.changes.empty()) {
+        block = std::move(hub.changes.front());
+        hub.changes.pop_front();
+        return true;
+    }
+    return !hub.ready() || hub.changeWait != nullptr;   // one waiter per hub
+}
+
+void HubLoop::ChangeAwaiter::await_suspend(std::coroutine_handle<> h) {
+    handle = h;
+    hub.changeWait = this;
+    hub.changeOut = &block;
+}
+
+void HubLoop::SleepAwaiter::await_suspend(std::coroutine_handle<> h) {
+    handle = h;
+    deadline = Clock::now() + std::chrono::milliseconds(ms);
+    loop.timers_.push({ deadline, this });
+}
+
+void HubLoop::subscribe(AsyncHub& hub) {
+    attach(hub);
+    hub.subscribed = true;
+}
+
+HubTask<std::optional<VideoHubState>> HubLoop::read(AsyncHub& hub, int timeoutMs) {
+    if (!hub.ready() && !co_await connect(hub, timeoutMs)) co_return std::nullopt;
+    VideoHubState state;
+    CopyHubContent(state, hub.session.mirror);
+    co_return state;
+}
+
+HubTask<std::optional<bool>> HubLoop::route(AsyncHub& hub, const RoutingLevel& level, std::map<int, int> routes,
+    int timeoutMs) {
+    std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>> blocks{ { &level, &routes } };
+    auto acked = co_await salvo(hub, std::move(blocks), timeoutMs);
+    if (!acked) co_return std::nullopt;
+    co_return (*acked)[0];
+}
+
+// -----------------------------------------------------------
+// Function: HubLoop::apply
+// Purpose:  ApplySalvoOnSession for the loop: the delta against the
+//           live mirror as one salvo, all levels set back on a NAK or
+//           timeout. Other hubs on the loop keep running meanwhile.
+// -----------------------------------------------------------
+HubTask<SalvoResult> HubLoop::apply(AsyncHub& hub, VideoHubState target, int timeoutMs) {
+    SalvoResult r;
+    if (!hub.ready()) co_return r;
+    r.levels = BuildSalvo(target, hub.session.mirror);
+    if (r.levels.empty()) {
+        r.answered = r.applied = true;
+        co_return r;
+    }
+
+    std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>> blocks;
+    for (auto& sl : r.levels) blocks.push_back({ sl.level, &sl.routes });
+    auto t0 = Clock::now();
+    auto acked = co_await salvo(hub, blocks, timeoutMs);
+    r.ackMs = ElapsedMs(t0, Clock::now());
+    r.answered = acked.has_value();
+    if (acked)
+        for (size_t i = 0; i < r.levels.size(); ++i) r.levels[i].acked = (*acked)[i];
+    r.applied = r.answered && std::all_of(acked->begin(), acked->end(), [](bool a) { return a; });
+    if (r.applied || !hub.ready()) co_return r;
+
+    // Rollback: all levels, also the rejected ones (a hub may have taken part of a block)
+    blocks.clear();
+    for (auto& sl : r.levels) blocks.push_back({ sl.level, &sl.previous });
+    auto back = co_await salvo(hub, blocks, timeoutMs);
+    r.rolledBack = back && std::all_of(back->begin(), back->end(), [](bool a) { return a; });
+    co_return r;
+}
+
+// --------------------- Loop iteration ---------------------
+
+// Brief comment: ACK/NAK to the oldest salvo, anything else to the mirror (and subscriber)
+void HubLoop::handleBlock(AsyncHub& hub, HubBlock& b) {
+    Clock::time_point stamp;
+    bool acked = false;
+    if (PopHubAck(hub.session, b, stamp, acked)) {
+        if (hub.acks.empty()) return;   // answer to a command sent outside the loop
+        HubAckSlot& slot = hub.acks.front();
+        slot.acked[slot.answered++] = acked;
+        if (slot.answered < slot.expected) return;
+        if (slot.wait) {
+            *slot.ok = true;
+            *slot.out = std::move(slot.acked);
+            post(slot.wait);
+        }
+        hub.acks.pop_front();
+        return;
+    }
+
+    bool inPrelude = !hub.session.preludeDone;
+    ApplyBlockToMirror(hub.session, b);
+    if (inPrelude) {
+        if (hub.session.preludeDone && hub.phase == AsyncHub::Phase::Prelude) connectDone(hub, true);
+        return;
+    }
+    if (!hub.subscribed) return;
+    if (hub.changeWait) {
+        *hub.changeOut = std::move(b);
+        post(hub.changeWait);
+        hub.changeWait = nullptr;
+        hub.changeOut = nullptr;
+    }
+    else {
+        hub.changes.push_back(std::move(b));
+    }
+}
+
+// Brief comment: reads available data and handles the complete blocks
+void HubLoop::readHub(AsyncHub& hub) {
+    if (!ReadIntoSession(hub.session)) {
+        if (hub.phase == AsyncHub::Phase::Prelude) connectDone(hub, false);
+        failHub(hub);
+        return;
+    }
+    HubBlock b;
+    while (hub.session.connected() && hub.session.reader.next(b)) handleBlock(hub, b);
+}
+
+// Brief comment: connect deadlines, salvo timeouts and due sleeps
+void HubLoop::checkTimeouts(Clock::time_point now) {
+    for (auto* hub : hubs_) {
+        bool connecting = hub->phase == AsyncHub::Phase::Resolving || hub->phase == AsyncHub::Phase::Connecting ||
+            hub->phase == AsyncHub::Phase::Prelude;
+        if (connecting && now >= hub->connectDeadline) {
+            // old firmware without END PRELUDE: the routing is enough (as OpenHubSession)
+            connectDone(*hub, hub->phase == AsyncHub::Phase::Prelude && !hub->session.mirror.routing.empty());
+        }
+        auto& waits = hub->connectWaits;
+        for (auto it = waits.begin(); it != waits.end();) {
+            if (now >= (*it)->deadline) {
+                post(*it);
+                it = waits.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        for (auto& slot : hub->acks) {
+            if (slot.wait && now >= slot.wait->deadline) {
+                post(slot.wait);
+                slot.wait = nullptr;   // later answers are still consumed in order
+            }
+        }
+    }
+    while (!timers_.empty() && timers_.top().at <= now) {
+        post(timers_.top().wait);
+        timers_.pop();
+    }
+}
+
+// Brief comment: earliest time the loop has to wake up without socket activity
+Clock::time_point HubLoop::nextDeadline() const {
+    auto next = timers_.empty() ? Clock::time_point::max() : timers_.top().at;
+    for (auto* hub : hubs_) {
+        if (hub->phase == AsyncHub::Phase::Resolving)
+            next = std::min(next, Clock::now() + std::chrono::milliseconds(5));   // poll the resolver
+        if (hub->phase != AsyncHub::Phase::Idle && hub->phase != AsyncHub::Phase::Ready)
+            next = std::min(next, hub->connectDeadline);
+        for (auto* w : hub->connectWaits) next = std::min(next, w->deadline);
+        for (auto& slot : hub->acks)
+            if (slot.wait) next = std::min(next, slot.wait->deadline);
+    }
+    return next;
+}
+
+// -----------------------------------------------------------
+// Function: HubLoop::runOnce
+// Purpose:  One iteration: resolver results, one WSAPoll over all hub
+//           sockets, socket events, timeouts, then the coroutines that
+//           became ready are resumed (they may start new operations,
+//           which the next iteration picks up).
+// -----------------------------------------------------------
+void HubLoop::runOnce(int maxWaitMs) {
+    for (auto* hub : hubs_) {
+        if (hub->phase != AsyncHub::Phase::Resolving) continue;
+        bool failed = false;
+        if (!SharedHubResolver().tryGet(hub->session.ip, hub->addrs, failed)) continue;
+        if (failed) connectDone(*hub, false);
+        else tryNextAddress(*hub);
+    }
+
+    std::vector<WSAPOLLFD> fds;
+    std::vector<AsyncHub*> polled;
+    for (auto* hub : hubs_) {
+        if (!hub->session.connected()) continue;
+        WSAPOLLFD fd{};
+        fd.fd = hub->session.sock;
+        fd.events = hub->phase == AsyncHub::Phase::Connecting ? POLLWRNORM : POLLRDNORM;
+        fds.push_back(fd);
+        polled.push_back(hub);
+    }
+
+    int waitMs = maxWaitMs;
+    if (!resumable_.empty()) waitMs = 0;
+    auto next = nextDeadline();
+    if (next != Clock::time_point::max()) {
+        auto until = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+        waitMs = static_cast<int>(std::max<long long>(0, std::min<long long>(waitMs, until)));
+    }
+    if (fds.empty()) {
+        if (waitMs > 0) Sleep(waitMs);
+    }
+    else if (WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), waitMs) > 0) {
+        for (size_t i = 0; i < fds.size(); ++i) {
+            AsyncHub& hub = *polled[i];
+            short re = fds[i].revents;
+            if (!re || !hub.session.connected() || hub.session.sock != fds[i].fd) continue;
+            if (hub.phase == AsyncHub::Phase::Connecting) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                if ((re & (POLLERR | POLLHUP)) ||
+                    getsockopt(hub.session.sock, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0 || err != 0) {
+                    CloseHubSession(hub.session);
+                    tryNextAddress(hub);
+                    continue;
+                }
+                u_long blocking = 0;
+                ioctlsocket(hub.session.sock, FIONBIO, &blocking);
+                int noDelay = 1;
+                setsockopt(hub.session.sock, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+                hub.session.lastReceived = Clock::now();
+                hub.phase = AsyncHub::Phase::Prelude;
+            }
+            else {
+                readHub(hub);
+            }
+        }
+    }
+
+    checkTimeouts(Clock::now());
+
+    std::vector<HubWait*> ready;
+    ready.swap(resumable_);
+    for (auto* w : ready) w->handle.resume();
+}
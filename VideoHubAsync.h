@@ -0,0 +1,305 @@
+﻿// VideoHubAsync.h
+// Compile as x64 with C++20 (coroutines). Uses Winsock. Asynchronous client API on top of VideoHubCore.
+
+/*
+===============================================================================
+Videohub async client (coroutines)
+===============================================================================
+
+Description:
+The core API is blocking: OpenHubSession, FetchHubState and
+ApplySalvoOnSession keep the calling thread until the hub answered, so
+orchestrating many hubs needs a thread per hub. HubLoop runs any number
+of hubs on one thread instead. Connect, read, apply, salvo and
+subscribe are C++20 awaitables; a sequence over many hubs is written as
+straight-line code and the loop interleaves thousands of them.
+
+   HubTask<> Recall(HubLoop& loop, AsyncHub& hub, VideoHubState preset) {
+       if (!co_await loop.connect(hub)) co_return;
+       SalvoResult r = co_await loop.apply(hub, preset);
+       ...
+   }
+   loop.spawn(Recall(loop, hub, preset));
+   loop.run();
+
+Operation:
+- one WSAPoll over all hub sockets per loop iteration (no FD_SETSIZE
+  limit); connects are non-blocking, host names go through the shared
+  resolver cache without blocking
+- ACK/NAK answers are matched to the waiting operation in send order;
+  all other blocks update the live mirror of the hub
+- coroutines are resumed by run() on the loop thread only. Run one loop
+  per thread to use more cores; a hub belongs to one loop.
+- timeouts end the operation, not the connection: late answers are
+  still consumed in order
+- Winsock must be initialized by the caller
+
+Version: 1.0
+===============================================================================
+*/
+
+#pragma once
+
+#include "VideoHubCore.h"
+
+#include <coroutine>
+#include <exception>
+#include <list>
+#include <optional>
+#include <queue>
+
+// --------------------- Tasks ---------------------
+
+// Brief comment: promise parts shared by all HubTask types
+struct HubTaskPromiseBase {
+    std::coroutine_handle<> continuation;   // coroutine that awaits this task
+    std::exception_ptr error;
+    bool detached = false;                  // owned by the loop (spawn), destroys itself at the end
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+            HubTaskPromiseBase& p = h.promise();
+            if (p.continuation) return p.continuation;
+            if (p.detached) h.destroy();
+            return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+};
+
+template <typename T>
+struct HubTaskResult {
+    std::optional<T> value;
+    void return_value(T v) { value = std::move(v); }
+    T take() { return std::move(*value); }
+};
+
+template <>
+struct HubTaskResult<void> {
+    void return_void() {}
+    void take() {}
+};
+
+// -----------------------------------------------------------
+// Class: HubTask
+// Purpose:  Coroutine result type. A task starts when it is awaited
+//           (co_await task) or handed to HubLoop::spawn, and resumes
+//           its awaiter when it finishes. Exceptions are passed on to
+//           the awaiter; a spawned task drops them.
+// -----------------------------------------------------------
+template <typename T = void>
+class [[nodiscard]] HubTask {
+public:
+    struct promise_type : HubTaskPromiseBase, HubTaskResult<T> {
+        HubTask get_return_object() { return HubTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+    };
+
+    HubTask(HubTask&& other) noexcept : h_(std::exchange(other.h_, {})) {}
+    HubTask& operator=(HubTask&& other) noexcept {
+        if (this != &other) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    HubTask(const HubTask&) = delete;
+    HubTask& operator=(const HubTask&) = delete;
+    ~HubTask() { if (h_) h_.destroy(); }
+
+    bool await_ready() const noexcept { return !h_ || h_.done(); }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        h_.promise().continuation = awaiting;
+        return h_;
+    }
+    T await_resume() {
+        if (h_.promise().error) std::rethrow_exception(h_.promise().error);
+        return h_.promise().take();
+    }
+
+    // Brief comment: hands the coroutine to the caller (HubLoop::spawn); the task is empty afterwards
+    std::coroutine_handle<promise_type> release() { return std::exchange(h_, {}); }
+
+private:
+    explicit HubTask(std::coroutine_handle<promise_type> h) : h_(h) {}
+    std::coroutine_handle<promise_type> h_;
+};
+
+// --------------------- Loop ---------------------
+
+class HubLoop;
+
+// Brief comment: an operation waiting in the loop (connect, answers, change, sleep)
+struct HubWait {
+    std::coroutine_handle<> handle;
+    Clock::time_point deadline = Clock::time_point::max();
+};
+
+// Brief comment: answers still expected for one salvo, in send order
+struct HubAckSlot {
+    size_t expected = 0;
+    size_t answered = 0;
+    std::vector<bool> acked;             // per sent block
+    HubWait* wait = nullptr;             // nullptr once the operation timed out
+    bool* ok = nullptr;                  // set when all answers arrived
+    std::vector<bool>* out = nullptr;    // receives acked
+};
+
+// -----------------------------------------------------------
+// Struct: AsyncHub
+// Purpose:  One hub on a HubLoop: the core session with its live
+//           mirror, plus the operations that wait for it.
+// Notes:    Set session.ip / session.port before the first connect.
+//           Keep the object alive (and at the same address) while the
+//           loop knows it; HubLoop::remove detaches it.
+// -----------------------------------------------------------
+struct AsyncHub {
+    HubSession session;
+
+    enum class Phase { Idle, Resolving, Connecting, Prelude, Ready };
+    Phase phase = Phase::Idle;
+    Clock::time_point connectDeadline;
+    std::vector<ResolvedAddress> addrs;       // addresses still to try
+    std::vector<HubWait*> connectWaits;
+    std::deque<HubAckSlot> acks;
+    bool subscribed = false;                  // keep changed blocks for nextChange
+    std::deque<HubBlock> changes;
+    HubWait* changeWait = nullptr;
+    std::optional<HubBlock>* changeOut = nullptr;
+    HubLoop* loop = nullptr;
+
+    bool ready() const { return phase == Phase::Ready && session.connected(); }
+};
+
+// -----------------------------------------------------------
+// Class: HubLoop
+// Purpose:  Single-threaded event loop for many hubs and the
+//           coroutines that drive them.
+// Usage:    spawn() tasks, then run() until they finished (or stop()).
+//           The awaitables must be awaited from a task of this loop.
+// -----------------------------------------------------------
+class HubLoop {
+public:
+    HubLoop() = default;
+    HubLoop(const HubLoop&) = delete;
+    HubLoop& operator=(const HubLoop&) = delete;
+    ~HubLoop();   // closes the hubs; tasks that did not finish are abandoned
+
+    // Brief comment: starts a task; it runs on this loop until it finishes
+    void spawn(HubTask<> task);
+
+    // Brief comment: runs until all spawned tasks finished or stop() was called
+    void run();
+
+    // Brief comment: one loop iteration, waiting at most maxWaitMs for sockets or timers
+    void runOnce(int maxWaitMs = 50);
+
+    void stop() { stopped_ = true; }
+
+    // Brief comment: number of spawned tasks that did not finish yet
+    size_t activeTasks() const { return tasks_; }
+
+    // Brief comment: closes the hub's connection and fails its waiting operations
+    void remove(AsyncHub& hub);
+
+    // --------------------- Awaitables ---------------------
+
+    struct ConnectAwaiter : HubWait {
+        HubLoop& loop;
+        AsyncHub& hub;
+        int timeoutMs;
+        bool await_ready() const noexcept { return hub.ready(); }
+        void await_suspend(std::coroutine_handle<> h);
+        bool await_resume() const noexcept { return hub.ready(); }
+    };
+
+    struct SalvoAwaiter : HubWait {
+        HubLoop& loop;
+        AsyncHub& hub;
+        std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>> blocks;
+        int timeoutMs;
+        std::vector<size_t> sent;  // index into blocks per expected answer
+        std::vector<bool> acked;   // per entry of sent
+        bool ok = false;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        std::optional<std::vector<bool>> await_resume();
+    };
+
+    struct ChangeAwaiter : HubWait {
+        HubLoop& loop;
+        AsyncHub& hub;
+        std::optional<HubBlock> block;
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        std::optional<HubBlock> await_resume() { return std::move(block); }
+    };
+
+    struct SleepAwaiter : HubWait {
+        HubLoop& loop;
+        int ms;
+        bool await_ready() const noexcept { return ms <= 0; }
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+    };
+
+    // Brief comment: connects (or reconnects) and waits for the prelude; true when the hub is ready
+    ConnectAwaiter connect(AsyncHub& hub, int timeoutMs = 3000) { return { {}, *this, hub, timeoutMs }; }
+
+    // Brief comment: the hub's labels and routing of all levels (connects first when needed)
+    HubTask<std::optional<VideoHubState>> read(AsyncHub& hub, int timeoutMs = 3000);
+
+    // Brief comment: sends one routing block per level in one write; acked per block,
+    //                nullopt when not all answers arrived in time or the connection was lost
+    SalvoAwaiter salvo(AsyncHub& hub, std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>> blocks,
+        int timeoutMs = 2000) {
+        return { {}, *this, hub, std::move(blocks), timeoutMs };
+    }
+
+    // Brief comment: routes of one level, one block (for single takes)
+    HubTask<std::optional<bool>> route(AsyncHub& hub, const RoutingLevel& level, std::map<int, int> routes,
+        int timeoutMs = 2000);
+
+    // Brief comment: takes the routing of all levels of target as one salvo with rollback
+    //                (the async form of ApplySalvoOnSession)
+    HubTask<SalvoResult> apply(AsyncHub& hub, VideoHubState target, int timeoutMs = 2000);
+
+    // Brief comment: starts keeping the blocks that change the hub's mirror for nextChange
+    void subscribe(AsyncHub& hub);
+
+    // Brief comment: next block that changed the mirror (after subscribe); nullopt when the connection is lost
+    ChangeAwaiter nextChange(AsyncHub& hub) { return { {}, *this, hub, std::nullopt }; }
+
+    SleepAwaiter sleep(int ms) { return { {}, *this, ms }; }
+
+private:
+    void attach(AsyncHub& hub);
+    void startConnect(AsyncHub& hub);
+    void tryNextAddress(AsyncHub& hub);
+    void connectDone(AsyncHub& hub, bool ok);
+    void failHub(AsyncHub& hub);
+    void readHub(AsyncHub& hub);
+    void handleBlock(AsyncHub& hub, HubBlock& b);
+    void checkTimeouts(Clock::time_point now);
+    void post(HubWait* w) { resumable_.push_back(w); }
+    Clock::time_point nextDeadline() const;
+
+    static HubTask<> Own(HubLoop& loop, HubTask<> task);
+
+    struct Timer {
+        Clock::time_point at;
+        HubWait* wait;
+        bool operator>(const Timer& o) const { return at > o.at; }
+    };
+
+    std::list<AsyncHub*> hubs_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer>> timers_;   // sleeps only
+    std::vector<HubWait*> resumable_;
+    size_t tasks_ = 0;
+    bool stopped_ = false;
+};
@@ -0,0 +1,1748 @@
+﻿// VideoHubCore.cpp
+// Compile as x64 with C++17. Uses Winsock. Implementation of VideoHubCore.h (no console I/O).
+
+#include "VideoHubCore.h"
+
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#pragma comment(lib, "Ws2_32.lib")
+namespace fs = std::filesystem;
+
+// --------------------- Routing levels ---------------------
+
+// Brief comment: true for the video level (always present, stored under the original preset keys)
+bool IsVideoLevel(const RoutingLevel& level) {
+    return level.routing == &VideoHubState::routing;
+}
+
+// Brief comment: routing level of a routing block header, or nullptr
+const RoutingLevel* FindRoutingLevel(const std::string& header) {
+    for (auto& level : kRoutingLevels)
+        if (header == level.routingHeader) return &level;
+    return nullptr;
+}
+
+// Brief comment: routing level of an output labels block header, or nullptr
+const RoutingLevel* FindLabelsLevel(const std::string& header) {
+    for (auto& level : kRoutingLevels)
+        if (header == level.labelsHeader) return &level;
+    return nullptr;
+}
+
+// Brief comment: copies what was read from a hub (labels and routing of all levels),
+//                leaving description and filename alone
+void CopyHubContent(VideoHubState& dst, const VideoHubState& src) {
+    dst.inputLabels = src.inputLabels;
+    for (auto& level : kRoutingLevels) {
+        dst.*level.routing = src.*level.routing;
+        dst.*level.outputLabels = src.*level.outputLabels;
+    }
+    dst.serialDirections = src.serialDirections;
+    dst.serialLocks = src.serialLocks;
+    dst.configuration = src.configuration;
+    dst.alarms = src.alarms;
+}
+
+
+// --------------------- String / network helpers ---------------------
+
+// Brief comment: wrapper to use std::string IP address with inet_pton
+int inet_pton_wrap(int af, const std::string& src, void* dst) {
+    return inet_pton(af, src.c_str(), dst);
+}
+
+// Brief comment: checks if a string is a valid IPv4 address
+bool IsValidIPv4(const std::string& ip) {
+    sockaddr_in sa{};
+    return inet_pton_wrap(AF_INET, ip, &sa.sin_addr) == 1;
+}
+
+
+// --------------------- JSON helpers ---------------------
+
+// Brief comment: makes a string JSON-safe by escaping special characters
+std::string escapeJson(const std::string& s) {
+    std::ostringstream o;
+    for (char c : s) {
+        switch (c) {
+        case '\"': o << "\\\""; break;
+        case '\\': o << "\\\\"; break;
+        case '\n': o << "\\n"; break;
+        default: o << c; break;
+        }
+    }
+    return o.str();
+}
+
+// -----------------------------------------------------------
+// Function: SavePreset
+// Purpose:  Saves the current VideoHubState to a JSON file.
+// Params:
+//   filename = name of the file where the preset will be saved
+//   state    = VideoHubState struct with inputs, outputs, routing and description
+// Process:
+//   1. Opens the file for writing (ofstream)
+//   2. Writes the "description" (using escapeJson)
+//   3. Writes the routing table (output -> input)
+//   4. Writes the input labels (key -> value, using escapeJson)
+//   5. Writes the output labels (key -> value, using escapeJson)
+//   6. Writes further routing levels (monitoring, serial) with their
+//      labels, and the serial port directions, only when the hub has them
+//   7. Closes the JSON object properly with braces
+// Return:   false when the file cannot be opened or written
+// Notes:
+//   - escapeJson is used to safely escape special characters
+//   - The JSON is indented for readability
+// -----------------------------------------------------------
+bool SavePreset(const std::string& filename, const VideoHubState& state) {
+    std::ofstream f(filename);
+    if (!f) return false;
+
+    f << "{\n";
+    f << "  \"description\": \"" << escapeJson(state.description) << "\",\n";
+
+    f << "  \"routing\": {\n";
+    bool first = true;
+    for (auto& kv : state.routing) {
+        if (!first) f << ",\n";
+        f << "    \"" << kv.first << "\": " << kv.second;
+        first = false;
+    }
+    f << "\n  },\n";
+
+    f << "  \"inputs\": {\n";
+    first = true;
+    for (auto& kv : state.inputLabels) {
+        if (!first) f << ",\n";
+        f << "    \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
+        first = false;
+    }
+    f << "\n  },\n";
+
+    f << "  \"outputs\": {\n";
+    first = true;
+    for (auto& kv : state.outputLabels) {
+        if (!first) f << ",\n";
+        f << "    \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
+        first = false;
+    }
+    f << "\n  }";
+
+    for (auto& level : kRoutingLevels) {
+        if (IsVideoLevel(level) || (state.*level.routing).empty()) continue;
+        f << ",\n  \"" << level.routingKey << "\": {\n";
+        first = true;
+        for (auto& kv : state.*level.routing) {
+            if (!first) f << ",\n";
+            f << "    \"" << kv.first << "\": " << kv.second;
+            first = false;
+        }
+        f << "\n  },\n  \"" << level.labelsKey << "\": {\n";
+        first = true;
+        for (auto& kv : state.*level.outputLabels) {
+            if (!first) f << ",\n";
+            f << "    \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
+            first = false;
+        }
+        f << "\n  }";
+    }
+
+    if (!state.serialDirections.empty()) {
+        f << ",\n  \"serialDirections\": {\n";
+        first = true;
+        for (auto& kv : state.serialDirections) {
+            if (!first) f << ",\n";
+            f << "    \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
+            first = false;
+        }
+        f << "\n  }";
+    }
+
+    f << "\n}\n";
+    return static_cast<bool>(f);
+}
+
+// Brief comment: parses the routing object "key": { "out": in, ... } of a preset file
+void ParsePresetRouting(const std::string& json, const std::string& key, std::map<int, int>& routing) {
+    size_t rpos = json.find("\"" + key + "\"");
+    if (rpos == std::string::npos) return;
+    size_t b1 = json.find('{', rpos);
+    size_t b2 = json.find('}', b1);
+    std::string block = json.substr(b1 + 1, b2 - b1 - 1);
+    std::istringstream iss(block);
+    std::string line;
+    while (std::getline(iss, line, ',')) {
+        size_t q1 = line.find('"');
+        size_t q2 = line.find('"', q1 + 1);
+        if (q1 != std::string::npos && q2 != std::string::npos) {
+            int outIdx = std::stoi(line.substr(q1 + 1, q2 - q1 - 1));
+            size_t colon = line.find(':', q2);
+            if (colon != std::string::npos) {
+                int inIdx = std::stoi(line.substr(colon + 1));
+                routing[outIdx] = inIdx;
+            }
+        }
+    }
+}
+
+// Brief comment: parses the label object "key": { "idx": "name", ... } of a preset file
+void ParsePresetLabels(const std::string& json, const std::string& key, std::map<int, std::string>& labels) {
+    size_t pos = json.find("\"" + key + "\"");
+    if (pos == std::string::npos) return;
+    size_t b1 = json.find('{', pos);
+    size_t b2 = json.find('}', b1);
+    std::string block = json.substr(b1 + 1, b2 - b1 - 1);
+    std::istringstream iss(block);
+    std::string line;
+    while (std::getline(iss, line, ',')) {
+        size_t q1 = line.find('"');
+        size_t q2 = line.find('"', q1 + 1);
+        if (q1 != std::string::npos && q2 != std::string::npos) {
+            int idx = std::stoi(line.substr(q1 + 1, q2 - q1 - 1));
+            size_t q3 = line.find('"', q2 + 1);
+            size_t q4 = line.find('"', q3 + 1);
+            if (q3 != std::string::npos && q4 != std::string::npos) {
+                std::string name = line.substr(q3 + 1, q4 - q3 - 1);
+                labels[idx] = name;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------
+// Function: LoadPreset
+// Purpose:  Loads a VideoHub preset from a JSON file into a VideoHubState struct.
+// Params:
+//   filename = name of the JSON file containing the preset
+//   state    = reference to the VideoHubState struct to be populated
+// Return:  true  -> preset successfully loaded
+//          false -> error opening the file
+// Process:
+//   1. Open the file and read its contents into a string
+//   2. Reset the struct (description, routing, inputLabels, outputLabels)
+//   3. Manually parse the JSON:
+//        - description
+//        - routing table (output -> input)
+//        - input labels (key -> name)
+//        - output labels (key -> name)
+//        - monitoring routing and labels (if present)
+//   4. Set state.filename to the used filename
+// Notes:
+//   - This is a simple JSON parser, no external library
+//   - Expects a strict JSON format as produced by SavePreset
+// -----------------------------------------------------------
+bool LoadPreset(const std::string& filename, VideoHubState& state) {
+    std::ifstream f(filename);
+    if (!f) return false;
+
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    std::string json = buffer.str();
+
+    state.description.clear();
+    state.inputLabels.clear();
+    for (auto& level : kRoutingLevels) {
+        (state.*level.routing).clear();
+        (state.*level.outputLabels).clear();
+    }
+    state.serialDirections.clear();
+    state.serialLocks.clear();
+    state.configuration.clear();
+    state.alarms.clear();
+
+    // Description
+    size_t dpos = json.find("\"description\"");
+    if (dpos != std::string::npos) {
+        size_t q1 = json.find('"', dpos + 13);
+        size_t q2 = json.find('"', q1 + 1);
+        if (q1 != std::string::npos && q2 != std::string::npos)
+            state.description = json.substr(q1 + 1, q2 - q1 - 1);
+    }
+
+    // Routing table and labels, then further routing levels (monitoring, serial)
+    ParsePresetRouting(json, "routing", state.routing);
+    ParsePresetLabels(json, "inputs", state.inputLabels);
+    ParsePresetLabels(json, "outputs", state.outputLabels);
+    for (auto& level : kRoutingLevels) {
+        if (IsVideoLevel(level)) continue;
+        ParsePresetRouting(json, level.routingKey, state.*level.routing);
+        ParsePresetLabels(json, level.labelsKey, state.*level.outputLabels);
+    }
+    ParsePresetLabels(json, "serialDirections", state.serialDirections);
+
+    state.filename = filename;
+    return true;
+}
+
+
+// --------------------- Send helper ---------------------
+
+// Brief comment: sends all bytes of a buffer through a socket
+bool sendAll(SOCKET s, const std::vector<unsigned char>& data) {
+    const char* ptr = reinterpret_cast<const char*>(data.data());
+    int remaining = (int)data.size();
+    while (remaining > 0) {
+        int sent = send(s, ptr, remaining, 0);
+        if (sent == SOCKET_ERROR) return false;
+        remaining -= sent;
+        ptr += sent;
+    }
+    return true;
+}
+
+// --------------------- Address resolution ---------------------
+// Hubs can be addressed by IPv4 literal, IPv6 literal (optionally in
+// [brackets]) or host name. Literals are parsed directly; host names
+// are resolved with getaddrinfo on a background thread and cached, so
+// loops that manage many hubs never block on a lookup: they start all
+// lookups at once (prefetch) and connect when a result is ready.
+
+
+// Brief comment: milliseconds between two time points
+double ElapsedMs(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+
+// Brief comment: removes [] around an IPv6 literal
+std::string StripAddressBrackets(const std::string& host) {
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+        return host.substr(1, host.size() - 2);
+    return host;
+}
+
+// Brief comment: parses an IPv4 or IPv6 literal; false for host names
+bool ParseAddressLiteral(const std::string& host, ResolvedAddress& out) {
+    std::string h = StripAddressBrackets(host);
+    out = ResolvedAddress{};
+    auto* v4 = reinterpret_cast<sockaddr_in*>(&out.addr);
+    if (inet_pton_wrap(AF_INET, h, &v4->sin_addr) == 1) {
+        v4->sin_family = AF_INET;
+        out.len = sizeof(sockaddr_in);
+        return true;
+    }
+    auto* v6 = reinterpret_cast<sockaddr_in6*>(&out.addr);
+    if (inet_pton_wrap(AF_INET6, h, &v6->sin6_addr) == 1) {
+        v6->sin6_family = AF_INET6;
+        out.len = sizeof(sockaddr_in6);
+        return true;
+    }
+    return false;
+}
+
+// Brief comment: sets the TCP port of a resolved address
+void SetAddressPort(ResolvedAddress& a, int port) {
+    if (a.addr.ss_family == AF_INET6)
+        reinterpret_cast<sockaddr_in6*>(&a.addr)->sin6_port = htons(static_cast<u_short>(port));
+    else
+        reinterpret_cast<sockaddr_in*>(&a.addr)->sin_port = htons(static_cast<u_short>(port));
+}
+
+// Brief comment: checks if a string is a usable hub address (IPv4, IPv6 or host name)
+bool IsValidHubAddress(const std::string& host) {
+    ResolvedAddress a;
+    if (ParseAddressLiteral(host, a)) return true;
+    if (host.empty() || host.size() > 253 || host.front() == '-' || host.front() == '.') return false;
+    bool hasLetter = false;
+    for (char c : host) {
+        if (std::isalpha(static_cast<unsigned char>(c))) hasLetter = true;
+        else if (!std::isdigit(static_cast<unsigned char>(c)) && c != '-' && c != '.') return false;
+    }
+    return hasLetter; // all-digit strings are malformed IPv4, not names
+}
+
+// Brief comment: splits "host", "host:port", "[v6]:port" or a bare IPv6 literal;
+//                port keeps its value when none is given
+bool SplitHubAddress(const std::string& spec, std::string& host, int& port) {
+    std::string portText;
+    host = spec;
+    if (!spec.empty() && spec[0] == '[') {
+        size_t close = spec.find(']');
+        if (close == std::string::npos) return false;
+        host = spec.substr(1, close - 1);
+        if (close + 1 < spec.size()) {
+            if (spec[close + 1] != ':') return false;
+            portText = spec.substr(close + 2);
+        }
+    }
+    else if (std::count(spec.begin(), spec.end(), ':') == 1) {
+        size_t colon = spec.find(':');
+        host = spec.substr(0, colon);
+        portText = spec.substr(colon + 1);
+    }
+    if (!portText.empty()) {
+        if (portText.size() > 5 || !std::all_of(portText.begin(), portText.end(), ::isdigit)) return false;
+        port = std::stoi(portText);
+    }
+    return IsValidHubAddress(host) && port > 0 && port <= 65535;
+}
+
+
+// Brief comment: process-wide host name cache (see HubResolver); created on first use
+HubResolver& SharedHubResolver() {
+    static HubResolver resolver;
+    return resolver;
+}
+
+// -----------------------------------------------------------
+// Function: ConnectToHub
+// Purpose:  Opens a TCP connection (IPv4 or IPv6, literal or host
+//           name) with a connect timeout per address.
+// Return:   connected socket, or INVALID_SOCKET on failure
+// Notes:
+//   - Nagle is disabled: command blocks are small and latency matters.
+//   - Host names are resolved through resolver (waits at most
+//     timeoutMs when the name is not cached yet).
+//   - Winsock must already be initialized by the caller.
+// -----------------------------------------------------------
+SOCKET ConnectToHub(const std::string& host, int port, int timeoutMs, HubResolver& resolver) {
+    std::vector<ResolvedAddress> addrs;
+    if (!resolver.resolve(host, addrs, timeoutMs)) return INVALID_SOCKET;
+
+    for (auto a : addrs) {
+        SetAddressPort(a, port);
+        SOCKET s = socket(a.addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET) continue;
+
+        u_long nonBlocking = 1;
+        ioctlsocket(s, FIONBIO, &nonBlocking);
+        connect(s, (sockaddr*)&a.addr, a.len);
+
+        fd_set writefds, exceptfds;
+        FD_ZERO(&writefds);
+        FD_ZERO(&exceptfds);
+        FD_SET(s, &writefds);
+        FD_SET(s, &exceptfds);
+        timeval tv;
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+        int sel = select((int)s + 1, NULL, &writefds, &exceptfds, &tv);
+
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (sel <= 0 || !FD_ISSET(s, &writefds) ||
+            getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&err, &len) != 0 || err != 0) {
+            closesocket(s);
+            continue;
+        }
+
+        u_long blocking = 0;
+        ioctlsocket(s, FIONBIO, &blocking);
+        int noDelay = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+        return s;
+    }
+    return INVALID_SOCKET;
+}
+
+// Brief comment: reads a non-negative number at pos (leading blanks skipped) and
+//                moves pos behind it; the hot path of all block parsing, so no streams
+bool ParseIndexAt(const std::string& s, size_t& pos, int& value) {
+    while (pos < s.size() && (s[pos] == ' ' || s[pos] == '\t')) ++pos;
+    size_t start = pos;
+    long v = 0;
+    while (pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && v < 1000000) v = v * 10 + (s[pos++] - '0');
+    if (pos == start) return false;
+    value = static_cast<int>(v);
+    return true;
+}
+
+// ---------------------------------------------------------
+// Function: parseLabelTokens
+// Purpose:  Parses tokens that contain labels and stores them in a map
+//           from index -> label.
+// Input:    toks   - vector of tokens, e.g. ["0 Input1", "1 Input2"]
+//           mapOut - map<int,std::string> to store results
+// Output:   Fills mapOut with index->label pairs
+// Note:     If a label is empty, "(unnamed)" is used
+// ---------------------------------------------------------
+void parseLabelTokens(const std::vector<std::string>& toks,
+    std::map<int, std::string>& mapOut) {
+    for (auto& tok : toks) {
+        if (tok.empty()) continue;
+        size_t pos = 0;
+        int idx;
+        if (!ParseIndexAt(tok, pos, idx)) continue;
+        std::string label = tok.substr(pos);
+        if (label.empty()) label = "(unnamed)";
+        mapOut[idx] = std::move(label);
+    }
+}
+
+// Brief comment: parses "out in" body lines of a routing block into (output, input) pairs
+std::vector<std::pair<int, int>> ParseRoutingLines(const std::vector<std::string>& lines) {
+    std::vector<std::pair<int, int>> out;
+    out.reserve(lines.size());
+    for (auto& line : lines) {
+        size_t pos = 0;
+        int outIdx, inIdx;
+        if (ParseIndexAt(line, pos, outIdx) && ParseIndexAt(line, pos, inIdx))
+            out.push_back({ outIdx, inIdx });
+    }
+    return out;
+}
+
+// Brief comment: encodes routing changes (output -> input) as one command block
+std::string BuildRoutingBlock(const std::string& header, const std::map<int, int>& changes) {
+    std::ostringstream cmd;
+    cmd << header << ":\n";
+    for (auto& kv : changes)
+        cmd << kv.first << " " << kv.second << "\n";
+    cmd << "\n";
+    return cmd.str();
+}
+
+// Brief comment: parses "index word" lines (SERIAL PORT DIRECTIONS, SERIAL PORT LOCKS) into a map
+void ParsePortWordLines(const std::vector<std::string>& lines, std::map<int, std::string>& out) {
+    for (auto& line : lines) {
+        size_t pos = 0;
+        int idx;
+        if (!ParseIndexAt(line, pos, idx)) continue;
+        size_t start = line.find_first_not_of(" \t", pos);
+        if (start == std::string::npos) continue;
+        size_t end = line.find_first_of(" \t", start);
+        out[idx] = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    }
+}
+
+// Brief comment: parses "Key: value" lines (VIDEOHUB DEVICE, PROTOCOL PREAMBLE, ...) into a map
+void ParseKeyValueLines(const std::vector<std::string>& lines, std::map<std::string, std::string>& out) {
+    for (auto& line : lines) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string value = line.substr(colon + 1);
+        if (!value.empty() && value[0] == ' ') value.erase(0, 1);
+        out[line.substr(0, colon)] = value;
+    }
+}
+
+// Brief comment: label as sent to the hub (parseLabelTokens keeps the separator space and
+//                stores empty labels as "(unnamed)")
+std::string LabelForProtocol(const std::string& label) {
+    if (label == "(unnamed)") return "";
+    if (!label.empty() && label[0] == ' ') return label.substr(1);
+    return label;
+}
+
+
+// Brief comment: protocol text of a block (header, body lines, blank line)
+std::string HubBlockText(const HubBlock& b) {
+    std::string text = b.header;
+    if (b.header != "ACK" && b.header != "NAK") text += ":";
+    text += "\n";
+    for (auto& line : b.lines) text += line + "\n";
+    text += "\n";
+    return text;
+}
+
+// Brief comment: closes the session socket and drops buffered data
+void CloseHubSession(HubSession& s) {
+    if (s.sock != INVALID_SOCKET) closesocket(s.sock);
+    s.sock = INVALID_SOCKET;
+    s.reader = HubBlockReader{};
+    s.preludeDone = false;
+    s.pendingAcks.clear();
+}
+
+// Brief comment: reads whatever is available on the socket into the block reader
+bool ReadIntoSession(HubSession& s) {
+    char buf[8192];
+    int rec = recv(s.sock, buf, (int)sizeof(buf), 0);
+    if (rec <= 0) {
+        CloseHubSession(s);
+        return false;
+    }
+    s.reader.feed(buf, static_cast<size_t>(rec));
+    s.lastReceived = Clock::now();
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: TrackStatusBlock
+// Purpose:  Updates the configuration or alarm values of a session from
+//           a CONFIGURATION / ALARM STATUS block and queues an event per
+//           value that changed.
+// Notes:    A block identical to the previous one (the usual answer to
+//           a poll) is recognised by comparing the body lines and is not
+//           parsed at all. Values first seen in a prelude are the baseline
+//           and raise no event; after a reconnect, values that differ
+//           from before do.
+// -----------------------------------------------------------
+void TrackStatusBlock(HubSession& s, const HubBlock& b, std::vector<std::string>& lastLines,
+    std::map<std::string, std::string>& values, const char* kind) {
+    if (b.lines == lastLines) return;
+    lastLines = b.lines;
+    for (auto& line : b.lines) {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) continue;
+        std::string key = line.substr(0, colon);
+        size_t v = line.find_first_not_of(' ', colon + 1);
+        std::string value = v == std::string::npos ? "" : line.substr(v);
+        auto it = values.find(key);
+        if (it != values.end() && it->second == value) continue;
+        if (it != values.end() || s.preludeDone)
+            s.events.push_back({ Clock::now(), kind, key, it != values.end() ? it->second : "", value });
+        values[key] = std::move(value);
+    }
+}
+
+// -----------------------------------------------------------
+// Function: ApplyBlockToMirror
+// Purpose:  Updates the live mirror of a session from one block
+//           (labels and routing of all levels, configuration, alarms).
+// Return:   routing changes (output, input) that differ from the
+//           previous mirror, for VIDEO OUTPUT ROUTING blocks
+// -----------------------------------------------------------
+std::vector<std::pair<int, int>> ApplyBlockToMirror(HubSession& s, const HubBlock& b) {
+    std::vector<std::pair<int, int>> changed;
+    if (!s.preludeDone) s.prelude += HubBlockText(b);
+    if (b.header == "VIDEO OUTPUT ROUTING") {
+        for (auto& r : ParseRoutingLines(b.lines)) {
+            auto it = s.mirror.routing.find(r.first);
+            if (it == s.mirror.routing.end() || it->second != r.second) {
+                s.mirror.routing[r.first] = r.second;
+                changed.push_back(r);
+            }
+        }
+    }
+    else if (b.header == "INPUT LABELS") {
+        parseLabelTokens(b.lines, s.mirror.inputLabels);
+        ++s.labelChanges;
+    }
+    else if (b.header == "OUTPUT LABELS") {
+        parseLabelTokens(b.lines, s.mirror.outputLabels);
+        ++s.labelChanges;
+    }
+    else if (const RoutingLevel* level = FindRoutingLevel(b.header)) {
+        for (auto& r : ParseRoutingLines(b.lines))
+            (s.mirror.*level->routing)[r.first] = r.second;
+    }
+    else if (const RoutingLevel* level = FindLabelsLevel(b.header)) {
+        parseLabelTokens(b.lines, s.mirror.*level->outputLabels);
+        ++s.labelChanges;
+    }
+    else if (b.header == "SERIAL PORT DIRECTIONS") {
+        ParsePortWordLines(b.lines, s.mirror.serialDirections);
+    }
+    else if (b.header == "SERIAL PORT LOCKS") {
+        ParsePortWordLines(b.lines, s.mirror.serialLocks);
+    }
+    else if (b.header == "VIDEOHUB DEVICE" || b.header == "PROTOCOL PREAMBLE") {
+        ParseKeyValueLines(b.lines, s.device);
+    }
+    else if (b.header == "CONFIGURATION") {
+        TrackStatusBlock(s, b, s.configurationLines, s.mirror.configuration, "configuration");
+    }
+    else if (b.header == "ALARM STATUS") {
+        TrackStatusBlock(s, b, s.alarmLines, s.mirror.alarms, "alarm");
+    }
+    else if (b.header == "END PRELUDE") {
+        s.preludeDone = true;
+    }
+    return changed;
+}
+
+// Brief comment: pops the stamp of the oldest command on ACK/NAK; returns false for other blocks
+bool PopHubAck(HubSession& s, const HubBlock& b, Clock::time_point& stamp, bool& acked) {
+    if (b.header != "ACK" && b.header != "NAK") return false;
+    acked = (b.header == "ACK");
+    stamp = Clock::now();
+    if (!s.pendingAcks.empty()) {
+        stamp = s.pendingAcks.front();
+        s.pendingAcks.pop_front();
+    }
+    return true;
+}
+
+// Brief comment: sends one command block and remembers its stamp for ACK matching
+bool SendHubCommand(HubSession& s, const std::string& block, Clock::time_point stamp) {
+    if (!s.connected()) return false;
+    std::vector<unsigned char> data(block.begin(), block.end());
+    if (!sendAll(s.sock, data)) {
+        CloseHubSession(s);
+        return false;
+    }
+    s.pendingAcks.push_back(stamp);
+    return true;
+}
+
+// Brief comment: asks the hub for its configuration and, on models that report
+//                them, its alarms; the answers update the mirror like pushed blocks
+bool PollHubStatus(HubSession& s) {
+    if (!SendHubCommand(s, "CONFIGURATION:\n\n")) return false;
+    return s.alarmLines.empty() || SendHubCommand(s, "ALARM STATUS:\n\n");
+}
+
+// -----------------------------------------------------------
+// Function: WaitForSessions
+// Purpose:  Waits up to timeoutMs until one of the sessions has data,
+//           and reads it into the block readers of ready sessions.
+// Return:   number of sessions that received data
+// Notes:    Sessions that disconnect are closed (connected() == false).
+// -----------------------------------------------------------
+int WaitForSessions(const std::vector<HubSession*>& sessions, int timeoutMs) {
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    SOCKET maxSock = 0;
+    bool any = false;
+    for (auto* s : sessions) {
+        if (!s->connected()) continue;
+        FD_SET(s->sock, &readfds);
+        if (s->sock > maxSock) maxSock = s->sock;
+        any = true;
+    }
+    if (!any) {
+        Sleep(timeoutMs);
+        return 0;
+    }
+
+    timeval tv;
+    tv.tv_sec = timeoutMs / 1000;
+    tv.tv_usec = (timeoutMs % 1000) * 1000;
+    if (select((int)maxSock + 1, &readfds, NULL, NULL, &tv) <= 0) return 0;
+
+    int ready = 0;
+    for (auto* s : sessions) {
+        if (s->connected() && FD_ISSET(s->sock, &readfds)) {
+            ReadIntoSession(*s);
+            ++ready;
+        }
+    }
+    return ready;
+}
+
+// Brief comment: closes the session and clears its mirror for a new prelude;
+//                configuration and alarms survive, so changes while away still raise events
+void ResetHubSession(HubSession& s) {
+    CloseHubSession(s);
+    VideoHubState previous = std::move(s.mirror);
+    s.mirror = VideoHubState{};
+    s.mirror.configuration = std::move(previous.configuration);
+    s.mirror.alarms = std::move(previous.alarms);
+    s.device.clear();
+    s.prelude.clear();
+}
+
+// -----------------------------------------------------------
+// Function: OpenHubSession
+// Purpose:  Connects a session and reads the prelude into its mirror.
+// Return:   true when connected and the prelude was received
+//           (END PRELUDE:, or at least routing on old firmware);
+//           false (session closed) when op was stopped meanwhile
+// -----------------------------------------------------------
+bool OpenHubSession(HubSession& s, int timeoutMs, HubOperation* op) {
+    ResetHubSession(s);
+    if (OperationStopped(op)) return false;
+    s.sock = ConnectToHub(s.ip, s.port, timeoutMs < 1000 ? timeoutMs : 1000);
+    if (!s.connected()) return false;
+    s.lastReceived = Clock::now();
+
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    HubBlock b;
+    while (!s.preludeDone && Clock::now() < deadline) {
+        if (OperationStopped(op)) {
+            CloseHubSession(s);
+            return false;
+        }
+        if (WaitForSessions({ &s }, 50) == 0 && !s.connected()) return false;
+        while (s.reader.next(b))
+            ApplyBlockToMirror(s, b);
+    }
+    if (!s.preludeDone && s.mirror.routing.empty()) {
+        CloseHubSession(s);
+        return false;
+    }
+    s.preludeDone = true;
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: DrainHubAnswers
+// Purpose:  Settles a session after a command wait ended early (timeout
+//           or cancel): the answers still owed by the hub must not be
+//           taken for the answers of the next command.
+// Operation:
+//   - waits up to timeoutMs for the outstanding ACK/NAKs and drops them;
+//     other blocks update the mirror
+//   - when they do not all arrive, the session is reconnected (a new
+//     connection owes nothing) and the mirror is read again
+// Return:   true when the session is usable again
+// -----------------------------------------------------------
+bool DrainHubAnswers(HubSession& s, int timeoutMs) {
+    HubBlock b;
+    Clock::time_point stamp;
+    bool acked = false;
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;) {
+        while (!s.pendingAcks.empty() && s.reader.next(b))
+            if (!PopHubAck(s, b, stamp, acked)) ApplyBlockToMirror(s, b);
+        if (s.pendingAcks.empty() || !s.connected() || Clock::now() >= deadline) break;
+        WaitForSessions({ &s }, 20);
+    }
+    if (s.pendingAcks.empty() && s.connected()) return true;
+    return OpenHubSession(s, std::max(timeoutMs, 1000));
+}
+
+// ------------------------------------------------------------
+// Function: FetchHubState
+// ------------------------------------------------------------
+// Purpose:
+//   Fetches data from a VideoHub via TCP, parses the prelude
+//   (preamble, device, inputs, outputs, routing) and fills the state object.
+//   No console output and no globals, so it can also run in the background.
+//
+// Parameters:
+//   - ip, port:      address of the hub
+//   - state:         Struct to be filled with labels and routing
+//   - preambleOut:   String to receive the full prelude (device info)
+//   - expectedBytes: size of the prelude if known (hub registry), used
+//                    to size the prelude buffer before the first byte
+//   - op:            optional; stopping it ends the read (returns false)
+//
+// Return:
+//   - true  on success
+//   - false on failure (no connection or incomplete data)
+//
+// Notes:
+//   The prelude is read block by block with HubBlockReader until
+//   END PRELUDE (or a 3 s deadline on firmware without it), so it
+//   does not matter how the hub's data is split over TCP segments,
+//   and change notifications pushed while the prelude is read are
+//   applied in order instead of being mixed into a section.
+// ------------------------------------------------------------
+bool FetchHubState(const std::string& ip, int port, VideoHubState& state, std::string& preambleOut,
+    size_t expectedBytes, HubOperation* op) {
+    // Initialize Winsock
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+
+    HubSession s;
+    s.ip = ip;
+    s.port = port;
+    s.prelude.reserve(expectedBytes);
+    bool ok = OpenHubSession(s, 3000, op);
+    CloseHubSession(s);
+    WSACleanup();
+    if (!ok) return false;
+
+    preambleOut = std::move(s.prelude);
+    CopyHubContent(state, s.mirror);
+    return true;
+}
+
+
+// --------------------- Apply preset to Videohub ---------------------
+
+// -----------------------------------------------------------
+// Function: ApplyRoutingOnSession
+// Purpose:  Sends routes one by one on an open session and waits for
+//           each ACK/NAK. No console output (also used by --bench).
+// Params:
+//   s          = open session
+//   routing    = output -> input
+//   rejected   = receives the outputs the hub answered with NAK
+//   onAccepted = optional callback per acknowledged route (output, input)
+//   header     = routing block header of the level (default video)
+//   op         = optional progress (one item per route, NAK = failed)
+//                and cancellation, checked before each route
+// Return:   false when the connection was lost, the hub did not answer
+//           within 2 s or op was stopped (the remaining routes are not sent)
+// -----------------------------------------------------------
+bool ApplyRoutingOnSession(HubSession& s, const std::map<int, int>& routing, std::vector<int>& rejected,
+    const std::function<void(int, int)>& onAccepted,
+    const char* header, HubOperation* op) {
+    HubBlock b;
+    OperationAddTotal(op, routing.size());
+    for (auto& kv : routing) {
+        if (OperationStopped(op)) return false;
+        if (!SendHubCommand(s, BuildRoutingBlock(header, { { kv.first, kv.second } })))
+            return false;
+
+        bool answered = false, acked = false;
+        Clock::time_point stamp;
+        auto deadline = Clock::now() + std::chrono::milliseconds(2000);
+        while (!answered && s.connected() && Clock::now() < deadline) {
+            WaitForSessions({ &s }, 50);
+            while (!answered && s.reader.next(b)) {
+                if (PopHubAck(s, b, stamp, acked)) answered = true;
+                else ApplyBlockToMirror(s, b);
+            }
+        }
+        if (!answered) {
+            DrainHubAnswers(s, 2000);
+            return false;
+        }
+        OperationStep(op, acked);
+        if (!acked) rejected.push_back(kv.first);
+        else if (onAccepted) onAccepted(kv.first, kv.second);
+    }
+    return true;
+}
+
+// --------------------- Multi-level salvo ---------------------
+// A salvo takes a whole device state (video, monitoring and serial
+// routing) in one go: the routes that differ from the live mirror are
+// encoded as one routing block per level, all blocks leave in a single
+// write, and the hub answers each block with ACK/NAK in order. So a full
+// recall costs about one round trip instead of one per route or level.
+// If any level is rejected or unanswered, every level of the salvo is
+// set back to the routes the mirror had before (again in one write).
+
+
+// -----------------------------------------------------------
+// Function: BuildSalvo
+// Purpose:  Collects per level the routes of target that differ from
+//           the live mirror (the delta), and the routes they replace.
+// -----------------------------------------------------------
+std::vector<SalvoLevel> BuildSalvo(const VideoHubState& target, const VideoHubState& mirror) {
+    std::vector<SalvoLevel> levels;
+    for (auto& level : kRoutingLevels) {
+        SalvoLevel sl;
+        sl.level = &level;
+        const auto& live = mirror.*level.routing;
+        for (auto& kv : target.*level.routing) {
+            auto it = live.find(kv.first);
+            if (it != live.end() && it->second == kv.second) continue;
+            sl.routes[kv.first] = kv.second;
+            if (it != live.end()) sl.previous[kv.first] = it->second;
+        }
+        if (!sl.routes.empty()) levels.push_back(std::move(sl));
+    }
+    return levels;
+}
+
+// -----------------------------------------------------------
+// Function: WriteSalvoBlocks
+// Purpose:  Encodes one routing block per non-empty level and sends all
+//           of them in a single write, one pending ACK per block.
+// Params:   sent = receives the index into blocks per expected answer
+// Return:   false when not connected or the write failed (session closed)
+// -----------------------------------------------------------
+bool WriteSalvoBlocks(HubSession& s, const std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>>& blocks,
+    std::vector<size_t>& sent) {
+    std::string text;
+    sent.clear();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (blocks[i].second->empty()) continue;
+        text += BuildRoutingBlock(blocks[i].first->routingHeader, *blocks[i].second);
+        sent.push_back(i);
+    }
+    if (sent.empty()) return true;
+    if (!s.connected()) return false;
+
+    std::vector<unsigned char> data(text.begin(), text.end());
+    if (!sendAll(s.sock, data)) {
+        CloseHubSession(s);
+        return false;
+    }
+    auto now = Clock::now();
+    for (size_t n = 0; n < sent.size(); ++n) s.pendingAcks.push_back(now);
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: SendSalvoBlocks
+// Purpose:  Sends one routing block per level in a single write and
+//           waits until the hub answered all of them (ACK/NAK in order).
+//           Other blocks (echoes, front-panel changes) update the mirror.
+// Params:
+//   s        = open session
+//   blocks   = routes per level (empty levels are skipped)
+//   acked    = receives per entry of blocks whether it was acknowledged
+//   op       = optional; stopping it ends the wait, the answers still
+//              owed are drained (or the session reconnected) before
+//              returning, so they cannot reach a later command
+// Return:   false when the connection was lost, the hub did not
+//           answer all blocks within timeoutMs or op was stopped.
+//           After a timeout the answers are still owed: the caller
+//           settles the session with DrainHubAnswers
+// -----------------------------------------------------------
+bool SendSalvoBlocks(HubSession& s, const std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>>& blocks,
+    std::vector<bool>& acked, int timeoutMs, HubOperation* op) {
+    acked.assign(blocks.size(), false);
+    std::vector<size_t> sent;   // index into blocks per expected answer
+    if (!WriteSalvoBlocks(s, blocks, sent)) return false;
+    if (sent.empty()) return true;
+    auto now = Clock::now();
+
+    size_t answered = 0;
+    HubBlock b;
+    Clock::time_point stamp;
+    auto deadline = now + std::chrono::milliseconds(timeoutMs);
+    while (answered < sent.size() && s.connected() && Clock::now() < deadline && !OperationStopped(op)) {
+        WaitForSessions({ &s }, 20);
+        while (answered < sent.size() && s.reader.next(b)) {
+            bool ack = false;
+            if (PopHubAck(s, b, stamp, ack)) acked[sent[answered++]] = ack;
+            else ApplyBlockToMirror(s, b);
+        }
+    }
+    if (answered < sent.size() && s.connected() && OperationStopped(op)) DrainHubAnswers(s, timeoutMs);
+    return answered == sent.size();
+}
+
+// -----------------------------------------------------------
+// Function: ApplySalvoOnSession
+// Purpose:  Takes the routing of all levels of target as one salvo
+//           (see above), with rollback of all levels on a NAK or timeout.
+//           No console output.
+// Params:
+//   s      = open session with a complete mirror (prelude received)
+//   target = routing per level to take; levels without routes are left alone
+//   op     = optional; when stopped before the write nothing is sent,
+//            when stopped while waiting the answers still owed are
+//            drained and the salvo is rolled back (the rollback itself
+//            is awaited: it is what the abort means)
+// Return:   the salvo result; levels is empty when the hub already matches
+// -----------------------------------------------------------
+SalvoResult ApplySalvoOnSession(HubSession& s, const VideoHubState& target, int timeoutMs, HubOperation* op) {
+    SalvoResult r;
+    r.levels = BuildSalvo(target, s.mirror);
+    if (r.levels.empty()) {
+        r.answered = r.applied = true;
+        return r;
+    }
+    if (OperationStopped(op)) return r;
+
+    std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>> blocks;
+    for (auto& sl : r.levels) blocks.push_back({ sl.level, &sl.routes });
+    std::vector<bool> acked;
+    auto t0 = Clock::now();
+    r.answered = SendSalvoBlocks(s, blocks, acked, timeoutMs, op);
+    r.ackMs = ElapsedMs(t0, Clock::now());
+    for (size_t i = 0; i < r.levels.size(); ++i) r.levels[i].acked = acked[i];
+    r.applied = r.answered && std::all_of(acked.begin(), acked.end(), [](bool a) { return a; });
+    if (r.applied || !s.connected()) return r;
+
+    // Late answers of the salvo would be matched to the rollback blocks
+    if (!r.answered && !DrainHubAnswers(s, timeoutMs)) return r;
+
+    // Rollback: all levels, also the rejected ones (a hub may have taken part of a block)
+    blocks.clear();
+    for (auto& sl : r.levels) blocks.push_back({ sl.level, &sl.previous });
+    bool rollbackAnswered = SendSalvoBlocks(s, blocks, acked, timeoutMs);
+    r.rolledBack = rollbackAnswered && std::all_of(acked.begin(), acked.end(), [](bool a) { return a; });
+    if (!rollbackAnswered && s.connected()) DrainHubAnswers(s, timeoutMs);
+    return r;
+}
+
+
+// Helper: reads the description from a JSON file
+// ----------------------------------------------------------------------------------
+// Function: GetPresetDescription
+// Purpose:  Retrieves the description from a JSON file without using an external library
+// Input:    filePath = path to the preset file (.json)
+// Output:   description string, or a default string if not found / cannot open
+// Operation: - Open the file
+//            - Read line by line
+//            - Look for "description"
+//            - Extract the value between quotes
+// ----------------------------------------------------------------------------------
+std::string GetPresetDescription(const std::string& filePath) {
+    std::ifstream ifs(filePath);
+    if (!ifs.is_open()) return "(cannot open)";
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+        auto pos = line.find("\"description\"");
+        if (pos != std::string::npos) {
+            auto colon = line.find(":", pos);
+            if (colon != std::string::npos) {
+                auto startQuote = line.find("\"", colon);
+                auto endQuote = line.find("\"", startQuote + 1);
+                if (startQuote != std::string::npos && endQuote != std::string::npos)
+                    return line.substr(startQuote + 1, endQuote - startQuote - 1);
+            }
+            break;
+        }
+    }
+    return "(no description)";
+}
+
+// Helper: creates a list of presets with descriptions
+// ----------------------------------------------------------------------------------
+// Function: ListPresets
+// Purpose:  Creates a list of all presets in the given folder with their descriptions
+// Input:    folder = folder containing presets (default: "presets")
+//           op     = optional progress (one item per preset file) and cancellation
+// Output:   vector of pairs <presetName, description>; the presets read so far
+//           when op was stopped
+// Operation: - Iterate over all .json files in the folder
+//            - For each file, get the name (without extension)
+//            - Get description via GetPresetDescription
+//            - Add to vector
+// ----------------------------------------------------------------------------------
+std::vector<std::pair<std::string, std::string>> ListPresets(const std::string& folder, HubOperation* op) {
+    std::vector<std::pair<std::string, std::string>> presets;
+    for (auto& entry : fs::directory_iterator(folder)) {
+        if (OperationStopped(op)) break;
+        if (entry.path().extension() != ".json") continue;
+        OperationAddTotal(op, 1);
+        std::string name = entry.path().stem().string();
+        std::string description = GetPresetDescription(entry.path().string());
+        OperationStep(op, description != "(cannot open)");
+        presets.push_back({ name, description });
+    }
+    return presets;
+}
+
+// --------------------- Preset catalog ---------------------
+
+// Brief comment: bit per letter / digit present in a text (ASCII, case-insensitive)
+static uint64_t PresetCharMask(const std::string& text) {
+    uint64_t mask = 0;
+    for (unsigned char c : text) {
+        if (c >= 'a' && c <= 'z') mask |= 1ull << (c - 'a');
+        else if (c >= 'A' && c <= 'Z') mask |= 1ull << (c - 'A');
+        else if (c >= '0' && c <= '9') mask |= 1ull << (26 + c - '0');
+    }
+    return mask;
+}
+
+static std::string LowerAscii(std::string s) {
+    for (auto& c : s)
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    return s;
+}
+
+PresetCatalog BuildPresetCatalog(std::vector<std::pair<std::string, std::string>> presets) {
+    std::sort(presets.begin(), presets.end());
+    PresetCatalog c;
+    c.names.reserve(presets.size());
+    c.descriptions.reserve(presets.size());
+    c.keys.reserve(presets.size());
+    c.masks.reserve(presets.size());
+    for (auto& p : presets) {
+        c.keys.push_back(LowerAscii(p.first + " " + p.second));
+        c.masks.push_back(PresetCharMask(c.keys.back()));
+        c.names.push_back(std::move(p.first));
+        c.descriptions.push_back(std::move(p.second));
+    }
+    return c;
+}
+
+// -----------------------------------------------------------
+// Function: ScorePresetWord
+// Purpose:  Scores one query word (lower case) against a catalog key.
+// Operation:
+//   - a contiguous occurrence scores highest, more at a word start, at
+//     the very start and inside the name than in the description
+//   - otherwise the letters must appear in order (fuzzy); consecutive
+//     letters and letters at word starts score, gaps cost
+// Return:   -1 when the word does not occur even as a fuzzy match
+// -----------------------------------------------------------
+static int ScorePresetWord(const std::string& key, size_t nameLength, const char* word, size_t n) {
+    auto wordStart = [&key](size_t p) {
+        return p == 0 || !std::isalnum(static_cast<unsigned char>(key[p - 1]));
+    };
+    int best = -1;
+    for (size_t p = key.find(word, 0, n); p != std::string::npos; p = key.find(word, p + 1, n)) {
+        int score = 100 + 8 * static_cast<int>(n) - static_cast<int>(std::min<size_t>(p, 40));
+        if (wordStart(p)) score += 40;
+        if (p == 0) score += 40;
+        if (p + n <= nameLength) score += 60;
+        best = std::max(best, score);
+    }
+    if (best >= 0) return best;
+
+    size_t j = 0, last = std::string::npos;
+    int score = 0;
+    for (size_t q = key.find(word[0]); q < key.size() && j < n; ++q) {
+        if (key[q] != word[j]) continue;
+        int c = 10;
+        if (last != std::string::npos) c += q == last + 1 ? 15 : -static_cast<int>(std::min<size_t>(q - last - 1, 10));
+        if (wordStart(q)) c += 12;
+        if (q < nameLength) c += 6;
+        score += c;
+        last = q;
+        ++j;
+    }
+    return j == n ? score : -1;
+}
+
+int ScorePresetMatch(const PresetCatalog& catalog, size_t index, const std::string& query) {
+    const std::string& key = catalog.keys[index];
+    size_t nameLength = catalog.names[index].size();
+    int total = 0;
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find(' ', start);
+        if (end == std::string::npos) end = query.size();
+        if (end > start) {
+            int s = ScorePresetWord(key, nameLength, query.data() + start, end - start);
+            if (s < 0) return -1;
+            total += s;
+        }
+        start = end + 1;
+    }
+    return total;
+}
+
+// Brief comment: keeps the best limit matches, best first (ties in name order)
+static void RankPresetMatches(PresetSearch& s, std::vector<PresetMatch>& scored, size_t limit) {
+    auto better = [](const PresetMatch& a, const PresetMatch& b) {
+        return a.score != b.score ? a.score > b.score : a.index < b.index;
+    };
+    size_t keep = std::min(limit, scored.size());
+    std::partial_sort(scored.begin(), scored.begin() + keep, scored.end(), better);
+    scored.resize(keep);
+    s.ranked = std::move(scored);
+}
+
+void StartPresetSearch(PresetSearch& s, const PresetCatalog& catalog, size_t limit) {
+    s.catalog = &catalog;
+    s.query.clear();
+    s.candidates.assign(1, {});
+    s.candidates[0].resize(catalog.names.size());
+    for (size_t i = 0; i < catalog.names.size(); ++i) s.candidates[0][i] = static_cast<uint32_t>(i);
+    s.matches = catalog.names.size();
+    s.ranked.clear();
+    for (size_t i = 0; i < std::min(limit, catalog.names.size()); ++i) s.ranked.push_back({ static_cast<uint32_t>(i), 0 });
+}
+
+// -----------------------------------------------------------
+// Function: UpdatePresetSearch
+// Purpose:  Sets a new query and ranks the matches.
+// Operation:
+//   - the candidates of the common prefix of the old and new query are
+//     kept; every further character filters the level before it (mask
+//     test first, then the fuzzy match), so typing one character only
+//     looks at the presets that matched so far
+//   - backspace just drops levels; the remaining matches are scored again
+//   - the best limit matches are selected with a partial sort
+// -----------------------------------------------------------
+void UpdatePresetSearch(PresetSearch& s, const std::string& query, size_t limit) {
+    if (!s.catalog) return;
+    const PresetCatalog& c = *s.catalog;
+    std::string q = LowerAscii(query);
+    size_t common = 0;
+    while (common < q.size() && common < s.query.size() && q[common] == s.query[common]) ++common;
+    s.candidates.resize(common + 1);
+    s.query = q;
+
+    std::vector<PresetMatch> scored;
+    bool haveScores = false;
+    for (size_t len = common + 1; len <= q.size(); ++len) {
+        const std::vector<uint32_t>& previous = s.candidates[len - 1];
+        std::vector<uint32_t> next;
+        if (q[len - 1] == ' ') next = previous;   // a separator alone does not narrow anything
+        else {
+            std::string prefix = q.substr(0, len);
+            uint64_t mask = PresetCharMask(prefix);
+            scored.clear();
+            for (uint32_t i : previous) {
+                if ((c.masks[i] & mask) != mask) continue;
+                int score = ScorePresetMatch(c, i, prefix);
+                if (score < 0) continue;
+                next.push_back(i);
+                scored.push_back({ i, score });
+            }
+            haveScores = true;
+        }
+        s.candidates.push_back(std::move(next));
+        if (q[len - 1] == ' ') haveScores = false;
+    }
+
+    const std::vector<uint32_t>& current = s.candidates.back();
+    s.matches = current.size();
+    if (q.find_first_not_of(' ') == std::string::npos) {
+        s.ranked.clear();
+        for (size_t k = 0; k < std::min(limit, current.size()); ++k) s.ranked.push_back({ current[k], 0 });
+        return;
+    }
+    if (!haveScores) {
+        scored.clear();
+        for (uint32_t i : current) scored.push_back({ i, ScorePresetMatch(c, i, q) });
+    }
+    RankPresetMatches(s, scored, limit);
+}
+
+// --------------------- Label index ---------------------
+
+// Brief comment: lower case, whitespace runs as one space, trimmed
+static std::string NormalizeLabelKey(const std::string& text) {
+    std::string key;
+    key.reserve(text.size());
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            if (!key.empty() && key.back() != ' ') key += ' ';
+        }
+        else key += static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+    if (!key.empty() && key.back() == ' ') key.pop_back();
+    return key;
+}
+
+// Brief comment: distinct trigrams of " key " (3 bytes packed in one number)
+static std::vector<uint32_t> LabelTrigrams(const std::string& key) {
+    std::string padded = " " + key + " ";
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i + 3 <= padded.size(); ++i)
+        out.push_back(static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16 |
+            static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8 |
+            static_cast<unsigned char>(padded[i + 2]));
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+static std::string WithoutSpaces(std::string key) {
+    key.erase(std::remove(key.begin(), key.end(), ' '), key.end());
+    return key;
+}
+
+LabelIndex BuildLabelIndex(const std::map<int, std::string>& labels) {
+    LabelIndex index;
+    for (auto& kv : labels) {
+        uint32_t entry = static_cast<uint32_t>(index.ports.size());
+        std::string key = NormalizeLabelKey(kv.second);
+        std::vector<uint32_t> trigrams = LabelTrigrams(key);
+        for (uint32_t t : trigrams) index.trigrams[t].push_back(entry);
+        auto ins = index.exact.emplace(key, entry);
+        if (!ins.second) ins.first->second = LabelIndex::kNoEntry;
+        ins = index.compact.emplace(WithoutSpaces(key), entry);
+        if (!ins.second) ins.first->second = LabelIndex::kNoEntry;
+        index.ports.push_back(kv.first);
+        index.labels.push_back(kv.second);
+        index.keys.push_back(std::move(key));
+        index.trigramCounts.push_back(static_cast<uint16_t>(std::min<size_t>(trigrams.size(), 0xFFFF)));
+    }
+    return index;
+}
+
+// -----------------------------------------------------------
+// Function: ResolveLabel
+// Purpose:  Finds the ports whose label matches a typed name.
+// Operation:
+//   - exact label (also ignoring spaces): one hash lookup; a port
+//     number: one binary search
+//   - otherwise the trigrams of the query collect the labels sharing at
+//     least one of them (queries under 3 characters look at all labels);
+//     each is scored: the query as prefix, at a word start or anywhere in
+//     the label, else by the share of common trigrams (Dice coefficient,
+//     from 40 %), shorter labels first on equal kind
+// -----------------------------------------------------------
+std::vector<LabelMatch> ResolveLabel(const LabelIndex& index, const std::string& query, size_t maxResults) {
+    std::vector<LabelMatch> out;
+    std::string q = NormalizeLabelKey(query);
+    if (q.empty() || index.ports.empty()) return out;
+
+    std::string qCompact = WithoutSpaces(q);
+    auto ex = index.exact.find(q);
+    if (ex != index.exact.end() && ex->second != LabelIndex::kNoEntry) {
+        out.push_back({ index.ports[ex->second], 1000, true });
+        return out;
+    }
+    auto co = index.compact.find(qCompact);
+    if (ex == index.exact.end() && co != index.compact.end() && co->second != LabelIndex::kNoEntry) {
+        out.push_back({ index.ports[co->second], 950, true });
+        return out;
+    }
+    if (ex == index.exact.end() && co == index.compact.end()) {
+        size_t digits = q[0] == '#' ? 1 : 0;
+        if (q.size() > digits && q.size() - digits <= 6 &&
+            q.find_first_not_of("0123456789", digits) == std::string::npos) {
+            int port = std::stoi(q.substr(digits)) - 1;
+            auto it = std::lower_bound(index.ports.begin(), index.ports.end(), port);
+            if (it != index.ports.end() && *it == port) out.push_back({ port, 1000, true });
+            return out;
+        }
+    }
+
+    std::vector<uint32_t> queryTrigrams = LabelTrigrams(q);
+    std::vector<uint16_t> shared(index.ports.size(), 0);
+    std::vector<uint32_t> touched;
+    if (q.size() < 3) {
+        touched.resize(index.ports.size());
+        for (size_t e = 0; e < touched.size(); ++e) touched[e] = static_cast<uint32_t>(e);
+    }
+    for (uint32_t t : queryTrigrams) {
+        auto it = index.trigrams.find(t);
+        if (it == index.trigrams.end()) continue;
+        for (uint32_t e : it->second)
+            if (shared[e]++ == 0 && q.size() >= 3) touched.push_back(e);
+    }
+
+    for (uint32_t e : touched) {
+        const std::string& key = index.keys[e];
+        int lengthPenalty = static_cast<int>(std::min<size_t>(key.size() - std::min(key.size(), q.size()), 99));
+        size_t pos = key.find(q);
+        bool exact = key == q || WithoutSpaces(key) == qCompact;
+        int score;
+        if (key == q) score = 1000;
+        else if (exact) score = 950;
+        else if (pos == 0) score = 900 - lengthPenalty;
+        else if (pos != std::string::npos && key[pos - 1] == ' ') score = 800 - lengthPenalty;
+        else if (pos != std::string::npos) score = 700 - lengthPenalty;
+        else {
+            int dice = 200 * shared[e] / static_cast<int>(queryTrigrams.size() + index.trigramCounts[e]);
+            if (dice < 40) continue;
+            score = 5 * dice - lengthPenalty;
+        }
+        out.push_back({ index.ports[e], score, exact });
+    }
+    std::sort(out.begin(), out.end(), [](const LabelMatch& a, const LabelMatch& b) {
+        return a.score != b.score ? a.score > b.score : a.port < b.port;
+    });
+    if (out.size() > maxResults) out.resize(maxResults);
+    return out;
+}
+
+
+// -----------------------------------------------------------
+// Function: CompareRouting
+// Purpose:  Compares the routing of a preset with a hub state, output
+//           by output (union of both), without console output.
+//           Works on the routing map of any level.
+// Notes:    Both maps are sorted, so one merge pass is enough.
+// -----------------------------------------------------------
+std::vector<RouteComparison> CompareRouting(const std::map<int, int>& preset, const std::map<int, int>& hub) {
+    std::vector<RouteComparison> out;
+    out.reserve(std::max(preset.size(), hub.size()));
+    auto p = preset.begin();
+    auto h = hub.begin();
+    while (p != preset.end() || h != hub.end()) {
+        if (h == hub.end() || (p != preset.end() && p->first < h->first)) {
+            out.push_back({ p->first, p->second, -1 });
+            ++p;
+        }
+        else if (p == preset.end() || h->first < p->first) {
+            out.push_back({ h->first, -1, h->second });
+            ++h;
+        }
+        else {
+            out.push_back({ p->first, p->second, h->second });
+            ++p;
+            ++h;
+        }
+    }
+    return out;
+}
+
+
+// -----------------------------------------------------------
+// Function: ResetVideoHubState
+// Purpose:  Resets a VideoHubState struct completely to an empty state
+// Param:    state = reference to the VideoHubState to reset
+// Operation:
+//   - Clears all vectors and strings in the struct:
+//        inputLabels, output labels and routing of all levels, description
+//   - Useful for initialization or after loading a new preset
+// -----------------------------------------------------------
+void ResetVideoHubState(VideoHubState& state) {
+    CopyHubContent(state, VideoHubState{});
+    state.description.clear();
+}
+
+// --------------------- Command scheduler ---------------------
+
+const char* CommandClassName(CommandClass c) {
+    switch (c) {
+    case CommandClass::Take: return "take";
+    case CommandClass::Replication: return "replication";
+    case CommandClass::Labels: return "labels";
+    case CommandClass::Refresh: return "refresh";
+    }
+    return "?";
+}
+
+bool IsBulkClass(CommandClass c) {
+    return c == CommandClass::Labels || c == CommandClass::Refresh;
+}
+
+double CommandLatencyPercentile(const CommandClassStats& stats, double percentile) {
+    if (stats.recentLatencyMs.empty()) return 0.0;
+    std::vector<double> sorted = stats.recentLatencyMs;
+    size_t k = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+    return sorted[k];
+}
+
+// Brief comment: records an answer (or loss) of one block and completes its command
+static void FinishScheduledBlock(HubCommandScheduler& q, HubCommandScheduler::Command& c, bool answered, bool acked) {
+    CommandClassStats& st = q.stats[static_cast<int>(c.cls)];
+    double latency = -1.0;
+    if (answered) {
+        latency = ElapsedMs(c.queued, Clock::now());
+        acked ? ++st.acked : ++st.naked;
+        st.sumLatencyMs += latency;
+        st.maxLatencyMs = std::max(st.maxLatencyMs, latency);
+        if (st.recentLatencyMs.size() < CommandClassStats::kLatencySamples) st.recentLatencyMs.push_back(latency);
+        else st.recentLatencyMs[st.nextSample] = latency;
+        st.nextSample = (st.nextSample + 1) % CommandClassStats::kLatencySamples;
+    }
+    else {
+        ++st.lost;
+    }
+    auto& g = *c.group;
+    if (!answered || !acked) g.allAcked = false;
+    if (--g.remaining == 0 && g.done) g.done(answered && g.allAcked, latency);
+}
+
+// -----------------------------------------------------------
+// Function: ScheduleCommand
+// Purpose:  Queues a command block in its class. Blocks of bulk
+//           classes are cut into blocks of q.chunkLines body lines
+//           (header repeated), so each can be preempted by a take.
+// -----------------------------------------------------------
+void ScheduleCommand(HubCommandScheduler& q, CommandClass cls, const std::string& block,
+    CommandDone done, Clock::time_point queued) {
+    auto group = std::make_shared<HubCommandScheduler::Group>();
+    group->done = std::move(done);
+    auto& queue = q.queues[static_cast<int>(cls)];
+    auto add = [&](std::string text) {
+        HubCommandScheduler::Command c;
+        c.cls = cls;
+        c.block = std::move(text);
+        c.queued = queued;
+        c.group = group;
+        ++group->remaining;
+        ++q.stats[static_cast<int>(cls)].queued;
+        queue.push_back(std::move(c));
+    };
+
+    size_t headerEnd = block.find('\n');
+    if (!IsBulkClass(cls) || q.chunkLines == 0 || headerEnd == std::string::npos) {
+        add(block);
+        return;
+    }
+    std::string header = block.substr(0, headerEnd + 1);
+    std::string chunk;
+    size_t lines = 0;
+    size_t pos = headerEnd + 1;
+    while (pos < block.size()) {
+        size_t nl = block.find('\n', pos);
+        if (nl == std::string::npos) nl = block.size();
+        if (nl == pos) break;   // blank line: end of the block
+        chunk.append(block, pos, nl - pos + 1);
+        pos = nl + 1;
+        if (++lines == q.chunkLines) {
+            add(header + chunk + "\n");
+            chunk.clear();
+            lines = 0;
+        }
+    }
+    if (lines > 0 || group->remaining == 0) add(header + chunk + "\n");
+}
+
+// -----------------------------------------------------------
+// Function: PumpScheduler
+// Purpose:  Sends queued blocks in priority order: every take, then
+//           every replication block, then (only when no bulk block is
+//           in flight) the next block of the first non-empty bulk class.
+// -----------------------------------------------------------
+bool PumpScheduler(HubCommandScheduler& q, HubSession& s) {
+    for (int c = 0; c < kCommandClasses; ++c) {
+        auto& queue = q.queues[c];
+        bool bulk = IsBulkClass(static_cast<CommandClass>(c));
+        while (!queue.empty()) {
+            if (bulk && q.bulkInFlight > 0) return true;
+            HubCommandScheduler::Command cmd = std::move(queue.front());
+            queue.pop_front();
+            if (!SendHubCommand(s, cmd.block, cmd.queued)) {
+                FinishScheduledBlock(q, cmd, false, false);
+                return false;
+            }
+            cmd.sent = Clock::now();
+            double wait = ElapsedMs(cmd.queued, cmd.sent);
+            CommandClassStats& st = q.stats[c];
+            st.sumWaitMs += wait;
+            st.maxWaitMs = std::max(st.maxWaitMs, wait);
+            if (bulk) ++q.bulkInFlight;
+            q.inFlight.push_back(std::move(cmd));
+        }
+    }
+    return true;
+}
+
+bool HandleScheduledAnswer(HubCommandScheduler& q, HubSession& s, const HubBlock& b) {
+    Clock::time_point stamp;
+    bool acked = false;
+    if (!PopHubAck(s, b, stamp, acked)) return false;
+    if (q.inFlight.empty()) return true;   // e.g. a PING sent outside the scheduler
+    HubCommandScheduler::Command cmd = std::move(q.inFlight.front());
+    q.inFlight.pop_front();
+    if (IsBulkClass(cmd.cls)) --q.bulkInFlight;
+    FinishScheduledBlock(q, cmd, true, acked);
+    return true;
+}
+
+void DropScheduledCommands(HubCommandScheduler& q) {
+    std::deque<HubCommandScheduler::Command> dropped;
+    dropped.swap(q.inFlight);
+    for (auto& queue : q.queues) {
+        for (auto& c : queue) dropped.push_back(std::move(c));
+        queue.clear();
+    }
+    q.bulkInFlight = 0;
+    for (auto& c : dropped) FinishScheduledBlock(q, c, false, false);
+}
+
+
+// --------------------- C ABI ---------------------
+// Thin wrappers over the C++ API above; see VideoHubCoreC.h for the contract.
+
+struct vh_session {
+    HubSession hub;
+    bool wsaStarted = false;
+    HubOperation op;   // the running call, for vh_cancel (reset when a call starts)
+};
+
+// Brief comment: routing level of a VH_LEVEL_* value, or nullptr
+static const RoutingLevel* CLevel(int level) {
+    const int count = static_cast<int>(sizeof(kRoutingLevels) / sizeof(kRoutingLevels[0]));
+    return level >= 0 && level < count ? &kRoutingLevels[level] : nullptr;
+}
+
+// Brief comment: labels of a VH_PORTS_* kind, or nullptr
+static const std::map<int, std::string>* CLabels(const VideoHubState& m, int kind) {
+    switch (kind) {
+    case VH_PORTS_INPUT: return &m.inputLabels;
+    case VH_PORTS_OUTPUT: return &m.outputLabels;
+    case VH_PORTS_MONITORING: return &m.monitorLabels;
+    case VH_PORTS_SERIAL: return &m.serialLabels;
+    }
+    return nullptr;
+}
+
+vh_session* vh_open(const char* host, int port, int timeout_ms) {
+    if (!host) return nullptr;
+    auto* s = new vh_session;
+    WSADATA wsa;
+    s->wsaStarted = WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+    s->hub.ip = host;
+    if (port > 0) s->hub.port = port;
+    if (!s->wsaStarted || !OpenHubSession(s->hub, timeout_ms > 0 ? timeout_ms : 3000)) {
+        vh_close(s);
+        return nullptr;
+    }
+    return s;
+}
+
+void vh_close(vh_session* s) {
+    if (!s) return;
+    CloseHubSession(s->hub);
+    if (s->wsaStarted) WSACleanup();
+    delete s;
+}
+
+int vh_connected(const vh_session* s) {
+    return s && s->hub.connected() ? 1 : 0;
+}
+
+int vh_poll(vh_session* s, int timeout_ms) {
+    if (!s) return VH_ERR_ARGUMENT;
+    if (!s->hub.connected()) return VH_ERR_CONNECTION;
+    WaitForSessions({ &s->hub }, timeout_ms > 0 ? timeout_ms : 0);
+    int applied = 0;
+    HubBlock b;
+    Clock::time_point stamp;
+    bool acked;
+    while (s->hub.reader.next(b)) {
+        if (PopHubAck(s->hub, b, stamp, acked)) continue;
+        ApplyBlockToMirror(s->hub, b);
+        ++applied;
+    }
+    s->hub.events.clear();   // change events are not part of the C ABI
+    return s->hub.connected() ? applied : VH_ERR_CONNECTION;
+}
+
+int vh_port_count(const vh_session* s, int kind) {
+    if (!s) return VH_ERR_ARGUMENT;
+    static const char* const keys[] = { "Video inputs", "Video outputs", "Video monitoring outputs", "Serial ports" };
+    const std::map<int, std::string>* labels = CLabels(s->hub.mirror, kind);
+    if (!labels) return VH_ERR_ARGUMENT;
+    auto it = s->hub.device.find(keys[kind]);
+    if (it != s->hub.device.end()) {
+        try { return std::stoi(it->second); } catch (...) {}
+    }
+    return static_cast<int>(labels->size());
+}
+
+int vh_get_route(const vh_session* s, int level, int output) {
+    const RoutingLevel* l = CLevel(level);
+    if (!s || !l) return -1;
+    const auto& routing = s->hub.mirror.*l->routing;
+    auto it = routing.find(output);
+    return it != routing.end() ? it->second : -1;
+}
+
+int vh_get_label(const vh_session* s, int kind, int index, char* buf, int size) {
+    if (!s) return VH_ERR_ARGUMENT;
+    const std::map<int, std::string>* labels = CLabels(s->hub.mirror, kind);
+    if (!labels) return VH_ERR_ARGUMENT;
+    auto it = labels->find(index);
+    if (it == labels->end()) return VH_ERR_ARGUMENT;
+    std::string label = LabelForProtocol(it->second);   // without the leading space of the stored form
+    if (buf && size > 0) {
+        size_t n = std::min(label.size(), static_cast<size_t>(size - 1));
+        std::memcpy(buf, label.data(), n);
+        buf[n] = '\0';
+    }
+    return static_cast<int>(label.size());
+}
+
+int vh_route(vh_session* s, int level, int output, int source, int timeout_ms) {
+    const RoutingLevel* l = CLevel(level);
+    if (!s || !l || output < 0 || source < 0) return VH_ERR_ARGUMENT;
+    if (!s->hub.connected()) return VH_ERR_CONNECTION;
+    std::map<int, int> routes{ { output, source } };
+    std::vector<bool> acked;
+    s->op.reset();
+    int timeout = timeout_ms > 0 ? timeout_ms : 2000;
+    if (!SendSalvoBlocks(s->hub, { { l, &routes } }, acked, timeout, &s->op)) {
+        // the late answer must not become the result of the next call
+        if (!s->hub.connected() || !DrainHubAnswers(s->hub, timeout)) return VH_ERR_CONNECTION;
+        return s->op.cancelRequested ? VH_ERR_CANCELLED : VH_ERR_TIMEOUT;
+    }
+    if (!acked[0]) return VH_ERR_REJECTED;
+    (s->hub.mirror.*l->routing)[output] = source;   // the hub's echo follows the ACK
+    return VH_OK;
+}
+
+int vh_apply_preset(vh_session* s, const char* filename, int timeout_ms) {
+    if (!s || !filename) return VH_ERR_ARGUMENT;
+    if (!s->hub.connected()) return VH_ERR_CONNECTION;
+    VideoHubState preset;
+    if (!LoadPreset(filename, preset)) return VH_ERR_FILE;
+    s->op.reset();
+    int timeout = timeout_ms > 0 ? timeout_ms : 2000;
+    SalvoResult r = ApplySalvoOnSession(s->hub, preset, timeout, &s->op);
+    if (!s->hub.pendingAcks.empty() && !DrainHubAnswers(s->hub, timeout)) return VH_ERR_CONNECTION;
+    if (r.applied) {
+        for (auto& sl : r.levels)
+            for (auto& kv : sl.routes) (s->hub.mirror.*sl.level->routing)[kv.first] = kv.second;
+        return VH_OK;
+    }
+    if (!s->hub.connected()) return VH_ERR_CONNECTION;
+    if (s->op.cancelRequested) return VH_ERR_CANCELLED;
+    return r.answered ? VH_ERR_REJECTED : VH_ERR_TIMEOUT;
+}
+
+int vh_save_preset(const vh_session* s, const char* filename, const char* description) {
+    if (!s || !filename) return VH_ERR_ARGUMENT;
+    VideoHubState state;
+    CopyHubContent(state, s->hub.mirror);
+    state.description = description ? description : "";
+    return SavePreset(filename, state) ? VH_OK : VH_ERR_FILE;
+}
+
+int vh_compare_preset(const vh_session* s, const char* filename) {
+    if (!s || !filename) return VH_ERR_ARGUMENT;
+    VideoHubState preset;
+    if (!LoadPreset(filename, preset)) return VH_ERR_FILE;
+    int differs = 0;
+    for (auto& level : kRoutingLevels) {
+        const auto& routes = preset.*level.routing;
+        if (routes.empty()) continue;   // level not stored in the preset
+        for (auto& c : CompareRouting(routes, s->hub.mirror.*level.routing)) differs += c.differs();
+    }
+    return differs;
+}
+
+void vh_cancel(vh_session* s) {
+    if (s) s->op.cancel();
+}
@@ -0,0 +1,767 @@
+﻿// VideoHubCore.h
+// Compile as x64 with C++17. Uses Winsock. Hub session, protocol parser, presets, diff and apply.
+
+/*
+===============================================================================
+Videohub core library
+===============================================================================
+
+Description:
+Everything VideoHubHL does with a hub that is not console work: the TCP
+session with its live mirror, the block parser of the Videohub protocol,
+the hub state with all routing levels, the JSON preset store, preset/hub
+comparison and the salvo apply with rollback. The console program is one
+client of it; tally, automation and test tools link the same code.
+
+Rules:
+- no console input or output; results and errors are return values
+- no program state: hub address, loaded preset and status flags belong
+  to the caller. The only shared object is the host name cache of the
+  resolver (SharedHubResolver), which is thread-safe.
+- Winsock is initialised by the caller (C++ API) or by vh_open (C ABI)
+
+Build:
+   compile VideoHubCore.cpp together with the program, or as a DLL with
+   VIDEOHUBCORE_EXPORTS defined (clients of the DLL define VIDEOHUBCORE_DLL)
+
+C ABI:
+VideoHubCoreC.h (included at the end) declares vh_* functions that only
+use C types and an opaque session handle, so the library can be used
+from C, C#, Python (ctypes) or another compiler.
+
+Version: 1.0
+===============================================================================
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+// --------------------- Data structure ---------------------
+struct VideoHubState {
+    std::map<int, std::string> inputLabels;   // Input labels per channel
+    std::map<int, std::string> outputLabels;  // Output labels per channel
+    std::map<int, int> routing;               // Routing table: output -> input
+    std::map<int, std::string> monitorLabels; // Monitoring output labels (Smart Videohub models)
+    std::map<int, int> monitorRouting;        // Monitoring routing: monitoring output -> input
+    std::map<int, std::string> serialLabels;  // Serial (RS-422) port labels
+    std::map<int, int> serialRouting;         // Serial routing: port -> port
+    std::map<int, std::string> serialDirections; // Serial port direction: control / slave / auto
+    std::map<int, std::string> serialLocks;   // Serial port locks (U/O/L), live state only, not saved
+    std::map<std::string, std::string> configuration; // CONFIGURATION: key -> value, live state only
+    std::map<std::string, std::string> alarms;         // ALARM STATUS (models that report it), live state only
+    std::string description;                  // Description of the preset
+    std::string filename;                     // Last used preset file
+};
+
+// --------------------- Routing levels ---------------------
+// A hub can have more than one routing matrix ("level"): the video
+// outputs, on Smart Videohub models the monitoring outputs, which are
+// fed from the same video inputs, and on larger hubs the RS-422 serial
+// ports (deck control), which are routed port to port. Parsing, presets,
+// compare and apply loop over this table, so a further level is one
+// more entry.
+
+// Brief comment: description of one routing level
+struct RoutingLevel {
+    const char* name;            // console name
+    const char* outputNoun;      // console name of one destination
+    const char* sourceNoun;      // console name of one source
+    const char* routingHeader;   // protocol block with "output source" lines
+    const char* labelsHeader;    // protocol block with the output labels
+    const char* routingKey;      // JSON key of the routing in presets and the registry
+    const char* labelsKey;       // JSON key of the output labels
+    std::map<int, int> VideoHubState::* routing;
+    std::map<int, std::string> VideoHubState::* outputLabels;
+    std::map<int, std::string> VideoHubState::* sourceLabels;
+};
+
+inline const RoutingLevel kRoutingLevels[] = {
+    { "Video", "Output", "Input", "VIDEO OUTPUT ROUTING", "OUTPUT LABELS", "routing", "outputs",
+      &VideoHubState::routing, &VideoHubState::outputLabels, &VideoHubState::inputLabels },
+    { "Monitoring", "Monitoring output", "Input", "VIDEO MONITORING OUTPUT ROUTING", "MONITORING OUTPUT LABELS",
+      "monitorRouting", "monitorOutputs",
+      &VideoHubState::monitorRouting, &VideoHubState::monitorLabels, &VideoHubState::inputLabels },
+    { "Serial", "Serial port", "Serial port", "SERIAL PORT ROUTING", "SERIAL PORT LABELS",
+      "serialRouting", "serialPorts",
+      &VideoHubState::serialRouting, &VideoHubState::serialLabels, &VideoHubState::serialLabels },
+};
+
+// Brief comment: true for the video level (always present, stored under the original preset keys)
+bool IsVideoLevel(const RoutingLevel& level);
+
+// Brief comment: routing level of a routing block header, or nullptr
+const RoutingLevel* FindRoutingLevel(const std::string& header);
+
+// Brief comment: routing level of an output labels block header, or nullptr
+const RoutingLevel* FindLabelsLevel(const std::string& header);
+
+// Brief comment: copies what was read from a hub (labels and routing of all levels),
+//                leaving description and filename alone
+void CopyHubContent(VideoHubState& dst, const VideoHubState& src);
+
+// Brief comment: resets a state completely (labels, routing of all levels, description)
+void ResetVideoHubState(VideoHubState& state);
+
+// --------------------- String / network helpers ---------------------
+
+// Brief comment: wrapper to use std::string IP address with inet_pton
+int inet_pton_wrap(int af, const std::string& src, void* dst);
+
+// Brief comment: checks if a string is a valid IPv4 address
+bool IsValidIPv4(const std::string& ip);
+
+using Clock = std::chrono::steady_clock;
+
+// Brief comment: milliseconds between two time points
+double ElapsedMs(Clock::time_point from, Clock::time_point to);
+
+// Brief comment: sends all bytes of a buffer through a socket
+bool sendAll(SOCKET s, const std::vector<unsigned char>& data);
+
+// --------------------- Long operations ---------------------
+// Scans, preset listings, route-by-route pushes, session opens and salvos
+// take an optional HubOperation* (nullptr = run to the end). The caller,
+// or any other thread (UI, API client), reads the progress counters and
+// calls cancel(); the operation notices it at its next check (at the
+// latest after one socket wait of 50 ms, or a connect attempt), cleans up
+// and returns what it has so far. A deadline ends it the same way.
+
+// -----------------------------------------------------------
+// Struct: HubOperation
+// Purpose:  Progress counters, cooperative cancellation and a deadline
+//           for one long operation. All members are thread-safe.
+// Notes:    total grows while the operation discovers its work (files,
+//           probes); done counts finished items including failed ones.
+//           reset() before reusing the object for the next operation.
+// -----------------------------------------------------------
+struct HubOperation {
+    std::atomic<size_t> total{ 0 };
+    std::atomic<size_t> done{ 0 };
+    std::atomic<size_t> failed{ 0 };
+    std::atomic<bool> cancelRequested{ false };
+    std::atomic<Clock::rep> deadline{ 0 };   // steady clock ticks, 0 = none
+
+    void cancel() { cancelRequested = true; }
+
+    // Brief comment: stops the operation timeoutMs from now (<= 0 removes the deadline)
+    void setTimeout(int timeoutMs) {
+        deadline = timeoutMs > 0 ? (Clock::now() + std::chrono::milliseconds(timeoutMs)).time_since_epoch().count() : 0;
+    }
+
+    bool timedOut() const {
+        Clock::rep d = deadline;
+        return d != 0 && Clock::now().time_since_epoch().count() >= d;
+    }
+
+    // Brief comment: true once cancel() was called or the deadline passed
+    bool stopped() const { return cancelRequested || timedOut(); }
+
+    void reset() {
+        total = 0;
+        done = 0;
+        failed = 0;
+        cancelRequested = false;
+        deadline = 0;
+    }
+};
+
+// Brief comment: null-safe helpers for functions that take an optional operation
+inline bool OperationStopped(const HubOperation* op) { return op && op->stopped(); }
+inline void OperationAddTotal(HubOperation* op, size_t n) { if (op) op->total += n; }
+inline void OperationStep(HubOperation* op, bool ok = true) {
+    if (!op) return;
+    if (!ok) ++op->failed;
+    ++op->done;
+}
+
+// --------------------- Preset store ---------------------
+
+// Brief comment: makes a string JSON-safe by escaping special characters
+std::string escapeJson(const std::string& s);
+
+// Brief comment: writes a state (routing of all levels, labels, description) as JSON preset;
+//                false when the file cannot be written
+bool SavePreset(const std::string& filename, const VideoHubState& state);
+
+// Brief comment: parses the routing object "key": { "out": in, ... } of a preset file
+void ParsePresetRouting(const std::string& json, const std::string& key, std::map<int, int>& routing);
+
+// Brief comment: parses the label object "key": { "n": "label", ... } of a preset file
+void ParsePresetLabels(const std::string& json, const std::string& key, std::map<int, std::string>& labels);
+
+// Brief comment: reads a preset written by SavePreset into state; false when the file cannot be opened
+bool LoadPreset(const std::string& filename, VideoHubState& state);
+
+// Brief comment: description of a preset file, or "(cannot open)" / "(no description)"
+std::string GetPresetDescription(const std::string& filePath);
+
+// Brief comment: all presets (*.json) of a folder as pairs <name, description>;
+//                op counts the files read (partial list when stopped)
+std::vector<std::pair<std::string, std::string>> ListPresets(const std::string& folder = "presets",
+    HubOperation* op = nullptr);
+
+// --------------------- Preset catalog ---------------------
+// Name and description of every preset, prepared once for searching:
+// lower-cased text plus a bit mask of the characters it contains, so a
+// search rejects most presets with one AND before looking at the text.
+// A search keeps the candidates of every prefix of its query, so each
+// typed character only filters the survivors of the previous one and
+// backspace costs nothing; re-ranking stays well under a frame for tens
+// of thousands of presets.
+
+// Brief comment: searchable list of presets (sorted by name)
+struct PresetCatalog {
+    std::vector<std::string> names;
+    std::vector<std::string> descriptions;
+    std::vector<std::string> keys;      // lower-case "name description"
+    std::vector<uint64_t> masks;        // characters present in key (see PresetCharMask)
+};
+
+// Brief comment: builds the catalog from ListPresets output
+PresetCatalog BuildPresetCatalog(std::vector<std::pair<std::string, std::string>> presets);
+
+// Brief comment: one ranked search result
+struct PresetMatch {
+    uint32_t index = 0;   // into the catalog
+    int score = 0;        // higher = better
+};
+
+// Brief comment: state of an incremental search over a catalog
+struct PresetSearch {
+    const PresetCatalog* catalog = nullptr;
+    std::string query;                              // lower case
+    std::vector<std::vector<uint32_t>> candidates;  // per query length: presets that still match
+    std::vector<PresetMatch> ranked;                // best matches first (at most the limit)
+    size_t matches = 0;                             // all presets matching the query
+};
+
+// Brief comment: starts a search over a catalog (empty query: all presets in name order)
+void StartPresetSearch(PresetSearch& s, const PresetCatalog& catalog, size_t limit);
+
+// Brief comment: sets the query and ranks again; incremental when it extends or shortens the last query.
+//                Space separated words must all match (fuzzy: in order, gaps allowed)
+void UpdatePresetSearch(PresetSearch& s, const std::string& query, size_t limit);
+
+// Brief comment: fuzzy score of a query against one catalog entry, -1 when it does not match
+int ScorePresetMatch(const PresetCatalog& catalog, size_t index, const std::string& query);
+
+// --------------------- Label index ---------------------
+// Resolves typed port names ("CAM 3") against the live labels of a hub.
+// Labels are lower-cased and split into trigrams (padded with a space
+// at both ends, so word starts and ends count); a query only looks at
+// the labels that share a trigram with it. A label equal to the query
+// (also when only the spaces differ) resolves with one hash lookup.
+
+// Brief comment: trigram index over the labels of one side (inputs or outputs)
+struct LabelIndex {
+    std::vector<int> ports;                                        // port per entry (ascending)
+    std::vector<std::string> labels;                               // label as on the hub
+    std::vector<std::string> keys;                                 // lower case, single spaces
+    std::vector<uint16_t> trigramCounts;                           // distinct trigrams per entry
+    std::unordered_map<std::string, uint32_t> exact;               // key -> entry (kNoEntry: label used twice)
+    std::unordered_map<std::string, uint32_t> compact;             // key without spaces -> entry ("cam3" = "CAM 3")
+    std::unordered_map<uint32_t, std::vector<uint32_t>> trigrams;  // trigram -> entries
+
+    static constexpr uint32_t kNoEntry = 0xFFFFFFFFu;
+};
+
+// Brief comment: builds the index from a label map (port -> label)
+LabelIndex BuildLabelIndex(const std::map<int, std::string>& labels);
+
+// Brief comment: one candidate for a typed name
+struct LabelMatch {
+    int port = -1;
+    int score = 0;        // higher = better
+    bool exact = false;   // label equals the query (ignoring spaces), or the query is the port number
+};
+
+// Brief comment: candidates for a typed name, best first (at most maxResults).
+//                "#N" or a number N that is no label selects port N (1-based, as on the hub panel).
+//                Exact labels first, then labels starting with the query, containing it at a word
+//                start, containing it anywhere, and last labels with enough trigrams in common (typos)
+std::vector<LabelMatch> ResolveLabel(const LabelIndex& index, const std::string& query, size_t maxResults = 8);
+
+// --------------------- Address resolution ---------------------
+// Hubs can be addressed by IPv4 literal, IPv6 literal (optionally in
+// [brackets]) or host name. Literals are parsed directly; host names
+// are resolved with getaddrinfo on a background thread and cached, so
+// loops that manage many hubs never block on a lookup: they start all
+// lookups at once (prefetch) and connect when a result is ready.
+
+// Brief comment: one socket address (IPv4 or IPv6) produced by the resolver
+struct ResolvedAddress {
+    sockaddr_storage addr{};
+    int len = 0;
+};
+
+// Brief comment: removes [] around an IPv6 literal
+std::string StripAddressBrackets(const std::string& host);
+
+// Brief comment: parses an IPv4 or IPv6 literal; false for host names
+bool ParseAddressLiteral(const std::string& host, ResolvedAddress& out);
+
+// Brief comment: sets the port of a resolved address
+void SetAddressPort(ResolvedAddress& a, int port);
+
+// Brief comment: true for an IPv4/IPv6 literal or a syntactically valid host name
+bool IsValidHubAddress(const std::string& host);
+
+// Brief comment: splits "host", "host:port", "[v6]:port" or a bare IPv6 literal;
+//                port keeps its value when none is given
+bool SplitHubAddress(const std::string& spec, std::string& host, int& port);
+
+// -----------------------------------------------------------
+// Struct: HubResolver
+// Purpose:  Asynchronous host name resolution with a cache.
+// Operation:
+//   - prefetch() starts a getaddrinfo on a detached thread, unless
+//     the name is a literal, cached, or already being resolved
+//   - tryGet() never blocks: it reports whether a result is ready
+//   - resolve() waits up to a timeout (for one-shot menu actions)
+//   - Results stay cached for ttlSeconds, failures for
+//     negativeTtlSeconds. getaddrinfo does not expose the DNS record
+//     TTL, so the cache lifetime is a fixed, configurable value.
+// Notes:    Thread-safe; lookup threads only touch their own job.
+// -----------------------------------------------------------
+struct HubResolver {
+    int ttlSeconds = 60;
+    int negativeTtlSeconds = 5;
+
+    struct Job {
+        std::atomic<bool> done{ false };
+        std::vector<ResolvedAddress> addrs;
+    };
+    struct Entry {
+        std::vector<ResolvedAddress> addrs;  // empty after a failed lookup
+        Clock::time_point expires;
+        std::shared_ptr<Job> pending;        // lookup in flight
+    };
+
+    std::mutex mu;
+    std::map<std::string, Entry> cache;
+
+    // Brief comment: runs getaddrinfo for host on a detached thread (mu must be held)
+    void startLookup(const std::string& host, Entry& e) {
+        auto job = std::make_shared<Job>();
+        e.pending = job;
+        std::thread([job, host]() {
+            WSADATA wsa;
+            bool wsaOk = WSAStartup(MAKEWORD(2, 2), &wsa) == 0; // the caller may clean up Winsock first
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_protocol = IPPROTO_TCP;
+            addrinfo* res = nullptr;
+            if (getaddrinfo(host.c_str(), nullptr, &hints, &res) == 0) {
+                for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+                    if (ai->ai_family != AF_INET && ai->ai_family != AF_INET6) continue;
+                    ResolvedAddress a;
+                    std::memcpy(&a.addr, ai->ai_addr, ai->ai_addrlen);
+                    a.len = static_cast<int>(ai->ai_addrlen);
+                    job->addrs.push_back(a);
+                }
+                freeaddrinfo(res);
+            }
+            if (wsaOk) WSACleanup();
+            job->done = true;
+        }).detach();
+    }
+
+    // Brief comment: starts a lookup unless the name is a literal, cached or in flight
+    void prefetch(const std::string& host) {
+        ResolvedAddress literal;
+        if (ParseAddressLiteral(host, literal)) return;
+        std::lock_guard<std::mutex> lock(mu);
+        Entry& e = cache[host];
+        if (!e.pending && (e.expires == Clock::time_point{} || Clock::now() >= e.expires))
+            startLookup(host, e);
+    }
+
+    // Brief comment: non-blocking; true when a result is known (failed = name did not resolve).
+    //                An expired entry is refreshed in the background while its old
+    //                addresses are still returned.
+    bool tryGet(const std::string& host, std::vector<ResolvedAddress>& out, bool& failed) {
+        out.clear();
+        failed = false;
+        ResolvedAddress literal;
+        if (ParseAddressLiteral(host, literal)) {
+            out.push_back(literal);
+            return true;
+        }
+        std::lock_guard<std::mutex> lock(mu);
+        auto it = cache.find(host);
+        if (it == cache.end()) return false;
+        Entry& e = it->second;
+        if (e.pending && e.pending->done) {
+            e.addrs = e.pending->addrs;
+            e.expires = Clock::now() + std::chrono::seconds(e.addrs.empty() ? negativeTtlSeconds : ttlSeconds);
+            e.pending.reset();
+        }
+        if (!e.pending && e.expires != Clock::time_point{} && Clock::now() >= e.expires)
+            startLookup(host, e);
+        if (!e.addrs.empty()) {
+            out = e.addrs;
+            return true;
+        }
+        if (e.pending || e.expires == Clock::time_point{}) return false;
+        failed = true;
+        return true;
+    }
+
+    // Brief comment: prefetch + wait up to timeoutMs; true when at least one address is known
+    bool resolve(const std::string& host, std::vector<ResolvedAddress>& out, int timeoutMs = 3000) {
+        prefetch(host);
+        auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        bool failed = false;
+        while (!tryGet(host, out, failed)) {
+            if (Clock::now() >= deadline) return false;
+            Sleep(5);
+        }
+        return !failed;
+    }
+
+    // Brief comment: true when connecting to host will not wait for a lookup
+    bool ready(const std::string& host) {
+        std::vector<ResolvedAddress> out;
+        bool failed;
+        if (tryGet(host, out, failed)) return true;
+        prefetch(host);
+        return false;
+    }
+};
+
+// Brief comment: the process-wide resolver cache used when no other resolver is given
+HubResolver& SharedHubResolver();
+
+// Brief comment: connects to a hub (literal or host name) with a connect timeout per address;
+//                INVALID_SOCKET on failure. Winsock must be initialized by the caller.
+SOCKET ConnectToHub(const std::string& host, int port, int timeoutMs,
+    HubResolver& resolver = SharedHubResolver());
+
+// --------------------- Protocol parser ---------------------
+
+// Brief comment: reads a non-negative number at pos (leading blanks skipped) and moves pos behind it
+bool ParseIndexAt(const std::string& s, size_t& pos, int& value);
+
+// Brief comment: parses "index label" lines of a labels block into mapOut
+void parseLabelTokens(const std::vector<std::string>& toks,
+    std::map<int, std::string>& mapOut);
+
+// Brief comment: one protocol block, e.g. "VIDEO OUTPUT ROUTING:" followed by its lines
+struct HubBlock {
+    std::string header;              // header without trailing ':' ("ACK" / "NAK" have none)
+    std::vector<std::string> lines;  // body lines without line endings
+};
+
+// -----------------------------------------------------------
+// Struct: HubBlockReader
+// Purpose:  Splits the TCP byte stream of a hub into protocol blocks.
+//           A block is a header line plus body lines, terminated by
+//           an empty line. Data may arrive in any fragmentation;
+//           an incomplete block stays buffered until the rest arrives.
+// Usage:    reader.feed(buf, n); while (reader.next(block)) { ... }
+// -----------------------------------------------------------
+struct HubBlockReader {
+    std::string pending;  // received bytes ('\r' removed)
+    size_t head = 0;      // start of the first unconsumed block in pending
+    size_t scanPos = 0;   // where the search for the terminating blank line resumes
+
+    void feed(const char* data, size_t n) {
+        // compact once the consumed part dominates the buffer
+        if (head > 0 && head * 2 >= pending.size()) {
+            pending.erase(0, head);
+            scanPos -= head;
+            head = 0;
+        }
+        // bulk append; '\r' is rare (CRLF senders) and removed afterwards
+        size_t from = pending.size();
+        pending.append(data, n);
+        if (std::memchr(data, '\r', n))
+            pending.erase(std::remove(pending.begin() + from, pending.end(), '\r'), pending.end());
+    }
+
+    bool next(HubBlock& block) {
+        // skip blank lines between blocks
+        while (head < pending.size() && pending[head] == '\n') ++head;
+        if (scanPos < head) scanPos = head;
+
+        size_t end = pending.find("\n\n", scanPos);
+        if (end == std::string::npos) {
+            scanPos = pending.size() > head ? pending.size() - 1 : head;
+            return false;
+        }
+
+        block.header.clear();
+        block.lines.clear();
+        size_t p = head;
+        bool first = true;
+        while (p <= end) {
+            size_t nl = pending.find('\n', p);
+            std::string line = pending.substr(p, nl - p);
+            if (first) {
+                if (!line.empty() && line.back() == ':') line.pop_back();
+                block.header = line;
+                first = false;
+            }
+            else {
+                block.lines.push_back(line);
+            }
+            p = nl + 1;
+        }
+        head = end + 2;
+        scanPos = head;
+        return true;
+    }
+};
+
+// Brief comment: parses "output input" lines of a routing block
+std::vector<std::pair<int, int>> ParseRoutingLines(const std::vector<std::string>& lines);
+
+// Brief comment: one routing command block ("header:" + "output input" lines)
+std::string BuildRoutingBlock(const std::string& header, const std::map<int, int>& changes);
+
+// Brief comment: parses "port word" lines (serial directions, locks)
+void ParsePortWordLines(const std::vector<std::string>& lines, std::map<int, std::string>& out);
+
+// Brief comment: parses "Key: value" lines (device info, configuration, alarms)
+void ParseKeyValueLines(const std::vector<std::string>& lines, std::map<std::string, std::string>& out);
+
+// Brief comment: a label as it may be sent in a labels block (one line)
+std::string LabelForProtocol(const std::string& label);
+
+// Brief comment: protocol text of a block (header, lines, blank line)
+std::string HubBlockText(const HubBlock& b);
+
+// --------------------- Live hub session ---------------------
+// A persistent connection to one hub. The hub sends its full state
+// (the prelude) on connect and afterwards pushes every change as a
+// protocol block to all connected clients. The session keeps a live
+// mirror of labels and routing up to date from those blocks.
+
+// Brief comment: one configuration or alarm change seen on a session
+struct HubEvent {
+    Clock::time_point at;
+    const char* kind;       // "configuration" or "alarm"
+    std::string key;
+    std::string previous;   // empty when the key was not known yet
+    std::string value;
+};
+
+// Brief comment: persistent connection to one hub with its live mirror
+struct HubSession {
+    std::string ip;
+    int port = 9990;
+    SOCKET sock = INVALID_SOCKET;
+    HubBlockReader reader;
+    VideoHubState mirror;                       // live labels and routing
+    std::map<std::string, std::string> device;  // VIDEOHUB DEVICE: key -> value
+    bool preludeDone = false;                   // END PRELUDE: received
+    std::string prelude;                        // prelude blocks as received (device info, registry)
+    std::deque<Clock::time_point> pendingAcks;  // stamp per unacknowledged command block
+    Clock::time_point lastReceived;             // last time any data arrived (keepalive)
+    std::vector<std::string> configurationLines; // last CONFIGURATION body (change detection)
+    std::vector<std::string> alarmLines;         // last ALARM STATUS body; empty = model has no alarms
+    std::vector<HubEvent> events;                // configuration / alarm changes not yet taken
+    uint64_t labelChanges = 0;                   // label blocks applied (rebuild label indexes when it moves)
+
+    bool connected() const { return sock != INVALID_SOCKET; }
+};
+
+// Brief comment: closes the session socket and drops buffered data
+void CloseHubSession(HubSession& s);
+
+// Brief comment: reads whatever is available on the socket into the block reader
+bool ReadIntoSession(HubSession& s);
+
+// Brief comment: updates configuration or alarm values from their block and queues change events
+void TrackStatusBlock(HubSession& s, const HubBlock& b, std::vector<std::string>& lastLines,
+    std::map<std::string, std::string>& values, const char* kind);
+
+// Brief comment: updates the mirror from one block; returns the video routing changes
+std::vector<std::pair<int, int>> ApplyBlockToMirror(HubSession& s, const HubBlock& b);
+
+// Brief comment: pops the stamp of the oldest command on ACK/NAK; returns false for other blocks
+bool PopHubAck(HubSession& s, const HubBlock& b, Clock::time_point& stamp, bool& acked);
+
+// Brief comment: sends one command block and remembers its stamp for ACK matching
+bool SendHubCommand(HubSession& s, const std::string& block, Clock::time_point stamp = Clock::now());
+
+// Brief comment: asks the hub for its configuration and, on models that report them, its alarms
+bool PollHubStatus(HubSession& s);
+
+// Brief comment: waits up to timeoutMs for data on any session; returns the number that received data
+int WaitForSessions(const std::vector<HubSession*>& sessions, int timeoutMs);
+
+// Brief comment: closes a session and clears its mirror for a new prelude (configuration and alarms are kept)
+void ResetHubSession(HubSession& s);
+
+// Brief comment: connects a session and reads the prelude into its mirror (false when op stopped it)
+bool OpenHubSession(HubSession& s, int timeoutMs = 3000, HubOperation* op = nullptr);
+
+// Brief comment: after a wait that ended early: drops the answers still owed (up to timeoutMs),
+//                else reconnects; true when the session is usable again
+bool DrainHubAnswers(HubSession& s, int timeoutMs);
+
+// Brief comment: one-shot read of a hub (own Winsock init, own connection)
+bool FetchHubState(const std::string& ip, int port, VideoHubState& state, std::string& preambleOut,
+    size_t expectedBytes = 0, HubOperation* op = nullptr);
+
+// --------------------- Apply and diff ---------------------
+
+// Brief comment: sends routes one by one and waits for each ACK/NAK; NAKed outputs go to rejected;
+//                op counts the routes (NAK = failed) and stops before the next route
+bool ApplyRoutingOnSession(HubSession& s, const std::map<int, int>& routing, std::vector<int>& rejected,
+    const std::function<void(int, int)>& onAccepted = nullptr,
+    const char* header = "VIDEO OUTPUT ROUTING", HubOperation* op = nullptr);
+
+// Brief comment: routes of one level in a salvo, with the routes they replace
+struct SalvoLevel {
+    const RoutingLevel* level = nullptr;
+    std::map<int, int> routes;    // output -> new source
+    std::map<int, int> previous;  // output -> source before the salvo (known outputs only)
+    bool acked = false;
+};
+
+// Brief comment: outcome of one salvo
+struct SalvoResult {
+    std::vector<SalvoLevel> levels;  // levels with routes to change, in table order
+    bool answered = false;           // every block got ACK or NAK in time
+    bool applied = false;            // every block acknowledged
+    bool rolledBack = false;         // a rollback salvo was acknowledged
+    double ackMs = 0.0;              // write to last answer
+};
+
+// Brief comment: per level the routes of target that differ from the mirror
+std::vector<SalvoLevel> BuildSalvo(const VideoHubState& target, const VideoHubState& mirror);
+
+// Brief comment: sends one routing block per non-empty level in one write without waiting;
+//                sent = index into blocks per expected answer
+bool WriteSalvoBlocks(HubSession& s, const std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>>& blocks,
+    std::vector<size_t>& sent);
+
+// Brief comment: sends one routing block per level in one write and waits for all answers
+//                (false when op stopped the wait, its owed answers are then drained; after a
+//                timeout the caller settles the session with DrainHubAnswers)
+bool SendSalvoBlocks(HubSession& s, const std::vector<std::pair<const RoutingLevel*, const std::map<int, int>*>>& blocks,
+    std::vector<bool>& acked, int timeoutMs = 2000, HubOperation* op = nullptr);
+
+// Brief comment: takes the routing of all levels of target as one salvo, rolled back on NAK or timeout;
+//                a stopped op counts as timeout (nothing is sent when it stopped before)
+SalvoResult ApplySalvoOnSession(HubSession& s, const VideoHubState& target, int timeoutMs = 2000,
+    HubOperation* op = nullptr);
+
+// Brief comment: one output of a preset/hub comparison (-1 = not present on that side)
+struct RouteComparison {
+    int output;
+    int presetInput;
+    int hubInput;
+    bool differs() const { return presetInput != hubInput; }
+};
+
+// Brief comment: compares two routing maps output by output (union of both)
+std::vector<RouteComparison> CompareRouting(const std::map<int, int>& preset, const std::map<int, int>& hub);
+
+// --------------------- Command scheduler ---------------------
+// One session can carry several kinds of work at once: operator takes,
+// replication, label pushes, status refreshes. The hub answers in send
+// order, so a block that was sent first delays everything behind it.
+// The scheduler queues commands per class and decides what to send:
+// takes and replication go out at once, bulk classes (labels, refresh)
+// are cut into small blocks and only one bulk block is in flight at a
+// time. A take therefore waits behind at most one small bulk block.
+// All commands of a session must go through its scheduler, otherwise
+// answers cannot be matched.
+// Users: replication targets (replication and labels classes) and the
+// OSC mode (takes). The console menus (apply, route by name, grid) take
+// on a session of their own without other traffic and send directly.
+
+enum class CommandClass { Take, Replication, Labels, Refresh };
+const int kCommandClasses = 4;
+
+// Brief comment: console name of a command class
+const char* CommandClassName(CommandClass c);
+
+// Brief comment: true for the classes that are chunked and limited to one block in flight
+bool IsBulkClass(CommandClass c);
+
+// Brief comment: counters and latencies of one command class
+struct CommandClassStats {
+    long queued = 0;                // blocks scheduled (after chunking)
+    long acked = 0, naked = 0, lost = 0;
+    double sumWaitMs = 0.0, maxWaitMs = 0.0;         // scheduled -> sent
+    double sumLatencyMs = 0.0, maxLatencyMs = 0.0;   // scheduled -> answered
+    std::vector<double> recentLatencyMs;             // last kLatencySamples answers (ring)
+    size_t nextSample = 0;
+    static const size_t kLatencySamples = 1024;
+};
+
+// Brief comment: latency percentile (0..100) over the recent answers of a class, 0 without samples
+double CommandLatencyPercentile(const CommandClassStats& stats, double percentile);
+
+// Brief comment: called once per scheduled command when all its blocks are answered
+//                (acked = every block ACKed; latencyMs = scheduled -> last answer, -1 when lost)
+using CommandDone = std::function<void(bool acked, double latencyMs)>;
+
+// -----------------------------------------------------------
+// Struct: HubCommandScheduler
+// Purpose:  Priority queues of command blocks for one session.
+// Usage:    ScheduleCommand(...) from anywhere in the loop,
+//           PumpScheduler after scheduling and after answers,
+//           HandleScheduledAnswer for every ACK/NAK block,
+//           DropScheduledCommands after the session was (re)opened.
+// -----------------------------------------------------------
+struct HubCommandScheduler {
+    struct Group {
+        size_t remaining = 0;
+        bool allAcked = true;
+        CommandDone done;
+    };
+    struct Command {
+        CommandClass cls = CommandClass::Take;
+        std::string block;
+        Clock::time_point queued;
+        Clock::time_point sent;
+        std::shared_ptr<Group> group;   // shared by the chunks of one command
+    };
+
+    size_t chunkLines = 16;            // body lines per bulk block
+    std::deque<Command> queues[kCommandClasses];
+    std::deque<Command> inFlight;      // sent, oldest first (= answer order)
+    size_t bulkInFlight = 0;
+    CommandClassStats stats[kCommandClasses];
+};
+
+// Brief comment: queues a command block; bulk classes are split into blocks of chunkLines lines.
+//                queued = time the latency is measured from (default now)
+void ScheduleCommand(HubCommandScheduler& q, CommandClass cls, const std::string& block,
+    CommandDone done = nullptr, Clock::time_point queued = Clock::now());
+
+// Brief comment: sends what the priorities allow; false when the connection was lost
+bool PumpScheduler(HubCommandScheduler& q, HubSession& s);
+
+// Brief comment: matches an ACK/NAK to the oldest sent block; false for other blocks
+bool HandleScheduledAnswer(HubCommandScheduler& q, HubSession& s, const HubBlock& b);
+
+// Brief comment: forgets queued and in-flight commands (counted as lost, done(false, -1))
+void DropScheduledCommands(HubCommandScheduler& q);
+
+// --------------------- C ABI ---------------------
+// vh_* functions for C and other languages: see VideoHubCoreC.h
+#include "VideoHubCoreC.h"
@@ -0,0 +1,103 @@
+/* VideoHubCoreC.h
+   C interface of the Videohub core library (VideoHubCore.cpp). Plain C89
+   types and an opaque handle, usable from C, C#, Python (ctypes) or code
+   built with another compiler.
+
+   Stability: function signatures and the values of the VH_* constants do
+   not change; new functions are only added at the end.
+
+   Return codes are VH_OK (0) or a negative VH_ERR_* value. Indexes are
+   0-based as in the protocol. A session handle is used by one thread at
+   a time (except vh_cancel); different handles are independent.
+
+   Usage:
+      vh_session* s = vh_open("192.168.1.248", 0, 3000);
+      if (s) {
+          vh_route(s, VH_LEVEL_VIDEO, 0, 3, 2000);
+          vh_close(s);
+      }
+*/
+
+#pragma once
+
+#if defined(VIDEOHUBCORE_EXPORTS)
+#define VIDEOHUBCORE_API __declspec(dllexport)
+#elif defined(VIDEOHUBCORE_DLL)
+#define VIDEOHUBCORE_API __declspec(dllimport)
+#else
+#define VIDEOHUBCORE_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct vh_session vh_session;
+
+enum {
+    VH_OK = 0,
+    VH_ERR_ARGUMENT = -1,     /* null handle, unknown level/kind, index out of range */
+    VH_ERR_CONNECTION = -2,   /* not connected or connection lost */
+    VH_ERR_TIMEOUT = -3,      /* the hub did not answer in time */
+    VH_ERR_REJECTED = -4,     /* the hub answered NAK */
+    VH_ERR_FILE = -5,         /* preset file cannot be read or written */
+    VH_ERR_CANCELLED = -6     /* the call was ended by vh_cancel */
+};
+
+enum {
+    VH_LEVEL_VIDEO = 0,       /* index into the routing level table */
+    VH_LEVEL_MONITORING = 1,
+    VH_LEVEL_SERIAL = 2
+};
+
+enum {
+    VH_PORTS_INPUT = 0,
+    VH_PORTS_OUTPUT = 1,
+    VH_PORTS_MONITORING = 2,
+    VH_PORTS_SERIAL = 3
+};
+
+/* connects and reads the prelude; NULL on failure (port 0 = 9990) */
+VIDEOHUBCORE_API vh_session* vh_open(const char* host, int port, int timeout_ms);
+
+/* closes the connection and frees the handle (NULL is ignored) */
+VIDEOHUBCORE_API void vh_close(vh_session* s);
+
+/* 1 while the session is connected */
+VIDEOHUBCORE_API int vh_connected(const vh_session* s);
+
+/* processes hub changes for up to timeout_ms; number of blocks applied or VH_ERR_* */
+VIDEOHUBCORE_API int vh_poll(vh_session* s, int timeout_ms);
+
+/* number of ports of one VH_PORTS_* kind as known from the hub */
+VIDEOHUBCORE_API int vh_port_count(const vh_session* s, int kind);
+
+/* source routed to an output of a level, or -1 when unknown */
+VIDEOHUBCORE_API int vh_get_route(const vh_session* s, int level, int output);
+
+/* copies a label (UTF-8, zero terminated, cut to size) and returns its full length */
+VIDEOHUBCORE_API int vh_get_label(const vh_session* s, int kind, int index, char* buf, int size);
+
+/* routes one output of a level and waits for the ACK. After VH_ERR_TIMEOUT or
+   VH_ERR_CANCELLED the handle has dropped the late answer (or reconnected),
+   so the next call never sees it; VH_ERR_CONNECTION when reconnecting failed */
+VIDEOHUBCORE_API int vh_route(vh_session* s, int level, int output, int source, int timeout_ms);
+
+/* takes a preset file as one salvo (all levels, rollback on NAK); on
+   VH_ERR_TIMEOUT / VH_ERR_CANCELLED the handle is settled as for vh_route */
+VIDEOHUBCORE_API int vh_apply_preset(vh_session* s, const char* filename, int timeout_ms);
+
+/* saves the live hub state as preset file */
+VIDEOHUBCORE_API int vh_save_preset(const vh_session* s, const char* filename, const char* description);
+
+/* number of routes of a preset file (all levels) that differ from the hub */
+VIDEOHUBCORE_API int vh_compare_preset(const vh_session* s, const char* filename);
+
+/* ends the vh_route / vh_apply_preset call running on s; may be called from
+   any thread, no effect when no call is running. An interrupted preset
+   is rolled back. */
+VIDEOHUBCORE_API void vh_cancel(vh_session* s);
+
+#ifdef __cplusplus
+}
+#endif
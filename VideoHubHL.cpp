@@ -28,14 +28,18 @@ Features:
    - Input labels
    - Output labels
    - Video output routing
+   - Monitoring output labels and routing (Smart Videohub models)
+   - Serial (RS-422) port labels, routing, directions and locks
    - Dynamically scalable for 12x12, 40x40, or other models
 3. Save the read hub status as a preset in JSON format,
    including a short description provided by the user.
 4. Load a preset from a JSON file, displaying
-   the description and routing.
-5. Delete a preset JSON file.
-6. Write a loaded preset back to the Videohub
-   (with console feedback per output). Only routing is applied.
+   the description and routing. Presets are picked from a list that
+   filters while typing (fuzzy match on name and description).
+5. Delete a preset JSON file (same picker).
+6. Write a loaded preset back to the Videohub as one salvo: the changed
+   routes of all levels in one write, set back on any NAK (with console
+   feedback per output). Only routing is applied.
 7. Compare a loaded preset with the actual hub status,
    making deviations easy to spot.
 8. Menu-based interface via keyboard:
@@ -49,7 +53,86 @@ Features:
    7 = Read VideoHub display all data
        (Displays all hub data including preamble, locks, and extra text,
         unlike option 1 which only shows summarized inputs, outputs, and routing)
-   8 = Change or select IP address
+   8 = Change or select IP address (IPv4, IPv6 or host name,
+       optionally host:port or [IPv6]:port; default port 9990)
+       (fixed addresses, manual entry, parallel discovery of hubs in
+        address ranges, or a hub from the registry 'hubs.json')
+
+   9 = Replicate routing to backup hub(s)
+       (Keeps a persistent session to the current hub and mirrors every
+        routing change onto one or more backup hubs, with optional port
+        mapping from 'replication.json'. Shows replication lag per backup
+        and resyncs with a full diff after a reconnect.)
+  10 = Failover to a spare hub
+       (Keeps a spare hub pre-synchronized (routing and labels), watches
+        the current hub with a PING keepalive and switches the tool to
+        the spare when the current hub is lost. Reports the switchover time.)
+  11 = Route by name
+       (Single crosspoints by label, e.g. "PGM 2 <- CAM 3", on one
+        session kept for all commands. Names resolve through a trigram
+        index of the live labels (exact, #N port number, prefix, word,
+        substring or typo match); ambiguous names are listed to choose.)
+  12 = Crosspoint grid
+       (Live video routing as a matrix, inputs across and outputs down,
+        scrolled through a window-sized viewport; only the visible cells
+        are drawn. Live changes are highlighted for 3 s, differences with
+        the loaded preset are marked, unused inputs are shown dark.)
+
+Hub registry ('hubs.json'):
+- Every hub that is discovered or read is remembered with its
+  last-known preamble, model, port counts, labels and routing.
+- At startup the last used hub is selected and its last-known state
+  is shown immediately, marked stale, while the live state is read
+  in the background.
+
+Command line:
+- VideoHubHL --bench [host[:port]] [--out FILE] [--baseline FILE]
+                     [--save-baseline] [--allow-skipped]
+  Benchmark suite / regression gate: parse MB/s, compare throughput,
+  allocations per operation and, with a (simulated!) hub, fetch and
+  apply latency. Writes bench_results.json and compares it with
+  bench_baseline.json using a tolerance per metric; exit code 1 on
+  a regression. --save-baseline stores the results as new baseline.
+  Baseline metrics that were not measured fail the gate unless
+  --allow-skipped is given.
+- VideoHubHL --bench-parse
+  Checks the protocol parser against a synthetic 288x288 stream fed
+  whole, per TCP segment and down to one byte at a time, and prints
+  the throughput. Exit code 1 on any parse mismatch.
+- VideoHubHL --bench-churn host[:port] [--rates 100,1000,...] [--step S]
+                           [--burst N] [--max-lag MS]
+  Front-panel churn load generator: changes routes at stepped rates
+  (optionally in bursts) and measures how long the live mirror takes
+  to show each change. Reports lag percentiles per rate and the
+  saturation point. Meant for use with VideoHubSim.
+- VideoHubHL --probe-latency host[:port] [host[:port] ...] [--takes N]
+                             [--gap MS] [--batch-sweep 1,2,4,...]
+  Take-to-echo latency probe: fires calibrated takes and reports per
+  hub the time to ACK, to the routing echo per output and to the
+  completed take (p50 / p99 / max). With a batch sweep it recommends
+  the batch size with the most routes per second for the hub model.
+- VideoHubHL --watch host[:port] [host[:port] ...] [--poll MS] [--duration S]
+  Status watch: polls configuration and (where the model reports them)
+  fan / power supply / temperature alarms and prints every change, and
+  every lost or restored connection, as one JSON line on stdout.
+- VideoHubHL --publish host[:port] [--name NAME] [--duration S]
+  Shared-memory export: keeps the live state of one hub (port counts,
+  routing of all levels, labels) in a named shared memory segment for
+  local programs; layout and seqlock read in VideoHubShm.h.
+  VideoHubHL --shm-dump [--name NAME] prints what a consumer reads.
+- VideoHubHL --tsl host[:port] --to host[:port] [--version 3|5] [--screen N]
+                   [--index-offset N] [--text source|output] [--outputs LIST]
+                   [--program LIST] [--preview LIST] [--interval MS]
+  TSL UMD output: drives multiviewer under-monitor displays over UDP,
+  one display per hub output with the routed source's label and a
+  red/green tally when that source is also on a program/preview output.
+  Only changed displays are sent, at most once per interval.
+  VideoHubHL --tsl-listen [port] prints the TSL messages it receives.
+- VideoHubHL --osc host[:port] [--config FILE] [--port N] [--duration S]
+  OSC control: routes, preset recalls and macros triggered by OSC
+  messages over UDP (lighting / show-control desks), mapped in
+  'osc.json'. Each message is one table lookup and one write to the
+  hub; ACK/NAK is reported back to the sender as /videohub/status.
 
 Notes:
 - Input and output numbers in the console match the labeling
@@ -62,6 +145,10 @@ Notes:
 - The code is modular: ReadVideoHub, ReadVideoHubFullDisplay,
   SavePresetMenu, LoadPresetMenu, DeletePresetMenu ApplyPresetToHub, ComparePreset
   are implemented as separate reusable functions.
+- Hub session, protocol parser, preset store, compare and apply live in
+  the core library (VideoHubCore.h / VideoHubCore.cpp, no console I/O,
+  C interface in VideoHubCoreC.h); this file is the console program.
+  Build both: cl /std:c++17 /EHsc VideoHubHL.cpp VideoHubCore.cpp
 - The JSON format makes presets easy to share and human-readable.
 
 Author: [Henk Levels with a lot of help from ChatGPT]
@@ -75,388 +162,200 @@ Date: [2025-09-10]
 #include <iostream>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <filesystem>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <cctype>
+#include <chrono>
+#include <deque>
+#include <algorithm>
+#include <ctime>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <cmath>       // isfinite
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <conio.h>     // _kbhit / _getch to stop long-running modes
+#include "VideoHubShm.h" // shared-memory layout for --publish
+#include "VideoHubCore.h" // session, parser, presets, diff and apply
 
 
 #pragma comment(lib, "Ws2_32.lib")
 std::string version = "v1.0";
 namespace fs = std::filesystem;
 
-// --------------------- Data structure ---------------------
-struct VideoHubState {
-    std::map<int, std::string> inputLabels;   // Input labels per channel
-    std::map<int, std::string> outputLabels;  // Output labels per channel
-    std::map<int, int> routing;               // Routing table: output -> input
-    std::string description;                  // Description of the preset
-    std::string filename;                     // Last used preset file
-};
-
 // --------------------- Hub connection ---------------------
 //std::string hubIP = "192.168.1.248"; // Configurable VideoHub IP address 12x12
 std::string hubIP = "172.20.5.247"; // Configurable VideoHub IP address 40x40
-const int hubPort = 9990;            // TCP port of the VideoHub
+int hubPort = 9990;                  // TCP port of the VideoHub (other ports e.g. for simulators)
 
 // Status variables
 std::string gLoadedPreset = "";  // Name of loaded preset
 bool gVideoHubRead = false;      // Status: whether VideoHub has been read
-
-// --------------------- String / network helpers ---------------------
-
-// Brief comment: wrapper to use std::string IP address with inet_pton
-int inet_pton_wrap(int af, const std::string& src, void* dst) {
-    return inet_pton(af, src.c_str(), dst);
-}
-
-// Brief comment: checks if a string is a valid IPv4 address
-bool IsValidIPv4(const std::string& ip) {
-    sockaddr_in sa{};
-    return inet_pton_wrap(AF_INET, ip, &sa.sin_addr) == 1;
-}
-
-// --------------------- JSON helpers ---------------------
-
-// Brief comment: makes a string JSON-safe by escaping special characters
-std::string escapeJson(const std::string& s) {
-    std::ostringstream o;
-    for (char c : s) {
-        switch (c) {
-        case '\"': o << "\\\""; break;
-        case '\\': o << "\\\\"; break;
-        case '\n': o << "\\n"; break;
-        default: o << c; break;
-        }
+bool gVideoHubStale = false;     // Status: hub state shown is the cached last-known state
+unsigned gHubStateSeq = 0;       // Status: bumped whenever currentHub gets newer live data
+HubResolver& gResolver = SharedHubResolver(); // host name cache shared with the core library
+
+// --------------------- JSON reader (configuration files) ---------------------
+
+// Brief comment: minimal JSON value used for configuration files (replication, ...)
+struct JsonValue {
+    enum class Type { Null, Bool, Number, String, Array, Object };
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string str;
+    std::vector<JsonValue> items;                            // array elements
+    std::vector<std::pair<std::string, JsonValue>> members;  // object members in file order
+
+    // Brief comment: returns the member with the given key, or nullptr
+    const JsonValue* get(const std::string& key) const {
+        for (auto& m : members)
+            if (m.first == key) return &m.second;
+        return nullptr;
     }
-    return o.str();
-}
-
-// -----------------------------------------------------------
-// Function: SavePreset
-// Purpose:  Saves the current VideoHubState to a JSON file.
-// Params:
-//   filename = name of the file where the preset will be saved
-//   state    = VideoHubState struct with inputs, outputs, routing and description
-// Process:
-//   1. Opens the file for writing (ofstream)
-//   2. Writes the "description" (using escapeJson)
-//   3. Writes the routing table (output -> input)
-//   4. Writes the input labels (key -> value, using escapeJson)
-//   5. Writes the output labels (key -> value, using escapeJson)
-//   6. Closes the JSON object properly with braces
-//   7. Prints a console message that the file has been saved
-// Notes:
-//   - escapeJson is used to safely escape special characters
-//   - The JSON is indented for readability
-// -----------------------------------------------------------
-void SavePreset(const std::string& filename, const VideoHubState& state) {
-    std::ofstream f(filename);
-    if (!f) {
-        std::cerr << "Error writing file: " << filename << "\n";
-        return;
+    int asInt(int def = 0) const {
+        if (type == Type::Number) return static_cast<int>(number);
+        if (type == Type::String) { try { return std::stoi(str); } catch (...) {} }
+        return def;
     }
-
-    f << "{\n";
-    f << "  \"description\": \"" << escapeJson(state.description) << "\",\n";
-
-    f << "  \"routing\": {\n";
-    bool first = true;
-    for (auto& kv : state.routing) {
-        if (!first) f << ",\n";
-        f << "    \"" << kv.first << "\": " << kv.second;
-        first = false;
+    std::string asString(const std::string& def = "") const {
+        return type == Type::String ? str : def;
     }
-    f << "\n  },\n";
-
-    f << "  \"inputs\": {\n";
-    first = true;
-    for (auto& kv : state.inputLabels) {
-        if (!first) f << ",\n";
-        f << "    \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
-        first = false;
+    double asNumber(double def = 0.0) const {
+        return type == Type::Number ? number : def;
     }
-    f << "\n  },\n";
-
-    f << "  \"outputs\": {\n";
-    first = true;
-    for (auto& kv : state.outputLabels) {
-        if (!first) f << ",\n";
-        f << "    \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
-        first = false;
+    bool asBool(bool def = false) const {
+        return type == Type::Bool ? boolean : def;
     }
-    f << "\n  }\n";
-
-    f << "}\n";
-    std::cout << "Preset saved to " << filename << "\n";
-}
+};
 
 // -----------------------------------------------------------
-// Function: LoadPreset
-// Purpose:  Loads a VideoHub preset from a JSON file into a VideoHubState struct.
-// Params:
-//   filename = name of the JSON file containing the preset
-//   state    = reference to the VideoHubState struct to be populated
-// Return:  true  -> preset successfully loaded
-//          false -> error opening the file
-// Process:
-//   1. Open the file and read its contents into a string
-//   2. Reset the struct (description, routing, inputLabels, outputLabels)
-//   3. Manually parse the JSON:
-//        - description
-//        - routing table (output -> input)
-//        - input labels (key -> name)
-//        - output labels (key -> name)
-//   4. Set state.filename to the used filename
+// Function: ParseJsonValue
+// Purpose:  Recursive descent parser for one JSON value starting at pos.
+// Return:   true on success, pos points behind the value
 // Notes:
-//   - This is a simple JSON parser, no external library
-//   - Expects a strict JSON format as produced by SavePreset
+//   - Supports objects, arrays, strings (with escapes), numbers,
+//     true/false/null. \uXXXX escapes outside ASCII become '?'.
 // -----------------------------------------------------------
-bool LoadPreset(const std::string& filename, VideoHubState& state) {
-    std::ifstream f(filename);
-    if (!f) {
-        std::cerr << "Error opening file: " << filename << "\n";
-        return false;
-    }
-
-    std::stringstream buffer;
-    buffer << f.rdbuf();
-    std::string json = buffer.str();
-
-    state.description.clear();
-    state.routing.clear();
-    state.inputLabels.clear();
-    state.outputLabels.clear();
-
-    // Description
-    size_t dpos = json.find("\"description\"");
-    if (dpos != std::string::npos) {
-        size_t q1 = json.find('"', dpos + 13);
-        size_t q2 = json.find('"', q1 + 1);
-        if (q1 != std::string::npos && q2 != std::string::npos)
-            state.description = json.substr(q1 + 1, q2 - q1 - 1);
-    }
-
-    // Routing table
-    size_t rpos = json.find("\"routing\"");
-    if (rpos != std::string::npos) {
-        size_t b1 = json.find('{', rpos);
-        size_t b2 = json.find('}', b1);
-        std::string block = json.substr(b1 + 1, b2 - b1 - 1);
-        std::istringstream iss(block);
-        std::string line;
-        while (std::getline(iss, line, ',')) {
-            size_t q1 = line.find('"');
-            size_t q2 = line.find('"', q1 + 1);
-            if (q1 != std::string::npos && q2 != std::string::npos) {
-                int outIdx = std::stoi(line.substr(q1 + 1, q2 - q1 - 1));
-                size_t colon = line.find(':', q2);
-                if (colon != std::string::npos) {
-                    int inIdx = std::stoi(line.substr(colon + 1));
-                    state.routing[outIdx] = inIdx;
+bool ParseJsonValue(const std::string& t, size_t& pos, JsonValue& out) {
+    auto skipWs = [&]() { while (pos < t.size() && std::isspace(static_cast<unsigned char>(t[pos]))) ++pos; };
+    auto parseString = [&](std::string& s) -> bool {
+        if (pos >= t.size() || t[pos] != '"') return false;
+        ++pos;
+        s.clear();
+        while (pos < t.size() && t[pos] != '"') {
+            char c = t[pos++];
+            if (c == '\\' && pos < t.size()) {
+                char e = t[pos++];
+                switch (e) {
+                case 'n': s.push_back('\n'); break;
+                case 't': s.push_back('\t'); break;
+                case 'r': s.push_back('\r'); break;
+                case 'b': s.push_back('\b'); break;
+                case 'f': s.push_back('\f'); break;
+                case 'u': {
+                    if (pos + 4 > t.size()) return false;
+                    int code = std::stoi(t.substr(pos, 4), nullptr, 16);
+                    s.push_back(code < 0x80 ? static_cast<char>(code) : '?');
+                    pos += 4;
+                    break;
+                }
+                default: s.push_back(e); break; // \" \\ \/
                 }
             }
+            else s.push_back(c);
         }
-    }
+        if (pos >= t.size()) return false;
+        ++pos; // closing quote
+        return true;
+    };
 
-    // Input labels
-    size_t ipos = json.find("\"inputs\"");
-    if (ipos != std::string::npos) {
-        size_t b1 = json.find('{', ipos);
-        size_t b2 = json.find('}', b1);
-        std::string block = json.substr(b1 + 1, b2 - b1 - 1);
-        std::istringstream iss(block);
-        std::string line;
-        while (std::getline(iss, line, ',')) {
-            size_t q1 = line.find('"');
-            size_t q2 = line.find('"', q1 + 1);
-            if (q1 != std::string::npos && q2 != std::string::npos) {
-                int idx = std::stoi(line.substr(q1 + 1, q2 - q1 - 1));
-                size_t q3 = line.find('"', q2 + 1);
-                size_t q4 = line.find('"', q3 + 1);
-                if (q3 != std::string::npos && q4 != std::string::npos) {
-                    std::string name = line.substr(q3 + 1, q4 - q3 - 1);
-                    state.inputLabels[idx] = name;
-                }
-            }
+    skipWs();
+    if (pos >= t.size()) return false;
+    char c = t[pos];
+    if (c == '{') {
+        out.type = JsonValue::Type::Object;
+        ++pos;
+        skipWs();
+        if (pos < t.size() && t[pos] == '}') { ++pos; return true; }
+        while (true) {
+            skipWs();
+            std::string key;
+            if (!parseString(key)) return false;
+            skipWs();
+            if (pos >= t.size() || t[pos] != ':') return false;
+            ++pos;
+            JsonValue v;
+            if (!ParseJsonValue(t, pos, v)) return false;
+            out.members.emplace_back(key, std::move(v));
+            skipWs();
+            if (pos < t.size() && t[pos] == ',') { ++pos; continue; }
+            if (pos < t.size() && t[pos] == '}') { ++pos; return true; }
+            return false;
         }
     }
-
-    // Output labels
-    size_t opos = json.find("\"outputs\"");
-    if (opos != std::string::npos) {
-        size_t b1 = json.find('{', opos);
-        size_t b2 = json.find('}', b1);
-        std::string block = json.substr(b1 + 1, b2 - b1 - 1);
-        std::istringstream iss(block);
-        std::string line;
-        while (std::getline(iss, line, ',')) {
-            size_t q1 = line.find('"');
-            size_t q2 = line.find('"', q1 + 1);
-            if (q1 != std::string::npos && q2 != std::string::npos) {
-                int idx = std::stoi(line.substr(q1 + 1, q2 - q1 - 1));
-                size_t q3 = line.find('"', q2 + 1);
-                size_t q4 = line.find('"', q3 + 1);
-                if (q3 != std::string::npos && q4 != std::string::npos) {
-                    std::string name = line.substr(q3 + 1, q4 - q3 - 1);
-                    state.outputLabels[idx] = name;
-                }
-            }
+    if (c == '[') {
+        out.type = JsonValue::Type::Array;
+        ++pos;
+        skipWs();
+        if (pos < t.size() && t[pos] == ']') { ++pos; return true; }
+        while (true) {
+            JsonValue v;
+            if (!ParseJsonValue(t, pos, v)) return false;
+            out.items.push_back(std::move(v));
+            skipWs();
+            if (pos < t.size() && t[pos] == ',') { ++pos; continue; }
+            if (pos < t.size() && t[pos] == ']') { ++pos; return true; }
+            return false;
         }
     }
-
-    state.filename = filename;
-    return true;
-}
-
-// --------------------- Send / Recv helpers ---------------------
-
-// Brief comment: sends all bytes of a buffer through a socket
-bool sendAll(SOCKET s, const std::vector<unsigned char>& data) {
-    const char* ptr = reinterpret_cast<const char*>(data.data());
-    int remaining = (int)data.size();
-    while (remaining > 0) {
-        int sent = send(s, ptr, remaining, 0);
-        if (sent == SOCKET_ERROR) return false;
-        remaining -= sent;
-        ptr += sent;
+    if (c == '"') {
+        out.type = JsonValue::Type::String;
+        return parseString(out.str);
     }
+    if (t.compare(pos, 4, "true") == 0) { out.type = JsonValue::Type::Bool; out.boolean = true; pos += 4; return true; }
+    if (t.compare(pos, 5, "false") == 0) { out.type = JsonValue::Type::Bool; pos += 5; return true; }
+    if (t.compare(pos, 4, "null") == 0) { out.type = JsonValue::Type::Null; pos += 4; return true; }
+
+    size_t end = pos;
+    while (end < t.size() && (std::isdigit(static_cast<unsigned char>(t[end])) ||
+        t[end] == '-' || t[end] == '+' || t[end] == '.' || t[end] == 'e' || t[end] == 'E'))
+        ++end;
+    if (end == pos) return false;
+    try { out.number = std::stod(t.substr(pos, end - pos)); }
+    catch (...) { return false; }
+    out.type = JsonValue::Type::Number;
+    pos = end;
     return true;
 }
 
-// -----------------------------------------------------------
-// Function: recvAllWithTimeout
-// Purpose:  Receives data from a socket with a timeout.
-// Params:
-//   s         = socket
-//   out       = vector where received bytes are stored
-//   timeoutMs = timeout in milliseconds (default 250 ms)
-// Return:  true  -> data was received
-//          false -> no data received
-// Process:
-//   1. Uses select() to wait until data is available
-//   2. Receives data in chunks of up to 8192 bytes
-//   3. After the first receive, the timeout is shortened to 80 ms for subsequent data
-// -----------------------------------------------------------
-bool recvAllWithTimeout(SOCKET s, std::vector<unsigned char>& out, int timeoutMs = 250) {
-    out.clear();
-    char buf[8192];
-    fd_set readfds;
-    while (true) {
-        FD_ZERO(&readfds);
-        FD_SET(s, &readfds);
-        timeval tv;
-        tv.tv_sec = timeoutMs / 1000;
-        tv.tv_usec = (timeoutMs % 1000) * 1000;
-        int sel = select((int)s + 1, &readfds, NULL, NULL, &tv);
-        if (sel > 0) {
-            int rec = recv(s, buf, (int)sizeof(buf), 0);
-            if (rec <= 0) break;
-            out.insert(out.end(), buf, buf + rec);
-            timeoutMs = 80; // shortened timeout for subsequent data
-        }
-        else break;
-    }
-    return !out.empty();
-}
-
-// ------------------------------------------------------------
-// Function: extractSection
-// ------------------------------------------------------------
-// Purpose:
-//   Extracts a specific section from a larger text (e.g. the Videohub preamble).
-//   The section starts at a marker (e.g. "INPUT LABELS:")
-//   and ends at the first encountered marker from endMarkers.
-//
-// Parameters:
-//   - text:        the full text to search in
-//   - startMarker: the beginning of the section we want
-//   - endMarkers:  list of possible end markers
-//
-// Return:
-//   - The substring containing the section content
-//   - Empty string if startMarker is not found
-// ------------------------------------------------------------
-std::string extractSection(
-    const std::string& text,
-    const std::string& startMarker,
-    const std::vector<std::string>& endMarkers)
-{
-    // Find the start marker
-    size_t p = text.find(startMarker);
-    if (p == std::string::npos)
-        return {};  // marker not found
-
-    // Start right after the marker
-    p += startMarker.size();
-
-    // Find the first end marker
-    size_t end = std::string::npos;
-    for (auto& em : endMarkers) {
-        size_t q = text.find(em, p);
-        if (q != std::string::npos && (end == std::string::npos || q < end))
-            end = q;
-    }
-
-    // If no end marker found → take until end of text
-    if (end == std::string::npos)
-        end = text.size();
-
-    // Return the substring
-    return text.substr(p, end - p);
-}
-
-// ---------------------------------------------------------
-// Function: splitTokens
-// Purpose:  Splits a string based on newlines ('\n', '\r')
-//           and dots ('.'), returning a vector of tokens.
-// Input:    s - the string to split
-// Output:   std::vector<std::string> - list of tokens
-// Note:     Empty tokens are removed
-// ---------------------------------------------------------
-std::vector<std::string> splitTokens(const std::string& s) {
-    std::vector<std::string> out;
-    std::string cur;
-    for (char c : s) {
-        if (c == '\n' || c == '\r' || c == '.') {
-            if (!cur.empty()) {
-                out.push_back(cur);
-                cur.clear();
-            }
-        }
-        else {
-            cur.push_back(c);
-        }
+// Brief comment: reads and parses a JSON file, prints an error on failure
+bool LoadJsonFile(const std::string& filename, JsonValue& out) {
+    std::ifstream f(filename);
+    if (!f) return false;
+    std::stringstream buffer;
+    buffer << f.rdbuf();
+    std::string text = buffer.str();
+    size_t pos = 0;
+    out = JsonValue{};
+    if (!ParseJsonValue(text, pos, out)) {
+        std::cerr << "Error parsing JSON file: " << filename << " (near offset " << pos << ")\n";
+        return false;
     }
-    if (!cur.empty()) out.push_back(cur);
-    return out;
+    return true;
 }
 
-// ---------------------------------------------------------
-// Function: parseLabelTokens
-// Purpose:  Parses tokens that contain labels and stores them in a map
-//           from index -> label.
-// Input:    toks   - vector of tokens, e.g. ["0 Input1", "1 Input2"]
-//           mapOut - map<int,std::string> to store results
-// Output:   Fills mapOut with index->label pairs
-// Note:     If a label is empty, "(unnamed)" is used
-// ---------------------------------------------------------
-void parseLabelTokens(const std::vector<std::string>& toks,
-    std::map<int, std::string>& mapOut) {
-    for (auto& tok : toks) {
-        if (tok.empty()) continue;
-        std::istringstream iss(tok);
-        int idx;
-        iss >> idx;
-        std::string label;
-        std::getline(iss, label);
-        if (label.empty()) label = "(unnamed)";
-        mapOut[idx] = label;
-    }
-}
 
 // -----------------------------------------
 // PrintLabels dynamic
@@ -534,10 +433,12 @@ void PrintLabels(const std::map<int, std::string>& labels, const std::string& ti
 // Params:   outputLabels = map<int,std::string> output index -> name
 //           inputLabels  = map<int,std::string> input index -> name
 //           routing      = map<int,int> output index -> input index
+//           title        = table title (default "Routing")
 // -----------------------------------------------------------
 void PrintRouting(const std::map<int, std::string>& outputLabels,
     const std::map<int, std::string>& inputLabels,
-    const std::map<int, int>& routing) {
+    const std::map<int, int>& routing,
+    const std::string& title = "Routing") {
 
     // determine column widths based on longest name
     size_t maxOutLen = 0, maxInLen = 0;
@@ -548,7 +449,7 @@ void PrintRouting(const std::map<int, std::string>& outputLabels,
     int inColWidth = static_cast<int>(maxInLen) + 6;
 
     // header row with setw for proper alignment
-    std::cout << "\nRouting:\n";
+    std::cout << "\n" << title << ":\n";
     std::cout << std::left
         << std::setw(6) << "OutpNr"
         << std::setw(outColWidth) << " OutpName"
@@ -576,13 +477,57 @@ void PrintRouting(const std::map<int, std::string>& outputLabels,
     }
 }
 
+// -----------------------------------------------------------
+// Function: PrintExtraRoutingLevels
+// Purpose:  Print labels and routing of the routing levels beyond
+//           video (monitoring outputs, serial ports), only when the hub
+//           has them.
+// -----------------------------------------------------------
+void PrintExtraRoutingLevels(const VideoHubState& state) {
+    for (auto& level : kRoutingLevels) {
+        if (IsVideoLevel(level) || (state.*level.routing).empty()) continue;
+        PrintLabels(state.*level.outputLabels, std::string(level.outputNoun) + "s");
+        PrintRouting(state.*level.outputLabels, state.*level.sourceLabels, state.*level.routing,
+            std::string(level.name) + " routing");
+    }
+}
+
+// -----------------------------------------------------------
+// Function: PrintSerialPorts
+// Purpose:  Print direction and lock state per serial port, only when
+//           the hub reported them.
+// -----------------------------------------------------------
+void PrintSerialPorts(const VideoHubState& state) {
+    if (state.serialDirections.empty() && state.serialLocks.empty()) return;
+    std::cout << "\nSerial port directions / locks:\n";
+    std::cout << std::left << std::setw(6) << "Port" << std::setw(20) << "Label"
+        << std::setw(10) << "Direction" << "Lock\n";
+    std::set<int> ports;
+    for (auto& kv : state.serialDirections) ports.insert(kv.first);
+    for (auto& kv : state.serialLocks) ports.insert(kv.first);
+    for (int p : ports) {
+        auto label = state.serialLabels.find(p);
+        auto dir = state.serialDirections.find(p);
+        auto lock = state.serialLocks.find(p);
+        std::cout << std::left << std::setw(6) << (p + 1)
+            << std::setw(20) << (label != state.serialLabels.end() ? label->second : "")
+            << std::setw(10) << (dir != state.serialDirections.end() ? dir->second : "-")
+            << (lock != state.serialLocks.end() ? lock->second : "-") << "\n";
+    }
+}
+
+
+// Defined with the hub registry further below
+void RememberHubState(const std::string& ip, int port, const VideoHubState& state, const std::string& preamble);
+size_t ExpectedPreludeBytes(const std::string& ip, int port);
 
 // ------------------------------------------------------------
 // Function: FetchVideoHubData
 // ------------------------------------------------------------
 // Purpose:
-//   Fetches data from the VideoHub via TCP, parses the various
-//   sections (preamble, inputs, outputs, routing) and fills the state object.
+//   Reads the current hub (hubIP / hubPort) via FetchHubState,
+//   updates the status flags and stores the result in the hub
+//   registry as last-known state.
 //
 // Parameters:
 //   - state:       Struct to be filled with labels and routing
@@ -593,94 +538,15 @@ void PrintRouting(const std::map<int, std::string>& outputLabels,
 //   - false on failure (no connection or incomplete data)
 // ------------------------------------------------------------
 bool FetchVideoHubData(VideoHubState& state, std::string& preambleOut) {
-    SOCKET s = INVALID_SOCKET;
-
-    // Initialize Winsock
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
-
-    s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (s == INVALID_SOCKET) {
-        WSACleanup();
-        return false;
-    }
-
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(hubPort);
-    inet_pton_wrap(AF_INET, hubIP, &addr.sin_addr);
-
-    if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        closesocket(s);
-        WSACleanup();
+    if (!FetchHubState(hubIP, hubPort, state, preambleOut, ExpectedPreludeBytes(hubIP, hubPort)))
         return false;
-    }
-
-    // commands
-    std::vector<unsigned char> cmdPreamble = { 0x00 };
-    std::vector<unsigned char> cmdGetInputs = { 0x01 };
-    std::vector<unsigned char> cmdGetOutputs = { 0x02 };
-    std::vector<unsigned char> cmdGetRouting = { 0x03 };
-
-    std::vector<unsigned char> recvBuf;
-    std::string fullPreamble, fullInputs, fullOutputs, fullRouting;
-
-    if (sendAll(s, cmdPreamble) && recvAllWithTimeout(s, recvBuf, 500))
-        fullPreamble = { recvBuf.begin(), recvBuf.end() };
-
-    if (sendAll(s, cmdGetInputs) && recvAllWithTimeout(s, recvBuf, 500))
-        fullInputs = { recvBuf.begin(), recvBuf.end() };
-
-    if (sendAll(s, cmdGetOutputs) && recvAllWithTimeout(s, recvBuf, 500))
-        fullOutputs = { recvBuf.begin(), recvBuf.end() };
-
-    if (sendAll(s, cmdGetRouting) && recvAllWithTimeout(s, recvBuf, 500))
-        fullRouting = { recvBuf.begin(), recvBuf.end() };
-
-    closesocket(s);
-    WSACleanup();
-
-    // return preamble
-    preambleOut = fullPreamble;
-
-    // combine all data
-    std::string all = fullPreamble + "\n" + fullInputs + "\n" + fullOutputs + "\n" + fullRouting;
-
-    // markers
-    std::vector<std::string> endMarkers = {
-        "OUTPUT LABELS:", "VIDEO OUTPUT ROUTING:", "VIDEO OUTPUT LOCKS:",
-        "END PRELUDE:", "INPUT LABELS:"
-    };
-
-    // extract sections (fallback using extractSection if empty)
-    std::string inputsSection = fullInputs.empty() ? extractSection(all, "INPUT LABELS:", endMarkers) : fullInputs;
-    std::string outputsSection = fullOutputs.empty() ? extractSection(all, "OUTPUT LABELS:", endMarkers) : fullOutputs;
-    std::string routingSection = fullRouting.empty() ? extractSection(all, "VIDEO OUTPUT ROUTING:", endMarkers) : fullRouting;
-
-    // split tokens
-    auto inputTokens = splitTokens(inputsSection);
-    auto outputTokens = splitTokens(outputsSection);
-    auto routingTokens = splitTokens(routingSection);
-
-    // reset state
-    state.inputLabels.clear();
-    state.outputLabels.clear();
-    state.routing.clear();
-
-    // parse labels
-    parseLabelTokens(inputTokens, state.inputLabels);
-    parseLabelTokens(outputTokens, state.outputLabels);
-
-    for (auto& tok : routingTokens) {
-        std::istringstream iss(tok);
-        int outIdx, inIdx;
-        if (iss >> outIdx >> inIdx)
-            state.routing[outIdx] = inIdx;
-    }
 
     gVideoHubRead = true;
+    gVideoHubStale = false;
+    ++gHubStateSeq;   // a background read started before this one is older
     std::cout << "\nVideoHubRead status updated.\n";
 
+    RememberHubState(hubIP, hubPort, state, preambleOut);
     return true;
 }
 
@@ -713,6 +579,7 @@ void ReadVideoHub(VideoHubState& state) {
     PrintLabels(state.outputLabels, "Outputs");
 
     PrintRouting(state.outputLabels, state.inputLabels, state.routing);
+    PrintExtraRoutingLevels(state);
 }
 
 // -----------------------------------------------------------
@@ -778,7 +645,8 @@ void PrintSectionLabels(const std::map<int, std::string>& labels,
 // Function: ReadVideoHubFullDisplay
 // Purpose:  Reads the status of the VideoHub and displays it fully
 //           in the console, including preamble, input/output labels,
-//           video output locks, and routing, all in neat columns.
+//           configuration, alarms, routing of all levels and serial
+//           port directions / locks, all in neat columns.
 // -----------------------------------------------------------
 void ReadVideoHubFullDisplay(VideoHubState& state) {
     std::string preamble;
@@ -799,6 +667,16 @@ void ReadVideoHubFullDisplay(VideoHubState& state) {
         std::cout << line << "\n";
     }
 
+    // --- Configuration / alarms (alarms only on models that report them) ---
+    if (!state.configuration.empty()) {
+        std::cout << "\nConfiguration:\n";
+        for (auto& kv : state.configuration) std::cout << "  " << kv.first << ": " << kv.second << "\n";
+    }
+    if (!state.alarms.empty()) {
+        std::cout << "\nAlarms:\n";
+        for (auto& kv : state.alarms) std::cout << "  " << kv.first << ": " << kv.second << "\n";
+    }
+
     // --- Inputs ---
     PrintLabels(state.inputLabels, "Inputs");
 
@@ -807,532 +685,5021 @@ void ReadVideoHubFullDisplay(VideoHubState& state) {
 
     // --- Routing ---
     PrintRouting(state.outputLabels, state.inputLabels, state.routing);
+    PrintExtraRoutingLevels(state);
+    PrintSerialPorts(state);
 }
 
-// Main function
-// --------------------- Apply preset to Videohub ---------------------
-// This function sends the routing of a loaded preset to the hub.
-// Input and output labels are not sent, only routing.
-// Labels are used only for console feedback.
-void ApplyPresetToHub(VideoHubState& state) {
-    if (state.routing.empty()) {
-        std::cout << "No preset loaded.\n";
-        return;
-    }
+// --------------------- Console reporter ---------------------
+// Console output is slow and its speed depends on the terminal (a
+// scrolling window, a redirected file, a remote session). Loops that
+// take routes therefore do not print: they push small fixed-size events
+// into a lock-free single-producer queue, and a reporter thread renders
+// them. A full queue drops events (counted) instead of stalling a take.
 
-    WSADATA wsa;
-    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+// -----------------------------------------------------------
+// Class: SpscQueue
+// Purpose:  Lock-free ring buffer for exactly one producer thread and
+//           one consumer thread. Fixed capacity (power of two), no
+//           allocation after construction.
+// -----------------------------------------------------------
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    SpscQueue() : slots_(Capacity) {}
+
+    // Brief comment: producer side; false when the queue is full
+    bool push(const T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity) return false;
+        slots_[head & (Capacity - 1)] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
 
-    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (s == INVALID_SOCKET) {
-        WSACleanup();
-        return;
+    // Brief comment: consumer side; false when the queue is empty
+    bool pop(T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        value = slots_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
     }
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(hubPort);
-    inet_pton_wrap(AF_INET, hubIP, &addr.sin_addr);
+private:
+    alignas(64) std::atomic<size_t> head_{ 0 };   // next slot to write (producer)
+    alignas(64) std::atomic<size_t> tail_{ 0 };   // next slot to read (consumer)
+    std::vector<T> slots_;
+};
 
-    if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        closesocket(s);
-        WSACleanup();
-        return;
-    }
+// Brief comment: one thing to report; plain data so pushing never allocates
+struct ReportEvent {
+    enum class Kind : uint8_t {
+        Route,              // level, output, source: one route taken
+        TakeApplied,        // count routes on levels levels, ms = time to the last ACK
+        TakeMatches,        // nothing to send
+        TakeRejected,       // level answered NAK
+        TakeNoAnswer,       // connection lost or no answer in time
+        TakeRolledBack,     // all levels set back
+        TakeRollbackFailed, // rollback not confirmed
+        HubLost,            // host: primary lost
+        PrimaryUp,          // host: primary (re)connected
+        BackupUp,           // host: backup (re)connected
+        ReplicationStopped,
+        PrimaryStatus,      // host, up
+        TargetStatus,       // host, up and the replication counters
+        ClassStatus         // what = command class; count answers, ms / p99Ms / maxMs = p50 / p99 / max
+    };
+    Kind kind = Kind::Route;
+    const RoutingLevel* level = nullptr;
+    int output = 0;
+    int source = 0;
+    size_t count = 0;
+    size_t levels = 0;
+    bool up = false;
+    double ms = 0.0;                // TakeApplied: ack time; TargetStatus: last lag
+    double avgMs = 0.0, maxMs = 0.0;
+    double p99Ms = 0.0;             // ClassStatus
+    long routesSent = 0, naks = 0;
+    int resyncs = 0;
+    const char* what = nullptr;
+    char host[64] = {};
+};
 
-    std::cout << "Sending routing preset to Videohub...\n";
+// Brief comment: copies a host name into an event (cut to fit)
+void SetReportHost(ReportEvent& e, const std::string& host) {
+    size_t n = std::min(host.size(), sizeof(e.host) - 1);
+    std::memcpy(e.host, host.data(), n);
+    e.host[n] = '\0';
+}
 
-    char buffer[8192];
-    int bytesReceived = recv(s, buffer, sizeof(buffer) - 1, 0);
-    if (bytesReceived > 0) {
-        buffer[bytesReceived] = '\0';
-        std::cout << "Initial response from hub:\n" << buffer << "\n";
+// -----------------------------------------------------------
+// Class: ConsoleReporter
+// Purpose:  Renders ReportEvents on its own thread, in posting order.
+// Params:   labels = state whose labels name the ports of Route events
+//           (must not change while the reporter runs), may be nullptr
+// Notes:    One producer thread per reporter. The destructor prints
+//           what is still queued, then the number of dropped events.
+// -----------------------------------------------------------
+class ConsoleReporter {
+public:
+    explicit ConsoleReporter(const VideoHubState* labels = nullptr)
+        : labels_(labels), thread_([this]() { run(); }) {}
+
+    ~ConsoleReporter() {
+        stop_ = true;
+        thread_.join();
+        if (dropped_ > 0) std::cout << "(" << dropped_ << " console message(s) dropped)\n";
     }
 
-    // Send an ASCII command for each route in the preset
-    for (auto& kv : state.routing) {
-        int outIdx = kv.first;
-        int inIdx = kv.second;
+    ConsoleReporter(const ConsoleReporter&) = delete;
+    ConsoleReporter& operator=(const ConsoleReporter&) = delete;
 
-        std::ostringstream cmd;
-        cmd << "VIDEO OUTPUT ROUTING:\n"
-            << outIdx << " " << inIdx << "\n\n";
-        std::string command = cmd.str();
+    // Brief comment: never blocks; counts the event as dropped when the queue is full
+    void post(const ReportEvent& e) {
+        if (!queue_.push(e)) ++dropped_;
+    }
 
-        int sent = send(s, command.c_str(), (int)command.size(), 0);
-        if (sent == SOCKET_ERROR) {
-            std::cerr << "Failed sending output " << outIdx << "\n";
-        }
-        else {
-            // Console feedback with labels
-            std::string outName = state.outputLabels.count(outIdx) ? state.outputLabels[outIdx] : "(unknown)";
-            std::string inName = state.inputLabels.count(inIdx) ? state.inputLabels[inIdx] : "(unknown)";
-            std::cout << "  Output " << (outIdx + 1) << " (" << outName << ") <- Input "
-                << (inIdx + 1) << " (" << inName << ")\n";
-
-            // Optionally read response from hub
-            bytesReceived = recv(s, buffer, sizeof(buffer) - 1, 0);
-            if (bytesReceived > 0) {
-                buffer[bytesReceived] = '\0';
-                std::cout << "Hub update:\n" << buffer << "\n";
+    // Brief comment: waits for room instead of dropping; for output that must not be lost,
+    //                posted where nothing time-critical is running
+    void postWait(const ReportEvent& e) {
+        while (!queue_.push(e)) std::this_thread::yield();
+    }
+
+private:
+    void run() {
+        ReportEvent e;
+        while (true) {
+            // read stop_ before draining: an event posted after an empty pop
+            // but before stop_ was set is still taken by this pass
+            bool stopping = stop_;
+            bool any = false;
+            while (queue_.pop(e)) {
+                render(e);
+                any = true;
             }
+            if (any) std::cout.flush();
+            if (stopping) break;
+            if (!any) Sleep(1);
         }
     }
 
-    std::cout << "Preset applied to Videohub.\n";
+    void render(const ReportEvent& e);
 
-    closesocket(s);
-    WSACleanup();
+    const VideoHubState* labels_;
+    SpscQueue<ReportEvent, 1024> queue_;
+    std::atomic<bool> stop_{ false };
+    std::atomic<size_t> dropped_{ 0 };
+    std::thread thread_;   // last member: starts after the others are constructed
+};
+
+// Brief comment: label of a port from a label map, or "(unknown)"
+const std::string& ReportLabel(const VideoHubState* labels, std::map<int, std::string> VideoHubState::* map, int port) {
+    static const std::string unknown = "(unknown)";
+    if (!labels) return unknown;
+    auto it = (labels->*map).find(port);
+    return it != (labels->*map).end() ? it->second : unknown;
+}
+
+void ConsoleReporter::render(const ReportEvent& e) {
+    switch (e.kind) {
+    case ReportEvent::Kind::Route:
+        std::cout << "  " << e.level->outputNoun << " " << (e.output + 1) << " ("
+            << ReportLabel(labels_, e.level->outputLabels, e.output) << ") <- " << e.level->sourceNoun << " "
+            << (e.source + 1) << " (" << ReportLabel(labels_, e.level->sourceLabels, e.source) << ")\n";
+        break;
+    case ReportEvent::Kind::TakeApplied:
+        std::cout << "Preset applied to Videohub: " << e.count << " route(s) on " << e.levels
+            << " level(s), acknowledged in " << std::fixed << std::setprecision(1) << e.ms << " ms.\n";
+        std::cout << std::defaultfloat;
+        break;
+    case ReportEvent::Kind::TakeMatches:
+        std::cout << "Videohub already matches the preset.\n";
+        break;
+    case ReportEvent::Kind::TakeRejected:
+        std::cout << "The hub rejected (NAK) the " << e.level->name << " routes.\n";
+        break;
+    case ReportEvent::Kind::TakeNoAnswer:
+        std::cerr << "Error: connection lost or no answer from hub.\n";
+        break;
+    case ReportEvent::Kind::TakeRolledBack:
+        std::cout << "Preset not applied: all levels were set back to the previous routing.\n";
+        break;
+    case ReportEvent::Kind::TakeRollbackFailed:
+        std::cerr << "Error: rollback not confirmed; check the Videohub routing.\n";
+        break;
+    case ReportEvent::Kind::HubLost:
+        std::cout << "Primary " << e.host << " lost.\n";
+        break;
+    case ReportEvent::Kind::PrimaryUp:
+        std::cout << "Primary " << e.host << " connected, resyncing targets.\n";
+        break;
+    case ReportEvent::Kind::BackupUp:
+        std::cout << "Backup " << e.host << " connected, resyncing.\n";
+        break;
+    case ReportEvent::Kind::ReplicationStopped:
+        std::cout << "\nReplication stopped.\n";
+        break;
+    case ReportEvent::Kind::PrimaryStatus:
+        std::cout << "Primary " << e.host << (e.up ? " [up]" : " [DOWN]") << "\n";
+        break;
+    case ReportEvent::Kind::TargetStatus:
+        std::cout << "  -> " << std::left << std::setw(16) << e.host
+            << (e.up ? " [up]  " : " [DOWN]")
+            << std::fixed << std::setprecision(1)
+            << " lag last " << e.ms << " ms"
+            << ", avg " << e.avgMs << " ms"
+            << ", max " << e.maxMs << " ms"
+            << " | routes sent " << e.routesSent
+            << " | out of sync " << e.count
+            << " | resyncs " << e.resyncs
+            << (e.naks ? " | NAKs " + std::to_string(e.naks) : "")
+            << "\n" << std::defaultfloat;
+        break;
+    case ReportEvent::Kind::ClassStatus:
+        std::cout << "       " << std::left << std::setw(12) << e.what << std::right
+            << std::fixed << std::setprecision(1)
+            << e.count << " block(s), p50 " << e.ms << " ms, p99 " << e.p99Ms << " ms, max " << e.maxMs << " ms\n"
+            << std::defaultfloat;
+        break;
+    }
 }
 
 // Main function
-// Function: SavePresetMenu
-// Purpose:  Prompts the user to save a preset with description and filename
-// Params:   state = VideoHubState struct with current hub status
-// Operation:
-//   1. Checks if hub data is available
-//   2. Creates 'presets' folder if necessary
-//   3. Prompts the user for description and filename
-//   4. Calls SavePreset to save the preset
-void SavePresetMenu(VideoHubState& state) {
+// This function sends the routing of a loaded preset to the hub as one
+// salvo: video, monitoring and serial routes that differ from the hub
+// leave in one write, so deck control follows a video recall and the
+// hub never shows a half-recalled state for long. If the hub rejects
+// any level, all levels are set back.
+// Input and output labels are not sent, only routing.
+// Labels are used only for console feedback. The take is complete
+// before anything is printed; the route lines and the summary go
+// through a ConsoleReporter with postWait, so a large salvo prints
+// every route (as before) instead of dropping lines at a full queue.
+void ApplyPresetToHub(VideoHubState& state) {
     if (state.routing.empty()) {
-        std::cout << "No hub data available. Please read the Videohub first.\n";
+        std::cout << "No preset loaded.\n";
         return;
     }
 
-    if (!fs::exists("presets")) fs::create_directory("presets");
-
-    std::cout << "Do you want to create a new preset? (y/n, 0 = return): ";
-    char confirm;
-    std::cin >> confirm;
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
 
-    if (confirm == '0') {
-        std::cout << "Returning to main menu...\n";
+    HubSession s;
+    s.ip = hubIP;
+    s.port = hubPort;
+    if (!OpenHubSession(s, 3000)) {
+        std::cerr << "Error: Cannot connect to Videohub.\n";
+        WSACleanup();
         return;
     }
-    if (confirm != 'y' && confirm != 'Y') {
-        std::cout << "Preset creation canceled.\n";
-        return;
+
+    std::cout << "Sending routing preset to Videohub...\n";
+
+    SalvoResult r;
+    {
+        // the take runs first; its report is queued afterwards and never dropped
+        ConsoleReporter reporter(&state);
+        r = ApplySalvoOnSession(s, state);
+        ReportEvent e;
+        if (r.levels.empty()) {
+            e.kind = ReportEvent::Kind::TakeMatches;
+            reporter.postWait(e);
+        }
+        else if (r.applied) {
+            e.kind = ReportEvent::Kind::Route;
+            for (auto& sl : r.levels) {
+                e.level = sl.level;
+                for (auto& kv : sl.routes) {
+                    e.output = kv.first;
+                    e.source = kv.second;
+                    reporter.postWait(e);
+                    ++e.count;
+                }
+            }
+            e.kind = ReportEvent::Kind::TakeApplied;
+            e.levels = r.levels.size();
+            e.ms = r.ackMs;
+            reporter.postWait(e);
+        }
+        else {
+            if (!r.answered) {
+                e.kind = ReportEvent::Kind::TakeNoAnswer;
+                reporter.postWait(e);
+            }
+            e.kind = ReportEvent::Kind::TakeRejected;
+            for (auto& sl : r.levels) {
+                e.level = sl.level;
+                if (!sl.acked && r.answered) reporter.postWait(e);
+            }
+            e.kind = r.rolledBack ? ReportEvent::Kind::TakeRolledBack : ReportEvent::Kind::TakeRollbackFailed;
+            reporter.postWait(e);
+        }
     }
 
-    std::cin.ignore(); // flush newline van std::cin
+    CloseHubSession(s);
+    WSACleanup();
+}
 
-    std::cout << "Enter description for preset: ";
-    std::getline(std::cin, state.description);
+// --------------------- Hub-to-hub replication ---------------------
 
-    std::string fname;
-    std::cout << "Enter filename for preset (without extension): ";
-    std::getline(std::cin, fname);
-    if (fname.empty()) fname = "preset";
+// Brief comment: replication state of one routing level on a target
+struct ReplicationLevel {
+    std::map<int, int> desired;    // target output -> source it should have
+    std::map<int, int> inFlight;   // target output -> source sent, echo not yet seen
+    std::set<int> dirty;           // target outputs to check at the next flush
+};
 
-    fname = "presets/" + fname + ".json";
+// Brief comment: one secondary hub that mirrors the primary's routing (all routing levels)
+struct ReplicationTarget {
+    HubSession session;
+    std::map<int, int> outputMap;  // primary output -> target output (0-based), empty = identity
+    std::map<int, int> inputMap;   // primary input -> target input (0-based), empty = identity
+
+    std::map<const RoutingLevel*, ReplicationLevel> levels;
+    bool hasOrigin = false;        // a primary change is waiting in a dirty set
+    Clock::time_point origin;      // receive time of the oldest waiting primary change
+    Clock::time_point nextReconnect;
+    HubCommandScheduler scheduler; // all commands to the target: routes before label pushes
+
+    // statistics
+    double lastLagMs = 0, maxLagMs = 0, sumLagMs = 0;
+    long lagSamples = 0, routesSent = 0, naks = 0;
+    int resyncs = 0;
+};
 
-    // === Nieuw: check of bestand al bestaat ===
-    if (fs::exists(fname)) {
-        std::cout << "File '" << fname << "' already exists.\n";
-        std::cout << "Do you want to overwrite it? (y/n): ";
-        char overwrite;
-        std::cin >> overwrite;
-        if (overwrite != 'y' && overwrite != 'Y') {
-            std::cout << "Preset not saved. Returning...\n";
-            return;
-        }
+// Brief comment: maps a primary port to a target port via map (identity if empty), -1 if unmapped
+int MapReplicationPort(const std::map<int, int>& m, int port) {
+    if (m.empty()) return port;
+    auto it = m.find(port);
+    return it == m.end() ? -1 : it->second;
+}
+
+// Brief comment: records one primary routing change in the target's desired state; the port maps
+//                apply to video outputs and to inputs (video and monitoring sources), serial
+//                ports are mapped one to one
+void QueueReplicationChange(ReplicationTarget& t, const RoutingLevel& level, int primaryOut, int primarySource,
+    Clock::time_point received) {
+    static const std::map<int, int> identity;
+    bool inputSources = level.sourceLabels == &VideoHubState::inputLabels;
+    int out = MapReplicationPort(IsVideoLevel(level) ? t.outputMap : identity, primaryOut);
+    int in = MapReplicationPort(inputSources ? t.inputMap : identity, primarySource);
+    if (out < 0 || in < 0) return;
+    ReplicationLevel& rl = t.levels[&level];
+    rl.desired[out] = in;
+    rl.dirty.insert(out);
+    if (!t.hasOrigin) {
+        t.hasOrigin = true;
+        t.origin = received;
     }
+}
 
-    SavePreset(fname, state);
-    std::cout << "Preset saved as " << fname << "\n";
+// Brief comment: rebuilds the desired state from the full primary routing (resync via full diff)
+void ResyncReplicationTarget(ReplicationTarget& t, const VideoHubState& primary) {
+    t.levels.clear();
+    t.hasOrigin = false;
+    auto now = Clock::now();
+    for (auto& level : kRoutingLevels)
+        for (auto& kv : primary.*level.routing)
+            QueueReplicationChange(t, level, kv.first, kv.second, now);
+    ++t.resyncs;
 }
 
-// Helper: reads the description from a JSON file
-// ----------------------------------------------------------------------------------
-// Function: GetPresetDescription
-// Purpose:  Retrieves the description from a JSON file without using an external library
-// Input:    filePath = path to the preset file (.json)
-// Output:   description string, or a default string if not found / cannot open
-// Operation: - Open the file
-//            - Read line by line
-//            - Look for "description"
-//            - Extract the value between quotes
-// ----------------------------------------------------------------------------------
-std::string GetPresetDescription(const std::string& filePath) {
-    std::ifstream ifs(filePath);
-    if (!ifs.is_open()) return "(cannot open)";
+// Brief comment: false for a monitoring/serial level the (connected) target hub does not have
+bool TargetHasLevel(const ReplicationTarget& t, const RoutingLevel& level) {
+    return IsVideoLevel(level) || !(t.session.mirror.*level.routing).empty();
+}
 
-    std::string line;
-    while (std::getline(ifs, line)) {
-        auto pos = line.find("\"description\"");
-        if (pos != std::string::npos) {
-            auto colon = line.find(":", pos);
-            if (colon != std::string::npos) {
-                auto startQuote = line.find("\"", colon);
-                auto endQuote = line.find("\"", startQuote + 1);
-                if (startQuote != std::string::npos && endQuote != std::string::npos)
-                    return line.substr(startQuote + 1, endQuote - startQuote - 1);
-            }
-            break;
+// Brief comment: number of mapped outputs (all levels the target has) where it differs from the primary
+size_t CountOutOfSync(const ReplicationTarget& t) {
+    size_t diff = 0;
+    for (auto& lv : t.levels) {
+        if (!TargetHasLevel(t, *lv.first)) continue;
+        const std::map<int, int>& live = t.session.mirror.*lv.first->routing;
+        for (auto& kv : lv.second.desired) {
+            auto cur = live.find(kv.first);
+            if (cur == live.end() || cur->second != kv.second) ++diff;
         }
     }
-    return "(no description)";
+    return diff;
 }
 
-// Helper: creates a list of presets with descriptions
-// ----------------------------------------------------------------------------------
-// Function: ListPresets
-// Purpose:  Creates a list of all presets in the given folder with their descriptions
-// Input:    folder = folder containing presets (default: "presets")
-// Output:   vector of pairs <presetName, description>
-// Operation: - Iterate over all .json files in the folder
-//            - For each file, get the name (without extension)
-//            - Get description via GetPresetDescription
-//            - Add to vector
-// ----------------------------------------------------------------------------------
-std::vector<std::pair<std::string, std::string>> ListPresets(const std::string& folder = "presets") {
-    std::vector<std::pair<std::string, std::string>> presets;
-    for (auto& entry : fs::directory_iterator(folder)) {
-        if (entry.path().extension() != ".json") continue;
-        std::string name = entry.path().stem().string();
-        std::string description = GetPresetDescription(entry.path().string());
-        presets.push_back({ name, description });
+// Brief comment: applies a block to the session mirror and returns the routing level it changed
+//                (nullptr for other blocks) with the changed routes
+const RoutingLevel* ApplyReplicationBlock(HubSession& s, const HubBlock& b, std::vector<std::pair<int, int>>& changed) {
+    changed.clear();
+    const RoutingLevel* level = FindRoutingLevel(b.header);
+    if (level) {
+        const std::map<int, int>& live = s.mirror.*level->routing;
+        for (auto& r : ParseRoutingLines(b.lines)) {
+            auto cur = live.find(r.first);
+            if (cur == live.end() || cur->second != r.second) changed.push_back(r);
+        }
     }
-    return presets;
+    ApplyBlockToMirror(s, b);
+    return level;
 }
 
-// Helper: displays the list of presets
-// ----------------------------------------------------------------------------------
-// Function: DisplayPresetMenu
-// Purpose:  Shows the list of available presets in the console
-// Input:    vector of pairs <presetName, description>
-// Output:   Prints the presets with their descriptions
-// Operation: - Iterate over the list
-//            - Print each preset with description
-// ----------------------------------------------------------------------------------
-void DisplayPresetMenu(const std::vector<std::pair<std::string, std::string>>& presets) {
-    std::cout << "\nAvailable presets in 'presets/':\n";
-    for (auto& p : presets) {
-        std::cout << "  - " << p.first << " : " << p.second << "\n";
+// -----------------------------------------------------------
+// Function: SyncReplicationLabels
+// Purpose:  Copies the primary's input labels and the output labels
+//           of every routing level the target has to a target (through
+//           its port maps). Only differing labels are sent.
+// Notes:    The labels are queued as bulk work on the target's
+//           scheduler, so a large push goes out in small blocks and
+//           routing changes overtake it.
+// -----------------------------------------------------------
+void SyncReplicationLabels(ReplicationTarget& t, const VideoHubState& primary) {
+    auto sync = [&](const std::map<int, std::string>& from, const std::map<int, std::string>& current,
+        const std::map<int, int>& portMap, const char* header) {
+        std::ostringstream cmd;
+        bool any = false;
+        for (auto& kv : from) {
+            int port = MapReplicationPort(portMap, kv.first);
+            if (port < 0) continue;
+            auto cur = current.find(port);
+            if (cur != current.end() && cur->second == kv.second) continue;
+            if (!any) cmd << header << ":\n";
+            cmd << port << " " << LabelForProtocol(kv.second) << "\n";
+            any = true;
+        }
+        if (!any) return;
+        cmd << "\n";
+        ScheduleCommand(t.scheduler, CommandClass::Labels, cmd.str());
+    };
+    static const std::map<int, int> identity;
+    sync(primary.inputLabels, t.session.mirror.inputLabels, t.inputMap, "INPUT LABELS");
+    for (auto& level : kRoutingLevels)
+        if (TargetHasLevel(t, level))
+            sync(primary.*level.outputLabels, t.session.mirror.*level.outputLabels,
+                IsVideoLevel(level) ? t.outputMap : identity, level.labelsHeader);
+    PumpScheduler(t.scheduler, t.session);
+}
+
+// -----------------------------------------------------------
+// Function: FlushReplicationTarget
+// Purpose:  Sends all pending differences of a target as one
+//           coalesced routing block per routing level.
+// Operation:
+//   - Only dirty outputs are compared (desired vs live target mirror);
+//     monitoring/serial levels the target lacks are not sent
+//   - Routes already in flight with the same input are not resent
+//   - The block is stamped with the receive time of the oldest
+//     primary change in it, so the ACK gives the replication lag
+//   - A NAK forgets what is in flight on that level and re-checks
+//     every output of it
+// -----------------------------------------------------------
+void FlushReplicationTarget(ReplicationTarget& t) {
+    if (!t.session.connected()) return;
+
+    auto stamp = t.hasOrigin ? t.origin : Clock::now();
+    t.hasOrigin = false;
+    for (auto& lv : t.levels) {
+        const RoutingLevel* level = lv.first;
+        ReplicationLevel& rl = lv.second;
+        if (rl.dirty.empty()) continue;
+        if (!TargetHasLevel(t, *level)) {
+            rl.dirty.clear();
+            continue;
+        }
+
+        const std::map<int, int>& live = t.session.mirror.*level->routing;
+        std::map<int, int> changes;
+        for (int out : rl.dirty) {
+            auto d = rl.desired.find(out);
+            if (d == rl.desired.end()) continue;
+            auto cur = live.find(out);
+            if (cur != live.end() && cur->second == d->second) continue;
+            auto fl = rl.inFlight.find(out);
+            if (fl != rl.inFlight.end() && fl->second == d->second) continue;
+            changes[out] = d->second;
+        }
+        rl.dirty.clear();
+        if (changes.empty()) continue;
+
+        auto done = [&t, level](bool acked, double lagMs) {
+            if (lagMs < 0) return;   // dropped with the connection; the reconnect resyncs
+            if (!acked) {
+                ++t.naks;
+                ReplicationLevel& nl = t.levels[level];
+                nl.inFlight.clear();
+                for (auto& kv : nl.desired) nl.dirty.insert(kv.first);
+                return;
+            }
+            t.lastLagMs = lagMs;
+            if (lagMs > t.maxLagMs) t.maxLagMs = lagMs;
+            t.sumLagMs += lagMs;
+            ++t.lagSamples;
+        };
+        ScheduleCommand(t.scheduler, CommandClass::Replication, BuildRoutingBlock(level->routingHeader, changes),
+            done, stamp);
+        if (PumpScheduler(t.scheduler, t.session)) {
+            for (auto& kv : changes) rl.inFlight[kv.first] = kv.second;
+            t.routesSent += static_cast<long>(changes.size());
+        }
     }
 }
 
-// Helper: asks user for preset choice
-// ----------------------------------------------------------------------------------
-// Function: GetUserPresetChoice
-// Purpose:  Prompts the user to enter the name of a preset
-// Output:   Chosen preset name as a string
-// Operation: - Read input from user via std::getline
-//            - Return the input
-// ----------------------------------------------------------------------------------
-std::string GetUserPresetChoice() {
-    std::string name;
-    std::cin.ignore();
-    std::cout << "\nEnter preset name (without 'presets/' and '.json'): ";
-    std::getline(std::cin, name);
-    return name;
+// Brief comment: handles all complete blocks received from a target hub
+void ProcessReplicationTarget(ReplicationTarget& t) {
+    HubBlock b;
+    std::vector<std::pair<int, int>> changed;
+    while (t.session.reader.next(b)) {
+        if (HandleScheduledAnswer(t.scheduler, t.session, b)) continue;
+        const RoutingLevel* level = ApplyReplicationBlock(t.session, b, changed);
+        if (!level) continue;
+        ReplicationLevel& rl = t.levels[level];
+        for (auto& r : changed) {
+            auto fl = rl.inFlight.find(r.first);
+            if (fl != rl.inFlight.end() && fl->second == r.second) rl.inFlight.erase(fl);
+            // a change made on the backup itself is corrected back to the primary state
+            if (rl.desired.count(r.first)) rl.dirty.insert(r.first);
+        }
+    }
+    PumpScheduler(t.scheduler, t.session);   // answers free the slot for the next bulk block
+}
+
+// -----------------------------------------------------------
+// Function: LoadReplicationConfig
+// Purpose:  Reads the replication setup from a JSON file:
+//   {
+//     "primary": "172.20.5.247",          (optional, default = current hub)
+//     "primaryPort": 9990,                (optional)
+//     "targets": [
+//       { "ip": "172.20.5.248", "port": 9990,
+//         "outputs": { "1": 1, "2": 2 },   (optional, primary -> backup, 1-based)
+//         "inputs":  { "1": 1 } }          (optional, primary -> backup, 1-based)
+//     ]
+//   }
+// Return:   true when at least one target was read
+// -----------------------------------------------------------
+bool LoadReplicationConfig(const std::string& filename, std::string& primaryIp, int& primaryPort,
+    std::vector<ReplicationTarget>& targets) {
+    JsonValue root;
+    if (!LoadJsonFile(filename, root)) return false;
+
+    if (auto* p = root.get("primary")) primaryIp = p->asString(primaryIp);
+    if (auto* p = root.get("primaryPort")) primaryPort = p->asInt(primaryPort);
+
+    auto readMap = [](const JsonValue* obj, std::map<int, int>& m) {
+        if (!obj) return;
+        for (auto& kv : obj->members) {
+            int from = 0;
+            try { from = std::stoi(kv.first); }
+            catch (...) { continue; }
+            int to = kv.second.asInt(0);
+            if (from >= 1 && to >= 1) m[from - 1] = to - 1;
+        }
+    };
+
+    targets.clear();
+    if (auto* list = root.get("targets")) {
+        for (auto& item : list->items) {
+            ReplicationTarget t;
+            if (auto* ip = item.get("ip")) t.session.ip = ip->asString();
+            t.session.port = hubPort;
+            if (auto* port = item.get("port")) t.session.port = port->asInt(hubPort);
+            if (t.session.ip.empty()) continue;
+            readMap(item.get("outputs"), t.outputMap);
+            readMap(item.get("inputs"), t.inputMap);
+            targets.push_back(std::move(t));
+        }
+    }
+    return !targets.empty();
+}
+
+// Brief comment: queues one status line per target (lag, routes sent, resyncs) on the reporter
+void PostReplicationStatus(ConsoleReporter& reporter, const HubSession& primary,
+    const std::vector<ReplicationTarget>& targets) {
+    ReportEvent e;
+    e.kind = ReportEvent::Kind::PrimaryStatus;
+    SetReportHost(e, primary.ip);
+    e.up = primary.connected();
+    reporter.post(e);
+    e.kind = ReportEvent::Kind::TargetStatus;
+    for (auto& t : targets) {
+        SetReportHost(e, t.session.ip);
+        e.up = t.session.connected();
+        e.ms = t.lastLagMs;
+        e.avgMs = t.lagSamples ? t.sumLagMs / t.lagSamples : 0.0;
+        e.maxMs = t.maxLagMs;
+        e.routesSent = t.routesSent;
+        e.count = CountOutOfSync(t);
+        e.resyncs = t.resyncs;
+        e.naks = t.naks;
+        reporter.post(e);
+
+        // latency per command class on the target session (routes vs label pushes)
+        ReportEvent c;
+        c.kind = ReportEvent::Kind::ClassStatus;
+        for (int k = 0; k < kCommandClasses; ++k) {
+            const CommandClassStats& st = t.scheduler.stats[k];
+            if (st.acked + st.naked == 0) continue;
+            c.what = CommandClassName(static_cast<CommandClass>(k));
+            c.count = static_cast<size_t>(st.acked + st.naked);
+            c.ms = CommandLatencyPercentile(st, 50);
+            c.p99Ms = CommandLatencyPercentile(st, 99);
+            c.maxMs = st.maxLatencyMs;
+            reporter.post(c);
+        }
+    }
+}
+
+// Brief comment: behaviour switches for RunReplication
+struct ReplicationOptions {
+    bool syncLabels = false;          // also copy input/output labels to the targets
+    int keepaliveMs = 0;              // PING interval on the primary session, 0 = off
+    int primaryTimeoutMs = 0;         // primary is lost after this long without data, 0 = off
+    bool stopOnPrimaryLoss = false;   // return on primary loss instead of reconnecting (failover)
+};
+
+// Brief comment: why RunReplication returned, with timing for failover reports
+struct ReplicationResult {
+    bool primaryLost = false;
+    Clock::time_point lastPrimaryData;  // last data seen from the primary
+    Clock::time_point detected;         // moment the loss was detected
+};
+
+// -----------------------------------------------------------
+// Function: RunReplication
+// Purpose:  Mirrors the routing of a primary hub onto one or more
+//           backup hubs until a key is pressed (or, with
+//           stopOnPrimaryLoss, until the primary is lost).
+// Operation:
+//   1. Opens persistent sessions to the primary and all targets
+//   2. Each target is brought in sync with a full diff
+//   3. Routing changes pushed by the primary are mapped and queued;
+//      everything that arrives in one wakeup is sent to each target
+//      as one coalesced block (no fixed delay, so lag stays at ~1 RTT)
+//   4. ACKs give the replication lag per target
+//   5. Lost connections are retried; after a reconnect the target
+//      (or, after a primary reconnect, every target) is resynced
+//   6. With keepaliveMs the primary is pinged; silence longer than
+//      primaryTimeoutMs counts as a lost primary. A target reconnect
+//      blocks the loop (up to 1.5 s); that time is not counted as
+//      silence, so an unreachable spare cannot fake a primary loss
+// Notes:    Sessions stay open on return; the caller closes them.
+// -----------------------------------------------------------
+ReplicationResult RunReplication(HubSession& primary, std::vector<ReplicationTarget>& targets,
+    const ReplicationOptions& options = {}) {
+    const auto reconnectInterval = std::chrono::milliseconds(2000);
+    const auto statusInterval = std::chrono::milliseconds(2000);
+    Clock::time_point primaryReconnect = Clock::now();
+    Clock::time_point nextStatus = Clock::now() + statusInterval;
+    Clock::time_point nextPing = Clock::now();
+    Clock::time_point primaryTimeoutFrom;   // end of the last blocking target reconnect
+    ReplicationResult result;
+
+    std::vector<HubSession*> sessions{ &primary };
+    for (auto& t : targets) {
+        t.nextReconnect = Clock::now();
+        sessions.push_back(&t.session);
+    }
+
+    // resolve all host names in parallel; connects below wait only for their own name
+    gResolver.prefetch(primary.ip);
+    for (auto& t : targets) gResolver.prefetch(t.session.ip);
+
+    auto resync = [&](ReplicationTarget& t) {
+        ResyncReplicationTarget(t, primary.mirror);
+        if (options.syncLabels) SyncReplicationLabels(t, primary.mirror);
+    };
+
+    std::cout << "Replication running. Press any key to stop.\n";
+    ConsoleReporter reporter;   // the route loop below never writes to the console itself
+    auto report = [&](ReportEvent::Kind kind, const std::string& host) {
+        ReportEvent e;
+        e.kind = kind;
+        SetReportHost(e, host);
+        reporter.post(e);
+    };
+    bool primaryWasUp = false;
+    while (true) {
+        if (_kbhit()) {
+            _getch();
+            report(ReportEvent::Kind::ReplicationStopped, "");
+            PostReplicationStatus(reporter, primary, targets);
+            break;
+        }
+        auto now = Clock::now();
+
+        // primary loss: dropped connection or keepalive timeout
+        // (time spent blocked in a target reconnect does not count: the primary could not be read)
+        if (primaryWasUp && primary.connected() && options.primaryTimeoutMs > 0 &&
+            ElapsedMs(std::max(primary.lastReceived, primaryTimeoutFrom), now) > options.primaryTimeoutMs) {
+            CloseHubSession(primary);
+        }
+        if (primaryWasUp && !primary.connected()) {
+            primaryWasUp = false;
+            report(ReportEvent::Kind::HubLost, primary.ip);
+            if (options.stopOnPrimaryLoss) {
+                result.primaryLost = true;
+                result.lastPrimaryData = primary.lastReceived;
+                result.detected = now;
+                break;
+            }
+        }
+
+        // (re)connect
+        if (!primary.connected() && now >= primaryReconnect && gResolver.ready(primary.ip)) {
+            primaryReconnect = now + reconnectInterval;
+            if (OpenHubSession(primary, 1500)) {
+                primaryWasUp = true;
+                report(ReportEvent::Kind::PrimaryUp, primary.ip);
+                for (auto& t : targets)
+                    if (t.session.connected()) resync(t);
+            }
+        }
+        for (auto& t : targets) {
+            if (t.session.connected() || now < t.nextReconnect || !gResolver.ready(t.session.ip)) continue;
+            t.nextReconnect = now + reconnectInterval;
+            if (OpenHubSession(t.session, 1500)) {
+                DropScheduledCommands(t.scheduler);   // answers of the old connection never come
+                report(ReportEvent::Kind::BackupUp, t.session.ip);
+                if (primary.connected()) resync(t);
+            }
+            // the connect blocked the loop: restart the primary timeout and ping it right away
+            primaryTimeoutFrom = Clock::now();
+            nextPing = now;
+        }
+
+        if (options.keepaliveMs > 0 && primary.connected() && now >= nextPing) {
+            nextPing = now + std::chrono::milliseconds(options.keepaliveMs);
+            SendHubCommand(primary, "PING:\n\n");
+        }
+
+        WaitForSessions(sessions, 20);
+        auto received = Clock::now();
+
+        // primary changes -> desired state of every target
+        HubBlock b;
+        std::vector<std::pair<int, int>> changed;
+        bool labelsChanged = false;
+        while (primary.reader.next(b)) {
+            Clock::time_point stamp;
+            bool acked;
+            if (PopHubAck(primary, b, stamp, acked)) continue;
+            if (b.header == "INPUT LABELS" || FindLabelsLevel(b.header)) labelsChanged = true;
+            const RoutingLevel* level = ApplyReplicationBlock(primary, b, changed);
+            if (!level) continue;
+            for (auto& r : changed)
+                for (auto& t : targets)
+                    QueueReplicationChange(t, *level, r.first, r.second, received);
+        }
+
+        for (auto& t : targets) {
+            ProcessReplicationTarget(t);
+            FlushReplicationTarget(t);
+            if (labelsChanged && options.syncLabels) SyncReplicationLabels(t, primary.mirror);
+        }
+
+        if (Clock::now() >= nextStatus) {
+            nextStatus = Clock::now() + statusInterval;
+            PostReplicationStatus(reporter, primary, targets);
+        }
+    }
+    return result;
 }
 
 // Main function
-/** LoadPresetMenu
- * ----------------------
- * Displays a numbered list of available presets in the "presets/" folder.
- * The user can choose a preset by entering its number.
- * The chosen preset is loaded into the given VideoHubState.
- * After loading, preset details are displayed:
- *   - Description
- *   - Input labels
- *   - Output labels
- *   - Routing (which input goes to which output)
- *
- * Requirements:
- *   - ListPresets() returns a vector of pairs (name, description)
- *   - LoadPreset(filename, state) loads the preset into state
- *
- * Example usage:
- *   VideoHubState state;
- *   LoadPresetMenu(state);
- */
-void LoadPresetMenu(VideoHubState& state) {
-    auto presets = ListPresets();
-    if (presets.empty()) {
-        std::cout << "Error! No presets found in the 'presets/' folder.\n";
+// -----------------------------------------------------------
+// Function: ReplicateRoutingMenu
+// Purpose:  Starts hub-to-hub routing replication.
+// Operation:
+//   1. Reads 'replication.json' if present (primary, targets, port maps)
+//   2. Otherwise asks for backup IP addresses (identity port mapping)
+//      and uses the current hub as primary
+//   3. Runs RunReplication until a key is pressed
+// -----------------------------------------------------------
+void ReplicateRoutingMenu() {
+    const std::string configFile = "replication.json";
+    std::string primaryIp = hubIP;
+    int primaryPort = hubPort;
+    std::vector<ReplicationTarget> targets;
+
+    if (fs::exists(configFile)) {
+        if (!LoadReplicationConfig(configFile, primaryIp, primaryPort, targets)) {
+            std::cout << "Error! No usable targets in " << configFile << ".\n";
+            return;
+        }
+        std::cout << "Using " << configFile << "\n";
+    }
+    else {
+        std::cout << "Enter backup hub address(es) (IP or host name), separated by spaces (0 = return): ";
+        std::string line;
+        std::cin.ignore();
+        std::getline(std::cin, line);
+        std::istringstream iss(line);
+        std::string ip;
+        while (iss >> ip) {
+            if (ip == "0") return;
+            if (!IsValidHubAddress(ip)) {
+                std::cout << "Invalid address: " << ip << "\n";
+                return;
+            }
+            ReplicationTarget t;
+            t.session.ip = ip;
+            targets.push_back(std::move(t));
+        }
+        if (targets.empty()) {
+            std::cout << "No backup hubs entered.\n";
+            return;
+        }
+    }
+
+    std::cout << "Replicating " << primaryIp << " to";
+    for (auto& t : targets) std::cout << " " << t.session.ip;
+    std::cout << "\n";
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+
+    HubSession primary;
+    primary.ip = primaryIp;
+    primary.port = primaryPort;
+    RunReplication(primary, targets);
+
+    CloseHubSession(primary);
+    for (auto& t : targets) CloseHubSession(t.session);
+    WSACleanup();
+}
+
+// Main function
+// -----------------------------------------------------------
+// Function: FailoverMenu
+// Purpose:  Keeps a spare hub pre-synchronized with the current hub
+//           and switches the tool to the spare when the primary is lost.
+// Operation:
+//   1. Asks for the spare IP address
+//   2. Runs RunReplication with label sync and a PING keepalive
+//      (250 ms interval, primary lost after 1000 ms without data
+//      or when the connection drops)
+//   3. On primary loss: lets routes still in flight land on the spare,
+//      switches hubIP to the spare and reports the switchover time
+// -----------------------------------------------------------
+void FailoverMenu() {
+    std::cout << "Enter spare hub address (IP or host name, 0 = return): ";
+    std::string spareIp;
+    std::cin >> spareIp;
+    if (spareIp == "0") {
+        std::cout << "Returning to main menu...\n";
+        return;
+    }
+    if (!IsValidHubAddress(spareIp)) {
+        std::cout << "Invalid address: " << spareIp << "\n";
+        return;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+
+    HubSession primary;
+    primary.ip = hubIP;
+    primary.port = hubPort;
+    std::vector<ReplicationTarget> targets(1);
+    ReplicationTarget& spare = targets[0];
+    spare.session.ip = spareIp;
+    spare.session.port = hubPort;
+
+    ReplicationOptions options;
+    options.syncLabels = true;
+    options.keepaliveMs = 250;
+    options.primaryTimeoutMs = 1000;
+    options.stopOnPrimaryLoss = true;
+
+    std::cout << "Failover armed: primary " << primary.ip << ", spare " << spareIp << "\n";
+    ReplicationResult result = RunReplication(primary, targets, options);
+
+    if (result.primaryLost) {
+        if (!spare.session.connected()) {
+            std::cout << "!!! Spare " << spareIp << " is not reachable. VideoHub IP left at " << hubIP << ".\n";
+        }
+        else {
+            // let routes already in flight land on the spare (bounded wait)
+            auto drainUntil = Clock::now() + std::chrono::milliseconds(500);
+            while (!spare.session.pendingAcks.empty() && spare.session.connected() && Clock::now() < drainUntil) {
+                WaitForSessions({ &spare.session }, 10);
+                ProcessReplicationTarget(spare);
+                FlushReplicationTarget(spare);
+            }
+            size_t outOfSync = CountOutOfSync(spare);
+
+            hubIP = spare.session.ip;
+            gVideoHubRead = false; // the status read so far belongs to the old primary
+            auto switched = Clock::now();
+
+            std::cout << std::fixed << std::setprecision(1)
+                << "\n=== Failover to spare " << hubIP << " ===\n"
+                << "Detection time:   " << ElapsedMs(result.lastPrimaryData, result.detected) << " ms (last data from primary -> loss detected)\n"
+                << "Switchover time:  " << ElapsedMs(result.detected, switched) << " ms (loss detected -> tool on spare)\n"
+                << "Total:            " << ElapsedMs(result.lastPrimaryData, switched) << " ms\n"
+                << "Outputs out of sync at switchover: " << outOfSync << "\n"
+                << std::defaultfloat;
+        }
+    }
+
+    CloseHubSession(primary);
+    CloseHubSession(spare.session);
+    WSACleanup();
+}
+
+// --------------------- Route by name ---------------------
+
+// Brief comment: label of a port without the separating space, for messages
+std::string PortLabel(const std::map<int, std::string>& labels, int port) {
+    auto it = labels.find(port);
+    if (it == labels.end()) return "(no label)";
+    size_t a = it->second.find_first_not_of(' ');
+    return a == std::string::npos ? it->second : it->second.substr(a);
+}
+
+// -----------------------------------------------------------
+// Function: ChooseLabelMatch
+// Purpose:  Turns the candidates for a typed name into one port,
+//           asking the user when the name is ambiguous.
+// Return:   port, or -1 when nothing matches or the user cancels
+// -----------------------------------------------------------
+int ChooseLabelMatch(const char* side, const std::string& typed, const std::vector<LabelMatch>& matches,
+    const std::map<int, std::string>& labels) {
+    if (matches.empty()) {
+        std::cout << "No " << side << " matches '" << typed << "'.\n";
+        return -1;
+    }
+    bool secondExact = matches.size() > 1 && matches[1].exact;
+    if (matches.size() == 1 || (matches[0].exact && !secondExact)) return matches[0].port;
+
+    std::cout << side << " '" << typed << "' is ambiguous:\n";
+    for (size_t i = 0; i < matches.size(); ++i)
+        std::cout << "  " << (i + 1) << ". " << PortLabel(labels, matches[i].port)
+            << "  (port " << matches[i].port + 1 << ")\n";
+    std::cout << "Choose 1-" << matches.size() << " (0 = cancel): ";
+    std::string line;
+    if (!std::getline(std::cin, line)) return -1;
+    int pick = std::atoi(line.c_str());
+    if (pick < 1 || pick > static_cast<int>(matches.size())) {
+        std::cout << "Route canceled.\n";
+        return -1;
+    }
+    return matches[pick - 1].port;
+}
+
+// Main function
+// -----------------------------------------------------------
+// Function: RouteByNameMenu
+// Purpose:  Routes single crosspoints by label: "PGM 2 <- CAM 3"
+//           (output <- input) or "CAM 3 -> PGM 2".
+// Operation:
+//   1. Opens one session to the current hub and keeps it for all
+//      commands; its live mirror provides the labels
+//   2. Keeps a trigram index of input and output labels, rebuilt only
+//      when the hub sends new labels
+//   3. Resolves both names (exact label, port number "#N", prefix,
+//      word, substring or typo match) and asks when ambiguous
+//   4. Sends one routing block with the single route and waits for
+//      ACK/NAK; the read hub status is updated on ACK
+//   5. An empty line or 0 returns to the main menu
+// -----------------------------------------------------------
+void RouteByNameMenu(VideoHubState& currentHub) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+
+    HubSession s;
+    s.ip = hubIP;
+    s.port = hubPort;
+    if (!OpenHubSession(s, 3000)) {
+        std::cout << "Error! Cannot connect to VideoHub at " << hubIP << ".\n";
+        WSACleanup();
+        return;
+    }
+    std::cout << "Route by name on " << hubIP << ": '<output> <- <input>' or '<input> -> <output>'"
+        << " (labels, or #N for port N). Empty line returns.\n";
+    std::cin.ignore(); // newline after the menu choice
+
+    LabelIndex outputs, inputs;
+    uint64_t indexedLabels = 0;
+    bool indexed = false;
+    std::string line;
+    for (;;) {
+        std::cout << "route> ";
+        if (!std::getline(std::cin, line)) break;
+        size_t a = line.find_first_not_of(" \t");
+        if (a == std::string::npos || line.substr(a) == "0") break;
+
+        // keep the mirror current (label and routing changes since the last command)
+        if (!s.connected() && !OpenHubSession(s, 3000)) {
+            std::cout << "Error! Connection to the VideoHub lost.\n";
+            break;
+        }
+        HubBlock b;
+        WaitForSessions({ &s }, 0);
+        while (s.reader.next(b)) ApplyBlockToMirror(s, b);
+        if (!indexed || s.labelChanges != indexedLabels) {
+            outputs = BuildLabelIndex(s.mirror.outputLabels);
+            inputs = BuildLabelIndex(s.mirror.inputLabels);
+            indexedLabels = s.labelChanges;
+            indexed = true;
+        }
+
+        std::string outName, inName;
+        size_t arrow = line.find("<-");
+        if (arrow != std::string::npos) {
+            outName = line.substr(0, arrow);
+            inName = line.substr(arrow + 2);
+        }
+        else if ((arrow = line.find("->")) != std::string::npos) {
+            inName = line.substr(0, arrow);
+            outName = line.substr(arrow + 2);
+        }
+        else {
+            std::cout << "Use '<output> <- <input>', e.g. PGM 2 <- CAM 3\n";
+            continue;
+        }
+
+        auto trim = [](std::string& t) {
+            t.erase(0, std::min(t.size(), t.find_first_not_of(" \t")));
+            t.erase(t.find_last_not_of(" \t") + 1);
+        };
+        trim(outName);
+        trim(inName);
+
+        auto t0 = Clock::now();
+        std::vector<LabelMatch> outMatches = ResolveLabel(outputs, outName);
+        std::vector<LabelMatch> inMatches = ResolveLabel(inputs, inName);
+        double resolveUs = ElapsedMs(t0, Clock::now()) * 1000.0;
+
+        int out = ChooseLabelMatch("Output", outName, outMatches, s.mirror.outputLabels);
+        if (out < 0) continue;
+        int in = ChooseLabelMatch("Input", inName, inMatches, s.mirror.inputLabels);
+        if (in < 0) continue;
+
+        std::string outLabel = PortLabel(s.mirror.outputLabels, out);
+        std::string inLabel = PortLabel(s.mirror.inputLabels, in);
+        std::vector<int> rejected;
+        auto t1 = Clock::now();
+        if (!ApplyRoutingOnSession(s, { { out, in } }, rejected)) {
+            std::cout << "Error! No answer from the VideoHub; reconnecting on the next command.\n";
+            CloseHubSession(s);
+            continue;
+        }
+        double takeMs = ElapsedMs(t1, Clock::now());
+        std::cout << std::fixed << std::setprecision(2)
+            << outLabel << " (" << out + 1 << ") <- " << inLabel << " (" << in + 1 << "): "
+            << (rejected.empty() ? "ACK" : "NAK") << " in " << takeMs << " ms, names resolved in "
+            << resolveUs << " us\n" << std::defaultfloat;
+        if (rejected.empty()) {
+            currentHub.routing[out] = in;
+            ++gHubStateSeq;
+        }
+    }
+
+    CloseHubSession(s);
+    WSACleanup();
+}
+
+// --------------------- Crosspoint grid ---------------------
+// Video routing as a matrix: inputs across, outputs down, one cell per
+// crosspoint. The console window is a viewport onto the matrix and a
+// frame only formats the cells inside it, with the routing held in flat
+// vectors (one index per cell), so drawing costs the same for 12x12 and
+// 288x288. Input use counts and preset differences are updated per
+// routing change instead of being recounted per frame.
+
+// Brief comment: matrix, viewport and highlight state of the grid view
+struct CrosspointGrid {
+    int inputs = 0;
+    int outputs = 0;
+    std::vector<int> routed;                    // live input per output (-1 = none)
+    std::vector<int> preset;                    // loaded preset's input per output (-1 = none)
+    std::vector<int> useCount;                  // outputs routed to each input
+    std::vector<Clock::time_point> changedAt;   // last live change per output
+    int presetDiffs = 0;                        // outputs where live and preset differ
+    int unusedInputs = 0;
+    int firstOut = 0, firstIn = 0;              // top-left cell in view
+    int cursorOut = 0, cursorIn = 0;
+    int rows = 1, cols = 1;                     // cells in view (last frame)
+    double lastFrameMs = 0.0;
+};
+
+static const int kGridHeaderLines = 4;     // title + hundreds / tens / units of the input numbers
+static const int kGridFooterLines = 2;
+static const int kGridLabelWidth = 20;     // "nnn label" in front of each row
+static const int kGridHighlightMs = 3000;  // how long a live change stays highlighted
+
+// Brief comment: writes text in runs of equal colour (one attribute switch per run)
+struct ConsolePainter {
+    HANDLE console;
+    int consoleAttr = -1;
+    int runAttr = -1;
+    std::string run;
+
+    void put(int attr, const std::string& text) {
+        if (attr != runAttr) flush();
+        runAttr = attr;
+        run += text;
+    }
+    void flush() {
+        if (run.empty()) return;
+        if (runAttr != consoleAttr) {
+            std::cout.flush();
+            SetConsoleTextAttribute(console, static_cast<WORD>(runAttr));
+            consoleAttr = runAttr;
+        }
+        std::cout << run;
+        run.clear();
+    }
+};
+
+// Brief comment: sizes the matrix from the mirror, copies the routing into the flat tables and counts once
+void InitCrosspointGrid(CrosspointGrid& g, const VideoHubState& live, const VideoHubState& loadedPreset) {
+    auto extent = [](const std::map<int, std::string>& m) { return m.empty() ? 0 : m.rbegin()->first + 1; };
+    g.outputs = extent(live.outputLabels);
+    g.inputs = extent(live.inputLabels);
+    for (auto& kv : live.routing) {
+        g.outputs = std::max(g.outputs, kv.first + 1);
+        g.inputs = std::max(g.inputs, kv.second + 1);
+    }
+    g.routed.assign(g.outputs, -1);
+    g.preset.assign(g.outputs, -1);
+    g.useCount.assign(g.inputs, 0);
+    g.changedAt.assign(g.outputs, Clock::time_point());
+    for (auto& kv : live.routing) {
+        if (kv.first < 0 || kv.second < 0) continue;
+        g.routed[kv.first] = kv.second;
+        ++g.useCount[kv.second];
+    }
+    for (auto& kv : loadedPreset.routing)
+        if (kv.first >= 0 && kv.first < g.outputs) g.preset[kv.first] = kv.second;
+    g.presetDiffs = 0;
+    for (int o = 0; o < g.outputs; ++o)
+        if (g.preset[o] >= 0 && g.preset[o] != g.routed[o]) ++g.presetDiffs;
+    g.unusedInputs = static_cast<int>(std::count(g.useCount.begin(), g.useCount.end(), 0));
+}
+
+// Brief comment: applies one live routing change to the tables (constant time)
+void NoteGridChange(CrosspointGrid& g, int output, int input, Clock::time_point now) {
+    if (output < 0 || output >= g.outputs || input < 0 || input >= g.inputs) return;
+    int old = g.routed[output];
+    if (old == input) return;
+    bool wasDiff = g.preset[output] >= 0 && g.preset[output] != old;
+    bool isDiff = g.preset[output] >= 0 && g.preset[output] != input;
+    g.presetDiffs += (isDiff ? 1 : 0) - (wasDiff ? 1 : 0);
+    if (old >= 0 && --g.useCount[old] == 0) ++g.unusedInputs;
+    if (g.useCount[input]++ == 0) --g.unusedInputs;
+    g.routed[output] = input;
+    g.changedAt[output] = now;
+}
+
+// -----------------------------------------------------------
+// Function: DrawCrosspointGrid
+// Purpose:  Draws one frame of the grid view over the reserved lines.
+// Params:   top   - first console line of the view
+//           lines - number of lines reserved for the view
+// Operation:
+//   - fits rows / columns to the window and scrolls so the cursor stays
+//     in view
+//   - formats only the cells in view: X = live route (yellow when it
+//     changed in the last 3 s, red when the loaded preset differs),
+//     o = the preset's route where it differs, . = free; the numbers of
+//     unused inputs are dark, the cursor cell has a blue background
+// Return:   true when a highlighted change is in view (redraw to fade it)
+// -----------------------------------------------------------
+bool DrawCrosspointGrid(CrosspointGrid& g, const VideoHubState& live, short top, int lines, Clock::time_point now) {
+    const int kPlain = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
+    const int kDark = FOREGROUND_INTENSITY;
+    const int kRoute = FOREGROUND_GREEN | FOREGROUND_INTENSITY;
+    const int kChanged = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY;
+    const int kDiff = FOREGROUND_RED | FOREGROUND_INTENSITY;
+    const int kCursor = BACKGROUND_BLUE;
+
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO info{};
+    int width = 80;
+    if (GetConsoleScreenBufferInfo(hConsole, &info)) width = info.srWindow.Right - info.srWindow.Left + 1;
+    width = std::max(width - 1, kGridLabelWidth + 2);   // never write the last column (wraps)
+
+    g.rows = std::max(1, std::min(g.outputs, lines - kGridHeaderLines - kGridFooterLines));
+    g.cols = std::max(1, std::min(g.inputs, (width - kGridLabelWidth) / 2));
+    g.cursorOut = std::max(0, std::min(g.cursorOut, g.outputs - 1));
+    g.cursorIn = std::max(0, std::min(g.cursorIn, g.inputs - 1));
+    if (g.cursorOut < g.firstOut) g.firstOut = g.cursorOut;
+    if (g.cursorOut >= g.firstOut + g.rows) g.firstOut = g.cursorOut - g.rows + 1;
+    if (g.cursorIn < g.firstIn) g.firstIn = g.cursorIn;
+    if (g.cursorIn >= g.firstIn + g.cols) g.firstIn = g.cursorIn - g.cols + 1;
+    g.firstOut = std::max(0, std::min(g.firstOut, g.outputs - g.rows));
+    g.firstIn = std::max(0, std::min(g.firstIn, g.inputs - g.cols));
+    int lastOut = std::min(g.outputs, g.firstOut + g.rows);
+    int lastIn = std::min(g.inputs, g.firstIn + g.cols);
+
+    auto fit = [width](std::string text) {
+        if (static_cast<int>(text.size()) > width) text.resize(width);
+        text.append(width - text.size(), ' ');
+        return text;
+    };
+    auto labelOf = [](const std::map<int, std::string>& labels, int port) {
+        auto it = labels.find(port);
+        if (it == labels.end()) return std::string();
+        size_t a = it->second.find_first_not_of(' ');
+        return a == std::string::npos ? std::string() : it->second.substr(a);
+    };
+
+    ConsolePainter p{ hConsole };
+    SetConsoleCursorPosition(hConsole, COORD{ 0, top });
+    std::ostringstream title;
+    title << "Crosspoint grid " << hubIP << "  outputs " << g.firstOut + 1 << "-" << lastOut << " of " << g.outputs
+        << ", inputs " << g.firstIn + 1 << "-" << lastIn << " of " << g.inputs;
+    p.put(kPlain, fit(title.str()) + "\n");
+
+    // input numbers, vertical (hundreds / tens / units)
+    for (int digit = 100; digit >= 1; digit /= 10) {
+        p.put(kPlain, std::string(kGridLabelWidth, ' '));
+        for (int i = g.firstIn; i < lastIn; ++i) {
+            int n = i + 1;
+            char c = n >= digit || digit == 1 ? static_cast<char>('0' + n / digit % 10) : ' ';
+            p.put(g.useCount[i] == 0 ? kDark : kPlain, std::string(1, c) + " ");
+        }
+        p.put(kPlain, std::string(width - kGridLabelWidth - 2 * (lastIn - g.firstIn), ' ') + "\n");
+    }
+
+    bool highlighted = false;
+    auto highlightFrom = now - std::chrono::milliseconds(kGridHighlightMs);
+    for (int r = 0; r < g.rows; ++r) {
+        int o = g.firstOut + r;
+        if (o >= lastOut) {
+            p.put(kPlain, std::string(width, ' ') + "\n");
+            continue;
+        }
+        char number[16];
+        std::snprintf(number, sizeof(number), "%3d ", o + 1);
+        std::string rowLabel = number + labelOf(live.outputLabels, o);
+        rowLabel.resize(kGridLabelWidth - 1, ' ');
+        p.put(o == g.cursorOut ? kChanged : kPlain, rowLabel + " ");
+
+        int in = g.routed[o];
+        int pre = g.preset[o] >= 0 && g.preset[o] != in ? g.preset[o] : -1;
+        bool changed = g.changedAt[o] > highlightFrom;
+        for (int i = g.firstIn; i < lastIn; ++i) {
+            char c = '.';
+            int attr = kDark;
+            if (i == in) {
+                c = 'X';
+                attr = changed ? kChanged : pre >= 0 ? kDiff : kRoute;
+                highlighted = highlighted || changed;
+            }
+            else if (i == pre) {
+                c = 'o';
+                attr = kDiff;
+            }
+            // the gap takes the cell's colour so a row stays a few long runs
+            if (o == g.cursorOut && i == g.cursorIn) {
+                p.put(attr | kCursor, std::string(1, c));
+                p.put(attr, " ");
+            }
+            else p.put(attr, std::string(1, c) + " ");
+        }
+        p.put(kPlain, std::string(width - kGridLabelWidth - 2 * (lastIn - g.firstIn), ' ') + "\n");
+    }
+
+    std::ostringstream cursor, status;
+    int routedIn = g.routed[g.cursorOut];
+    cursor << "Output " << g.cursorOut + 1 << " " << labelOf(live.outputLabels, g.cursorOut) << " <- ";
+    if (routedIn >= 0) cursor << "input " << routedIn + 1 << " " << labelOf(live.inputLabels, routedIn);
+    else cursor << "(none)";
+    if (g.preset[g.cursorOut] >= 0 && g.preset[g.cursorOut] != routedIn)
+        cursor << "   preset: input " << g.preset[g.cursorOut] + 1 << " " << labelOf(live.inputLabels, g.preset[g.cursorOut]);
+    cursor << "   | column: input " << g.cursorIn + 1 << " " << labelOf(live.inputLabels, g.cursorIn)
+        << " (" << g.useCount[g.cursorIn] << " outputs)";
+    status << std::fixed << std::setprecision(2) << "Unused inputs " << g.unusedInputs << "/" << g.inputs
+        << "  preset differs " << g.presetDiffs << "  frame " << g.lastFrameMs << " ms"
+        << "  | arrows/PgUp/PgDn/Ctrl+arrows scroll, Enter = routed input, q = return";
+    p.put(kPlain, fit(cursor.str()) + "\n");
+    p.put(kPlain, fit(status.str()) + "\n");
+    p.flush();
+    std::cout.flush();
+    return highlighted;
+}
+
+// Main function
+// -----------------------------------------------------------
+// Function: CrosspointGridMenu
+// Purpose:  Live crosspoint grid of the current hub's video routing.
+// Operation:
+//   1. Opens a session to the current hub (live mirror) and reserves
+//      the console window for the view
+//   2. Routing changes from the hub update the grid tables and are
+//      highlighted; the loaded preset's differences are marked
+//   3. Arrows move the cursor, PgUp/PgDn page the outputs,
+//      Ctrl+Left/Right page the inputs, Home/End jump to the first /
+//      last input, Enter jumps to the input routed to the cursor output
+//   4. Redraws only after a change or key (at most every 40 ms);
+//      q or Esc returns to the main menu
+// -----------------------------------------------------------
+void CrosspointGridMenu(const VideoHubState& loadedPreset) {
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+
+    HubSession s;
+    s.ip = hubIP;
+    s.port = hubPort;
+    if (!OpenHubSession(s, 3000)) {
+        std::cout << "Error! Cannot connect to VideoHub at " << hubIP << ".\n";
+        WSACleanup();
+        return;
+    }
+    CrosspointGrid g;
+    InitCrosspointGrid(g, s.mirror, loadedPreset);
+    if (g.outputs == 0 || g.inputs == 0) {
+        std::cout << "Error! The VideoHub reported no routing.\n";
+        CloseHubSession(s);
+        WSACleanup();
         return;
     }
 
-    // Add return option
-    std::cout << "  0. Return to main menu\n";
-    // Display menu with numbers
-    std::cout << "Available presets in 'presets/':\n";
-    for (size_t i = 0; i < presets.size(); ++i) {
-        std::cout << "  " << (i + 1) << ". " << presets[i].first
-            << " : " << presets[i].second << "\n";
+    // reserve the window, then remember where the view starts
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO info{};
+    int lines = 25;
+    if (GetConsoleScreenBufferInfo(hConsole, &info)) lines = info.srWindow.Bottom - info.srWindow.Top;
+    lines = std::max(lines, kGridHeaderLines + kGridFooterLines + 1);
+    for (int i = 0; i < lines; ++i) std::cout << "\n";
+    std::cout.flush();
+    short top = 0;
+    if (GetConsoleScreenBufferInfo(hConsole, &info)) top = static_cast<short>(std::max(0, info.dwCursorPosition.Y - lines));
+
+    bool dirty = true, highlighted = false, running = true;
+    Clock::time_point lastDraw;
+    while (running && s.connected()) {
+        WaitForSessions({ &s }, 20);
+        auto now = Clock::now();
+        HubBlock b;
+        uint64_t labels = s.labelChanges;
+        while (s.reader.next(b)) {
+            for (auto& change : ApplyBlockToMirror(s, b)) {
+                NoteGridChange(g, change.first, change.second, now);
+                dirty = true;
+            }
+        }
+        if (s.labelChanges != labels) dirty = true;
+
+        while (running && _kbhit()) {
+            int c = _getch();
+            dirty = true;
+            if (c == 'q' || c == 'Q' || c == 27) running = false;
+            else if (c == 13 && g.routed[g.cursorOut] >= 0) g.cursorIn = g.routed[g.cursorOut];
+            else if (c == 0 || c == 224) {
+                switch (_getch()) {
+                case 72: --g.cursorOut; break;                 // up
+                case 80: ++g.cursorOut; break;                 // down
+                case 75: --g.cursorIn; break;                  // left
+                case 77: ++g.cursorIn; break;                  // right
+                case 73: g.cursorOut -= g.rows; break;         // PgUp
+                case 81: g.cursorOut += g.rows; break;         // PgDn
+                case 115: g.cursorIn -= g.cols; break;         // Ctrl+Left
+                case 116: g.cursorIn += g.cols; break;         // Ctrl+Right
+                case 71: g.cursorIn = 0; break;                // Home
+                case 79: g.cursorIn = g.inputs - 1; break;     // End
+                default: break;
+                }
+            }
+        }
+        // fade highlights a few times per second, otherwise only draw on changes
+        if (highlighted && now - lastDraw >= std::chrono::milliseconds(250)) dirty = true;
+        if (running && dirty && now - lastDraw >= std::chrono::milliseconds(40)) {
+            highlighted = DrawCrosspointGrid(g, s.mirror, top, lines, now);
+            g.lastFrameMs = ElapsedMs(now, Clock::now());
+            lastDraw = now;
+            dirty = false;
+        }
+    }
+    SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+    SetConsoleCursorPosition(hConsole, COORD{ 0, static_cast<short>(top + lines) });
+    if (!s.connected()) std::cout << "Error! Connection to the VideoHub lost.\n";
+
+    CloseHubSession(s);
+    WSACleanup();
+}
+
+// --------------------- Hub registry ---------------------
+// Known hubs are remembered in 'hubs.json' with their last-known
+// preamble, labels and routing. Discovery adds entries, every
+// successful read refreshes the cached state. At startup the cached
+// state of the last used hub is shown (marked stale) while the live
+// state is fetched in the background. The key is the address (ip + port).
+
+// Brief comment: one known hub in the registry
+struct HubRegistryEntry {
+    std::string name;          // friendly name reported by the hub
+    std::string ip;
+    int port = 9990;
+    std::string model;         // "Model name" from VIDEOHUB DEVICE
+    std::string uniqueId;      // "Unique ID"
+    std::string protocol;      // protocol version from PROTOCOL PREAMBLE
+    int videoInputs = 0;
+    int videoOutputs = 0;
+    std::string lastSeen;      // local time of the last successful contact
+    std::string preamble;      // last-known raw prelude (empty if never read)
+    VideoHubState state;       // last-known labels and routing
+};
+
+// Brief comment: all known hubs plus the hub that was used last
+struct HubRegistry {
+    std::vector<HubRegistryEntry> hubs;
+    std::string currentIp;     // last used hub (warm start)
+    int currentPort = 9990;
+};
+
+const std::string hubRegistryFile = "hubs.json";
+HubRegistry gHubRegistry;      // loaded at startup, saved on every change
+
+// Brief comment: current local time as "YYYY-MM-DD HH:MM:SS"
+std::string CurrentTimestamp() {
+    std::time_t t = std::time(nullptr);
+    std::tm tm{};
+    localtime_s(&tm, &t);
+    std::ostringstream o;
+    o << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
+    return o.str();
+}
+
+// Brief comment: fills model, name, port counts from PROTOCOL PREAMBLE / VIDEOHUB DEVICE lines
+void FillRegistryEntryFromInfo(HubRegistryEntry& e, std::map<std::string, std::string>& info) {
+    if (info.count("Friendly name")) e.name = info["Friendly name"];
+    if (e.name.empty()) e.name = e.ip;
+    if (info.count("Model name")) e.model = info["Model name"];
+    if (info.count("Unique ID")) e.uniqueId = info["Unique ID"];
+    if (info.count("Version")) e.protocol = info["Version"];
+    try { e.videoInputs = std::stoi(info["Video inputs"]); } catch (...) {}
+    try { e.videoOutputs = std::stoi(info["Video outputs"]); } catch (...) {}
+}
+
+// -----------------------------------------------------------
+// Function: LoadHubRegistry
+// Purpose:  Reads the hub registry JSON file.
+// Format:
+//   { "current": "172.20.5.247:9990",
+//     "hubs": [ { "name": "...", "ip": "...", "port": 9990, "model": "...",
+//                 "uniqueId": "...", "protocol": "2.8", "videoInputs": 40,
+//                 "videoOutputs": 40, "lastSeen": "2025-09-10 14:03:22",
+//                 "preamble": "...",
+//                 "inputs": { "0": "Cam 1", ... },      (same layout as presets)
+//                 "outputs": { "0": "PGM", ... },
+//                 "routing": { "0": 3, ... },
+//                 "monitorOutputs": {...}, "monitorRouting": {...},     (if present)
+//                 "serialPorts": {...}, "serialRouting": {...} } ] }
+// Return:   false when the file is missing or unreadable (registry empty)
+// -----------------------------------------------------------
+bool LoadHubRegistry(HubRegistry& reg, const std::string& filename = hubRegistryFile) {
+    reg = HubRegistry{};
+    JsonValue root;
+    if (!fs::exists(filename) || !LoadJsonFile(filename, root)) return false;
+
+    if (auto* cur = root.get("current")) {
+        std::string addr = cur->asString();
+        size_t colon = addr.rfind(':');
+        reg.currentIp = addr.substr(0, colon);
+        if (colon != std::string::npos) {
+            try { reg.currentPort = std::stoi(addr.substr(colon + 1)); } catch (...) {}
+        }
+    }
+
+    auto readLabels = [](const JsonValue* obj, std::map<int, std::string>& m) {
+        if (!obj) return;
+        for (auto& kv : obj->members) {
+            try { m[std::stoi(kv.first)] = kv.second.asString(); } catch (...) {}
+        }
+    };
+
+    if (auto* list = root.get("hubs")) {
+        for (auto& item : list->items) {
+            HubRegistryEntry e;
+            auto str = [&](const char* key, std::string& dst) { if (auto* v = item.get(key)) dst = v->asString(); };
+            auto num = [&](const char* key, int& dst) { if (auto* v = item.get(key)) dst = v->asInt(dst); };
+            str("name", e.name);
+            str("ip", e.ip);
+            num("port", e.port);
+            str("model", e.model);
+            str("uniqueId", e.uniqueId);
+            str("protocol", e.protocol);
+            num("videoInputs", e.videoInputs);
+            num("videoOutputs", e.videoOutputs);
+            str("lastSeen", e.lastSeen);
+            str("preamble", e.preamble);
+            readLabels(item.get("inputs"), e.state.inputLabels);
+            for (auto& level : kRoutingLevels) {
+                readLabels(item.get(level.labelsKey), e.state.*level.outputLabels);
+                if (auto* routing = item.get(level.routingKey)) {
+                    for (auto& kv : routing->members) {
+                        try { (e.state.*level.routing)[std::stoi(kv.first)] = kv.second.asInt(); } catch (...) {}
+                    }
+                }
+            }
+            if (!e.ip.empty()) reg.hubs.push_back(e);
+        }
+    }
+    return true;
+}
+
+// Brief comment: writes the hub registry JSON file (same layout as LoadHubRegistry reads)
+void SaveHubRegistry(const HubRegistry& reg, const std::string& filename = hubRegistryFile) {
+    std::ofstream f(filename);
+    if (!f) {
+        std::cerr << "Error writing file: " << filename << "\n";
+        return;
+    }
+    auto writeLabels = [&](const std::map<int, std::string>& m) {
+        f << "{";
+        bool first = true;
+        for (auto& kv : m) {
+            f << (first ? "" : ",") << "\n        \"" << kv.first << "\": \"" << escapeJson(kv.second) << "\"";
+            first = false;
+        }
+        f << (m.empty() ? "}" : "\n      }");
+    };
+
+    f << "{\n  \"current\": \"" << escapeJson(reg.currentIp) << ":" << reg.currentPort << "\",\n";
+    f << "  \"hubs\": [";
+    bool first = true;
+    for (auto& e : reg.hubs) {
+        f << (first ? "\n" : ",\n");
+        f << "    {\n"
+            << "      \"name\": \"" << escapeJson(e.name) << "\",\n"
+            << "      \"ip\": \"" << escapeJson(e.ip) << "\",\n"
+            << "      \"port\": " << e.port << ",\n"
+            << "      \"model\": \"" << escapeJson(e.model) << "\",\n"
+            << "      \"uniqueId\": \"" << escapeJson(e.uniqueId) << "\",\n"
+            << "      \"protocol\": \"" << escapeJson(e.protocol) << "\",\n"
+            << "      \"videoInputs\": " << e.videoInputs << ",\n"
+            << "      \"videoOutputs\": " << e.videoOutputs << ",\n"
+            << "      \"lastSeen\": \"" << escapeJson(e.lastSeen) << "\",\n"
+            << "      \"preamble\": \"" << escapeJson(e.preamble) << "\",\n";
+        f << "      \"inputs\": ";
+        writeLabels(e.state.inputLabels);
+        for (auto& level : kRoutingLevels) {
+            const auto& routing = e.state.*level.routing;
+            if (!IsVideoLevel(level) && routing.empty()) continue;
+            f << ",\n      \"" << level.labelsKey << "\": ";
+            writeLabels(e.state.*level.outputLabels);
+            f << ",\n      \"" << level.routingKey << "\": {";
+            bool firstRoute = true;
+            for (auto& kv : routing) {
+                f << (firstRoute ? "" : ",") << "\n        \"" << kv.first << "\": " << kv.second;
+                firstRoute = false;
+            }
+            f << (routing.empty() ? "}" : "\n      }");
+        }
+        f << "\n    }";
+        first = false;
+    }
+    f << "\n  ]\n}\n";
+}
+
+// Brief comment: finds the registry entry for an address, or nullptr
+HubRegistryEntry* FindHubInRegistry(HubRegistry& reg, const std::string& ip, int port) {
+    for (auto& e : reg.hubs)
+        if (e.ip == ip && e.port == port) return &e;
+    return nullptr;
+}
+
+// Brief comment: adds an entry or refreshes the device info of the one with the same
+//                address (a cached state is kept when the new entry carries none)
+HubRegistryEntry& UpsertHubRegistry(HubRegistry& reg, const HubRegistryEntry& e) {
+    if (HubRegistryEntry* existing = FindHubInRegistry(reg, e.ip, e.port)) {
+        HubRegistryEntry merged = e;
+        if (merged.state.routing.empty()) {
+            merged.state = existing->state;
+            merged.preamble = existing->preamble;
+        }
+        *existing = merged;
+        return *existing;
+    }
+    reg.hubs.push_back(e);
+    return reg.hubs.back();
+}
+
+// -----------------------------------------------------------
+// Function: RememberHubState
+// Purpose:  Stores the state just read from a hub as its last-known
+//           state in the registry (and marks it as the current hub).
+// -----------------------------------------------------------
+void RememberHubState(const std::string& ip, int port, const VideoHubState& state, const std::string& preamble) {
+    HubRegistryEntry e;
+    if (HubRegistryEntry* existing = FindHubInRegistry(gHubRegistry, ip, port)) e = *existing;
+    e.ip = ip;
+    e.port = port;
+
+    std::map<std::string, std::string> info;
+    HubBlockReader reader;
+    reader.feed(preamble.data(), preamble.size());
+    HubBlock b;
+    while (reader.next(b))
+        if (b.header == "PROTOCOL PREAMBLE" || b.header == "VIDEOHUB DEVICE")
+            ParseKeyValueLines(b.lines, info);
+    FillRegistryEntryFromInfo(e, info);
+    if (e.videoInputs == 0) e.videoInputs = static_cast<int>(state.inputLabels.size());
+    if (e.videoOutputs == 0) e.videoOutputs = static_cast<int>(state.outputLabels.size());
+
+    e.lastSeen = CurrentTimestamp();
+    e.preamble = preamble;
+    CopyHubContent(e.state, state);
+
+    UpsertHubRegistry(gHubRegistry, e);
+    gHubRegistry.currentIp = ip;
+    gHubRegistry.currentPort = port;
+    SaveHubRegistry(gHubRegistry);
+}
+
+// Brief comment: expected prelude size of a known hub, so buffers can be sized up front
+size_t ExpectedPreludeBytes(const std::string& ip, int port) {
+    HubRegistryEntry* e = FindHubInRegistry(gHubRegistry, ip, port);
+    if (!e) return 0;
+    if (!e->preamble.empty()) return e->preamble.size() + e->preamble.size() / 4;
+    // ~24 bytes per label line, ~8 per routing/lock line, ~1 KB of device info
+    return 1024 + static_cast<size_t>(e->videoInputs + e->videoOutputs) * 24 +
+        static_cast<size_t>(e->videoOutputs) * 16;
+}
+
+// --------------------- Hub discovery ---------------------
+
+// -----------------------------------------------------------
+// Function: ParseProbeSpec
+// Purpose:  Expands one address spec into (ip, port) probe targets.
+// Accepted forms (port part optional, default 9990):
+//   192.168.1.20                 single address
+//   192.168.1.0/22               subnet (network/broadcast skipped for /30 and larger)
+//   192.168.1.10-192.168.1.50    address range
+//   192.168.1.10-50              range in the last octet
+//   127.0.0.1:10000-10019        port range (e.g. several simulators on loopback)
+//   fd00::20, [fd00::20]:9990    single IPv6 address
+// Return:   false on a malformed spec or more than 65536 addresses
+// -----------------------------------------------------------
+bool ParseProbeSpec(const std::string& spec, std::vector<std::pair<std::string, int>>& out) {
+    std::string addrPart = spec;
+    int portFirst = 9990, portLast = 9990;
+
+    // IPv6: a single address, bare or as [addr]:ports
+    bool ipv6 = false;
+    size_t colon = std::string::npos;
+    if (!spec.empty() && spec[0] == '[') {
+        size_t close = spec.find(']');
+        if (close == std::string::npos) return false;
+        addrPart = spec.substr(1, close - 1);
+        if (close + 1 < spec.size()) {
+            if (spec[close + 1] != ':') return false;
+            colon = close + 1;
+        }
+        ipv6 = true;
+    }
+    else if (std::count(spec.begin(), spec.end(), ':') >= 2) {
+        ipv6 = true;
+    }
+    else {
+        colon = spec.find(':');
+        if (colon != std::string::npos) addrPart = spec.substr(0, colon);
+    }
+
+    if (colon != std::string::npos) {
+        std::string ports = spec.substr(colon + 1);
+        size_t dash = ports.find('-');
+        try {
+            portFirst = std::stoi(ports.substr(0, dash));
+            portLast = (dash == std::string::npos) ? portFirst : std::stoi(ports.substr(dash + 1));
+        }
+        catch (...) { return false; }
+        if (portFirst < 1 || portLast > 65535 || portLast < portFirst) return false;
+    }
+
+    if (ipv6) {
+        ResolvedAddress a;
+        if (!ParseAddressLiteral(addrPart, a) || a.addr.ss_family != AF_INET6) return false;
+        for (int port = portFirst; port <= portLast; ++port)
+            out.push_back({ addrPart, port });
+        return true;
+    }
+
+    auto toHost = [](const std::string& ip, uint32_t& v) {
+        in_addr a{};
+        if (inet_pton_wrap(AF_INET, ip, &a) != 1) return false;
+        v = ntohl(a.s_addr);
+        return true;
+    };
+
+    uint32_t first = 0, last = 0;
+    size_t slash = addrPart.find('/');
+    size_t dash = addrPart.find('-');
+    if (slash != std::string::npos) {
+        int bits = 0;
+        try { bits = std::stoi(addrPart.substr(slash + 1)); }
+        catch (...) { return false; }
+        if (bits < 16 || bits > 32 || !toHost(addrPart.substr(0, slash), first)) return false;
+        uint32_t mask = bits == 32 ? 0xFFFFFFFFu : ~((1u << (32 - bits)) - 1);
+        first &= mask;
+        last = first | ~mask;
+        if (bits <= 30) { ++first; --last; }
+    }
+    else if (dash != std::string::npos) {
+        std::string from = addrPart.substr(0, dash);
+        std::string to = addrPart.substr(dash + 1);
+        if (!toHost(from, first)) return false;
+        if (to.find('.') == std::string::npos) {
+            int octet = 0;
+            try { octet = std::stoi(to); }
+            catch (...) { return false; }
+            if (octet < 0 || octet > 255) return false;
+            last = (first & 0xFFFFFF00u) | static_cast<uint32_t>(octet);
+        }
+        else if (!toHost(to, last)) return false;
+        if (last < first || last - first >= 65536) return false;
+    }
+    else {
+        if (!toHost(addrPart, first)) return false;
+        last = first;
+    }
+
+    for (uint32_t a = first; ; ++a) {
+        in_addr ia{};
+        ia.s_addr = htonl(a);
+        char buf[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &ia, buf, sizeof(buf));
+        for (int port = portFirst; port <= portLast; ++port)
+            out.push_back({ buf, port });
+        if (a == last) break;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: DiscoverVideoHubs
+// Purpose:  Probes many addresses in parallel for a Videohub.
+// Params:
+//   targets          = (ip, port) pairs to probe
+//   concurrency      = maximum number of probes in flight
+//   connectTimeoutMs = time allowed for the TCP connect
+//   readTimeoutMs    = time allowed to receive the device info
+//   op               = optional progress (one item per address, failed =
+//                      no hub there) and cancellation
+// Return:   registry entries for every hub that answered with a
+//           VIDEOHUB DEVICE block; when op was stopped, the hubs found
+//           up to then
+// Operation:
+//   - Non-blocking connects, all waited on with one WSAPoll call
+//     (no FD_SETSIZE limit), a new probe starts as soon as one ends
+//   - Only the start of the prelude is read: the probe ends as soon
+//     as the VIDEOHUB DEVICE block is complete
+// Notes:    Winsock must already be initialized by the caller.
+// -----------------------------------------------------------
+std::vector<HubRegistryEntry> DiscoverVideoHubs(const std::vector<std::pair<std::string, int>>& targets,
+    size_t concurrency = 256, int connectTimeoutMs = 500, int readTimeoutMs = 1500, HubOperation* op = nullptr) {
+    struct Probe {
+        size_t target = 0;
+        SOCKET sock = INVALID_SOCKET;
+        bool connected = false;
+        Clock::time_point deadline;
+        HubBlockReader reader;
+        std::map<std::string, std::string> info;  // PROTOCOL PREAMBLE + VIDEOHUB DEVICE lines
+    };
+
+    std::vector<HubRegistryEntry> found;
+    std::vector<Probe> active;
+    size_t nextTarget = 0;
+    std::string now = CurrentTimestamp();
+
+    auto finish = [&](Probe& p, bool isHub) {
+        if (isHub) {
+            HubRegistryEntry e;
+            e.ip = targets[p.target].first;
+            e.port = targets[p.target].second;
+            FillRegistryEntryFromInfo(e, p.info);
+            e.lastSeen = now;
+            found.push_back(e);
+        }
+        closesocket(p.sock);
+        p.sock = INVALID_SOCKET;
+        OperationStep(op, isHub);
+    };
+
+    OperationAddTotal(op, targets.size());
+    while (nextTarget < targets.size() || !active.empty()) {
+        if (OperationStopped(op)) {
+            for (auto& p : active) closesocket(p.sock);
+            active.clear();
+            break;
+        }
+
+        // start new probes up to the concurrency limit
+        while (active.size() < concurrency && nextTarget < targets.size()) {
+            Probe p;
+            p.target = nextTarget++;
+            ResolvedAddress addr;
+            if (!ParseAddressLiteral(targets[p.target].first, addr)) {
+                OperationStep(op, false);
+                continue;
+            }
+            SetAddressPort(addr, targets[p.target].second);
+            p.sock = socket(addr.addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+            if (p.sock == INVALID_SOCKET) {
+                // out of sockets: retry this target once a running probe has finished;
+                // with nothing running it cannot be probed at all
+                if (!active.empty()) {
+                    --nextTarget;
+                    break;
+                }
+                OperationStep(op, false);
+                continue;
+            }
+            u_long nonBlocking = 1;
+            ioctlsocket(p.sock, FIONBIO, &nonBlocking);
+            connect(p.sock, (sockaddr*)&addr.addr, addr.len);
+            p.deadline = Clock::now() + std::chrono::milliseconds(connectTimeoutMs);
+            active.push_back(std::move(p));
+        }
+
+        std::vector<WSAPOLLFD> fds(active.size());
+        for (size_t i = 0; i < active.size(); ++i) {
+            fds[i].fd = active[i].sock;
+            fds[i].events = active[i].connected ? POLLRDNORM : POLLWRNORM;
+            fds[i].revents = 0;
+        }
+        if (!fds.empty()) WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), 20);
+
+        auto tnow = Clock::now();
+        for (size_t i = 0; i < active.size(); ++i) {
+            Probe& p = active[i];
+            short re = fds[i].revents;
+            if (!p.connected) {
+                if (re & (POLLERR | POLLHUP)) { finish(p, false); continue; }
+                if (re & POLLWRNORM) {
+                    p.connected = true;
+                    p.deadline = tnow + std::chrono::milliseconds(readTimeoutMs);
+                }
+            }
+            else if (re & (POLLRDNORM | POLLERR | POLLHUP)) {
+                char buf[4096];
+                int rec = recv(p.sock, buf, (int)sizeof(buf), 0);
+                if (rec <= 0) { finish(p, false); continue; }
+                p.reader.feed(buf, static_cast<size_t>(rec));
+                HubBlock b;
+                bool complete = false;
+                while (p.reader.next(b)) {
+                    if (b.header == "PROTOCOL PREAMBLE") ParseKeyValueLines(b.lines, p.info);
+                    if (b.header == "VIDEOHUB DEVICE") {
+                        ParseKeyValueLines(b.lines, p.info);
+                        complete = true;
+                    }
+                }
+                if (complete) { finish(p, true); continue; }
+            }
+            if (tnow >= p.deadline) finish(p, false);
+        }
+        active.erase(std::remove_if(active.begin(), active.end(),
+            [](const Probe& p) { return p.sock == INVALID_SOCKET; }), active.end());
+    }
+
+    std::sort(found.begin(), found.end(), [&](const HubRegistryEntry& a, const HubRegistryEntry& b) {
+        in_addr ia{}, ib{};
+        bool va = inet_pton_wrap(AF_INET, a.ip, &ia) == 1;
+        bool vb = inet_pton_wrap(AF_INET, b.ip, &ib) == 1;
+        if (va && vb && ia.s_addr != ib.s_addr) return ntohl(ia.s_addr) < ntohl(ib.s_addr);
+        if (va != vb || (!va && a.ip != b.ip)) return va ? true : vb ? false : a.ip < b.ip;
+        return a.port < b.port;
+    });
+    return found;
+}
+
+// Brief comment: prints registry entries as a numbered table
+void PrintHubTable(const std::vector<HubRegistryEntry>& hubs) {
+    std::cout << std::left
+        << std::setw(4) << "Nr"
+        << std::setw(22) << "Address"
+        << std::setw(24) << "Name"
+        << std::setw(36) << "Model"
+        << std::setw(9) << "In x Out"
+        << "Last seen\n";
+    std::cout << std::string(4 + 22 + 24 + 36 + 9 + 19, '-') << "\n";
+    for (size_t i = 0; i < hubs.size(); ++i) {
+        auto& h = hubs[i];
+        std::ostringstream address, size;
+        address << h.ip << ":" << h.port;
+        size << h.videoInputs << "x" << h.videoOutputs;
+        std::cout << std::left
+            << std::setw(4) << (i + 1)
+            << std::setw(22) << address.str()
+            << std::setw(24) << h.name
+            << std::setw(36) << h.model
+            << std::setw(9) << size.str()
+            << h.lastSeen << "\n";
+    }
+}
+
+// Main function
+// -----------------------------------------------------------
+// Function: DiscoverVideoHubsMenu
+// Purpose:  Scans address ranges for Videohubs and stores the
+//           results in the hub registry.
+// Operation:
+//   1. Asks for one or more address specs (see ParseProbeSpec)
+//   2. Probes them in parallel (DiscoverVideoHubs) on a worker thread
+//      and shows the progress; any key cancels the scan
+//   3. Shows the hubs found (also those of a cancelled scan) and adds
+//      them to 'hubs.json'
+//   4. Optionally selects one of them as the current hub
+// -----------------------------------------------------------
+void DiscoverVideoHubsMenu() {
+    std::cout << "Enter address range(s), e.g. 192.168.1.0/24 172.20.5.1-254 127.0.0.1:10000-10009\n";
+    std::cout << "Ranges (0 = return): ";
+    std::string line;
+    std::cin.ignore();
+    std::getline(std::cin, line);
+
+    std::vector<std::pair<std::string, int>> targets;
+    std::istringstream iss(line);
+    std::string spec;
+    while (iss >> spec) {
+        if (spec == "0") return;
+        if (!ParseProbeSpec(spec, targets)) {
+            std::cout << "Invalid range: " << spec << "\n";
+            return;
+        }
+    }
+    if (targets.empty()) {
+        std::cout << "No addresses entered.\n";
+        return;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return;
+    std::cout << "Probing " << targets.size() << " address(es), press any key to cancel...\n";
+    auto start = Clock::now();
+    HubOperation op;
+    std::vector<HubRegistryEntry> found;
+    std::atomic<bool> finished{ false };
+    std::thread scan([&]() {
+        found = DiscoverVideoHubs(targets, 256, 500, 1500, &op);
+        finished = true;
+    });
+    while (!finished) {
+        if (_kbhit()) {
+            _getch();
+            op.cancel();
+        }
+        std::cout << "\r  " << op.done << " / " << targets.size() << " probed, "
+            << (op.done - op.failed) << " Videohub(s) found   " << std::flush;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    scan.join();
+    double elapsed = ElapsedMs(start, Clock::now());
+    WSACleanup();
+    std::cout << "\n";
+
+    if (op.cancelRequested)
+        std::cout << "Scan cancelled after " << op.done << " of " << targets.size() << " address(es).\n";
+    std::cout << "Found " << found.size() << " Videohub(s) in " << std::fixed << std::setprecision(0)
+        << elapsed << " ms.\n" << std::defaultfloat;
+    if (found.empty()) return;
+
+    PrintHubTable(found);
+
+    for (auto& e : found) UpsertHubRegistry(gHubRegistry, e);
+    SaveHubRegistry(gHubRegistry);
+    std::cout << "Hub registry updated (" << hubRegistryFile << ").\n";
+
+    std::cout << "Select hub number to use (0 = keep " << hubIP << "): ";
+    int choice = 0;
+    std::cin >> choice;
+    if (choice >= 1 && choice <= static_cast<int>(found.size())) {
+        hubIP = found[choice - 1].ip;
+        hubPort = found[choice - 1].port;
+        gVideoHubRead = false;
+        std::cout << "VideoHub IP set to: " << hubIP << " (" << found[choice - 1].name << ")\n";
+    }
+}
+
+// Brief comment: result of a live read running in a background thread
+struct BackgroundRead {
+    HubOperation op;             // cancelled when the read is no longer wanted
+    std::atomic<bool> done{ false };
+    bool ok = false;
+    std::string ip;
+    int port = 0;
+    unsigned seq = 0;            // gHubStateSeq at start; the result is stale once it moved on
+    VideoHubState state;
+    std::string preamble;
+    std::thread worker;          // runs the read; joined before the BackgroundRead is dropped
+};
+
+// Brief comment: cancels a background read and waits for its thread (a cancelled read returns
+//                within its connect timeout, at most about 1 s)
+void StopBackgroundRead(std::unique_ptr<BackgroundRead>& refresh) {
+    if (!refresh) return;
+    refresh->op.cancel();
+    if (refresh->worker.joinable()) refresh->worker.join();
+    refresh.reset();
+}
+
+// -----------------------------------------------------------
+// Function: WarmStartCurrentHub
+// Purpose:  Shows the last-known state of the current hub from the
+//           registry immediately (marked stale) and starts a live
+//           read in the background.
+// Params:   currentHub = receives the cached state
+//           refresh    = receives the background read (nullptr if none)
+// Notes:    The background thread only touches its own BackgroundRead
+//           and is owned by the caller: a read still running for the
+//           previous hub is cancelled and joined here, and the menu
+//           stops the last one (StopBackgroundRead) before it returns,
+//           so no read outlives main.
+// -----------------------------------------------------------
+void WarmStartCurrentHub(VideoHubState& currentHub, std::unique_ptr<BackgroundRead>& refresh) {
+    StopBackgroundRead(refresh);
+    HubRegistryEntry* e = FindHubInRegistry(gHubRegistry, hubIP, hubPort);
+    if (!e || e->state.routing.empty()) return;
+
+    CopyHubContent(currentHub, e->state);
+    gVideoHubRead = false;
+    gVideoHubStale = true;
+
+    std::cout << "\n--- Last-known state of " << e->name << " (" << e->model << ", "
+        << e->videoInputs << "x" << e->videoOutputs << "), seen " << e->lastSeen << " [STALE] ---\n";
+    PrintRouting(currentHub.outputLabels, currentHub.inputLabels, currentHub.routing);
+    std::cout << "Reading live state in the background...\n";
+
+    refresh = std::make_unique<BackgroundRead>();
+    BackgroundRead* job = refresh.get();
+    job->ip = hubIP;
+    job->port = hubPort;
+    job->seq = gHubStateSeq;
+    size_t expected = ExpectedPreludeBytes(hubIP, hubPort);
+    job->worker = std::thread([job, expected]() {
+        job->ok = FetchHubState(job->ip, job->port, job->state, job->preamble, expected, &job->op);
+        job->done = true;
+    });
+}
+
+// -----------------------------------------------------------
+// Function: PollBackgroundRead
+// Purpose:  Takes over the result of a finished background read,
+//           if it still belongs to the current hub and nothing newer
+//           (an explicit read, a route taken) has arrived since it
+//           started; a stale result is dropped.
+// -----------------------------------------------------------
+void PollBackgroundRead(VideoHubState& currentHub, std::unique_ptr<BackgroundRead>& refresh) {
+    if (!refresh || !refresh->done) return;
+    refresh->worker.join();   // finished: returns at once
+    std::unique_ptr<BackgroundRead> job = std::move(refresh);
+    if (job->ip != hubIP || job->port != hubPort || job->seq != gHubStateSeq) return;
+    if (!job->ok) {
+        std::cout << "\n!!! Live read of " << job->ip << " failed; the state shown is still the last-known state.\n";
+        return;
+    }
+
+    size_t changed = 0;
+    for (auto& kv : job->state.routing) {
+        auto it = currentHub.routing.find(kv.first);
+        if (it == currentHub.routing.end() || it->second != kv.second) ++changed;
+    }
+    CopyHubContent(currentHub, job->state);
+    gVideoHubRead = true;
+    gVideoHubStale = false;
+    RememberHubState(job->ip, job->port, job->state, job->preamble);
+    std::cout << "\nLive state of " << job->ip << " received (" << changed
+        << " route(s) differ from the last-known state).\n";
+}
+
+// Main function
+// -----------------------------------------------------------
+// Function: SelectHubFromRegistry
+// Purpose:  Lets the user pick a known hub from 'hubs.json'.
+// -----------------------------------------------------------
+void SelectHubFromRegistry() {
+    if (gHubRegistry.hubs.empty()) {
+        std::cout << "The hub registry is empty. Use discovery or read a hub first.\n";
+        return;
+    }
+    PrintHubTable(gHubRegistry.hubs);
+    std::cout << "Select hub number (0 = return): ";
+    int choice = 0;
+    std::cin >> choice;
+    if (choice < 1 || choice > static_cast<int>(gHubRegistry.hubs.size())) {
+        std::cout << "Returning...\n";
+        return;
+    }
+    auto& e = gHubRegistry.hubs[choice - 1];
+    hubIP = e.ip;
+    hubPort = e.port;
+    gVideoHubRead = false;
+    std::cout << "VideoHub IP set to: " << hubIP << " (" << e.name << ")\n";
+}
+
+// Main function
+// Function: SavePresetMenu
+// Purpose:  Prompts the user to save a preset with description and filename
+// Params:   state = VideoHubState struct with current hub status
+// Operation:
+//   1. Checks if hub data is available
+//   2. Creates 'presets' folder if necessary
+//   3. Prompts the user for description and filename
+//   4. Calls SavePreset to save the preset
+void SavePresetMenu(VideoHubState& state) {
+    if (state.routing.empty()) {
+        std::cout << "No hub data available. Please read the Videohub first.\n";
+        return;
+    }
+
+    if (!fs::exists("presets")) fs::create_directory("presets");
+
+    std::cout << "Do you want to create a new preset? (y/n, 0 = return): ";
+    char confirm;
+    std::cin >> confirm;
+
+    if (confirm == '0') {
+        std::cout << "Returning to main menu...\n";
+        return;
+    }
+    if (confirm != 'y' && confirm != 'Y') {
+        std::cout << "Preset creation canceled.\n";
+        return;
+    }
+
+    std::cin.ignore(); // flush newline van std::cin
+
+    std::cout << "Enter description for preset: ";
+    std::getline(std::cin, state.description);
+
+    std::string fname;
+    std::cout << "Enter filename for preset (without extension): ";
+    std::getline(std::cin, fname);
+    if (fname.empty()) fname = "preset";
+
+    fname = "presets/" + fname + ".json";
+
+    // === Nieuw: check of bestand al bestaat ===
+    if (fs::exists(fname)) {
+        std::cout << "File '" << fname << "' already exists.\n";
+        std::cout << "Do you want to overwrite it? (y/n): ";
+        char overwrite;
+        std::cin >> overwrite;
+        if (overwrite != 'y' && overwrite != 'Y') {
+            std::cout << "Preset not saved. Returning...\n";
+            return;
+        }
+    }
+
+    if (!SavePreset(fname, state)) {
+        std::cerr << "Error writing file: " << fname << "\n";
+        return;
+    }
+    std::cout << "Preset saved as " << fname << "\n";
+}
+
+// Helper: displays the list of presets
+// ----------------------------------------------------------------------------------
+// Function: DisplayPresetMenu
+// Purpose:  Shows the list of available presets in the console
+// Input:    vector of pairs <presetName, description>
+// Output:   Prints the presets with their descriptions
+// Operation: - Iterate over the list
+//            - Print each preset with description
+// ----------------------------------------------------------------------------------
+void DisplayPresetMenu(const std::vector<std::pair<std::string, std::string>>& presets) {
+    std::cout << "\nAvailable presets in 'presets/':\n";
+    for (auto& p : presets) {
+        std::cout << "  - " << p.first << " : " << p.second << "\n";
+    }
+}
+
+// Helper: asks user for preset choice
+// ----------------------------------------------------------------------------------
+// Function: GetUserPresetChoice
+// Purpose:  Prompts the user to enter the name of a preset
+// Output:   Chosen preset name as a string
+// Operation: - Read input from user via std::getline
+//            - Return the input
+// ----------------------------------------------------------------------------------
+std::string GetUserPresetChoice() {
+    std::string name;
+    std::cin.ignore();
+    std::cout << "\nEnter preset name (without 'presets/' and '.json'): ";
+    std::getline(std::cin, name);
+    return name;
+}
+
+// -----------------------------------------------------------
+// Function: PickPreset
+// Purpose:  Interactive preset selection that filters while typing.
+// Params:   title - shown above the list (e.g. "Load preset")
+// Operation:
+//   - builds the preset catalog once (ListPresets)
+//   - every key updates the incremental search and redraws a fixed
+//     block of console lines in place, so nothing scrolls
+//   - Up/Down/PgUp/PgDn move the selection, Enter picks, Esc returns,
+//     Backspace removes a character, Ctrl+U clears the filter
+// Return:   chosen preset name; empty when cancelled or no presets
+// -----------------------------------------------------------
+static std::string PickPreset(const std::string& title) {
+    auto presets = ListPresets();
+    if (presets.empty()) {
+        std::cout << "Error! No presets found in the 'presets/' folder.\n";
+        return "";
+    }
+    PresetCatalog catalog = BuildPresetCatalog(std::move(presets));
+
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    CONSOLE_SCREEN_BUFFER_INFO info{};
+    int width = 80, height = 25;
+    if (GetConsoleScreenBufferInfo(hConsole, &info)) {
+        width = info.srWindow.Right - info.srWindow.Left + 1;
+        height = info.srWindow.Bottom - info.srWindow.Top + 1;
+    }
+    const size_t rows = static_cast<size_t>(std::max(3, std::min(15, height - 5)));
+    const size_t kRankLimit = 500;   // selectable results
+
+    // Reserve the block (filter line + rows), then remember where it starts
+    std::cout << "\n" << title << " - type to filter, Up/Down to select, Enter to pick, Esc to return\n";
+    for (size_t r = 0; r <= rows; ++r) std::cout << "\n";
+    std::cout.flush();
+    short top = 0;
+    if (GetConsoleScreenBufferInfo(hConsole, &info))
+        top = static_cast<short>(std::max(0, info.dwCursorPosition.Y - static_cast<int>(rows) - 1));
+
+    PresetSearch search;
+    StartPresetSearch(search, catalog, kRankLimit);
+    std::string filter;
+    size_t selected = 0, first = 0;
+    double lastMs = 0.0;
+
+    auto fit = [width](std::string text) {
+        size_t w = static_cast<size_t>(std::max(1, width - 1));   // never touch the last column (wraps)
+        if (text.size() > w) text.resize(w);
+        text.append(w - text.size(), ' ');
+        return text;
+    };
+    auto draw = [&]() {
+        SetConsoleCursorPosition(hConsole, COORD{ 0, top });
+        std::ostringstream head;
+        head << "Filter: " << filter << "_   " << search.matches << "/" << catalog.names.size()
+            << " presets  (" << std::fixed << std::setprecision(2) << lastMs << " ms)";
+        std::string frame = fit(head.str()) + "\n";
+        std::cout << frame;
+        for (size_t r = 0; r < rows; ++r) {
+            size_t k = first + r;
+            std::string text;
+            if (k < search.ranked.size()) {
+                uint32_t i = search.ranked[k].index;
+                text = (k == selected ? "> " : "  ") + catalog.names[i];
+                if (!catalog.descriptions[i].empty()) text += " : " + catalog.descriptions[i];
+            }
+            if (k == selected && k < search.ranked.size()) {
+                std::cout.flush();
+                SetConsoleTextAttribute(hConsole, FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+                std::cout << fit(text);
+                std::cout.flush();
+                SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+                std::cout << "\n";
+            }
+            else std::cout << fit(text) << "\n";
+        }
+        std::cout.flush();
+    };
+
+    std::string result;
+    draw();
+    for (;;) {
+        int c = _getch();
+        if (c < 0 || c == 27) break;
+        if (c == 0 || c == 224) {            // arrow / page keys
+            int key = _getch();
+            size_t last = search.ranked.empty() ? 0 : search.ranked.size() - 1;
+            if (key == 72) selected -= std::min<size_t>(selected, 1);
+            else if (key == 80) selected = std::min(selected + 1, last);
+            else if (key == 73) selected -= std::min(selected, rows);
+            else if (key == 81) selected = std::min(selected + rows, last);
+            else continue;
+        }
+        else if (c == 13) {
+            if (search.ranked.empty()) continue;
+            result = catalog.names[search.ranked[selected].index];
+            break;
+        }
+        else if (c == 8 || c == 21 || (c >= 32 && c != 127 && c < 256)) {
+            if (c == 8) {
+                if (filter.empty()) continue;
+                filter.pop_back();
+            }
+            else if (c == 21) filter.clear();
+            else filter += static_cast<char>(c);
+            auto t0 = Clock::now();
+            UpdatePresetSearch(search, filter, kRankLimit);
+            lastMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+            selected = first = 0;
+        }
+        else continue;
+        if (selected < first) first = selected;
+        if (selected >= first + rows) first = selected - rows + 1;
+        draw();
+    }
+    SetConsoleCursorPosition(hConsole, COORD{ 0, static_cast<short>(top + rows + 1) });
+    return result;
+}
+
+// Main function
+/** LoadPresetMenu
+ * ----------------------
+ * Lets the user pick a preset from the "presets/" folder with the
+ * filtering picker (PickPreset): typing narrows the list by name and
+ * description, Enter loads the selected preset into the given VideoHubState.
+ * After loading, preset details are displayed:
+ *   - Description
+ *   - Input labels
+ *   - Output labels
+ *   - Routing (which input goes to which output)
+ *
+ * Requirements:
+ *   - ListPresets() returns a vector of pairs (name, description)
+ *     (PickPreset builds its search catalog from it)
+ *   - LoadPreset(filename, state) loads the preset into state
+ *
+ * Example usage:
+ *   VideoHubState state;
+ *   LoadPresetMenu(state);
+ */
+void LoadPresetMenu(VideoHubState& state) {
+    // Pick a preset (filter while typing)
+    std::string name = PickPreset("Load preset");
+    if (name.empty()) {
+        std::cout << "Returning to main menu...\n";
+        return;
+    }
+    std::string fname = "presets/" + name + ".json";
+
+    if (!LoadPreset(fname, state)) {
+        std::cout << "Error! Failed to load preset: " << fname << "\n";
+        return;
+    }
+
+    // Display loaded preset info
+    std::cout << "\nLoaded preset: " << fname << "\n";
+    std::cout << "Description: " << state.description << "\n";
+
+    // Inputs
+    std::cout << "\n--- Inputs ---\n";
+    std::cout << std::left << std::setw(6) << "Index" << "Label\n";
+    std::cout << "-------------------------\n";
+    for (auto& kv : state.inputLabels)
+        std::cout << std::left << std::setw(6) << kv.first << kv.second << "\n";
+
+    // Outputs
+    std::cout << "\n--- Outputs ---\n";
+    std::cout << std::left << std::setw(6) << "Index" << "Label\n";
+    std::cout << "-------------------------\n";
+    for (auto& kv : state.outputLabels)
+        std::cout << std::left << std::setw(6) << kv.first << kv.second << "\n";
+
+    // Routing (video, then further levels present in the preset)
+    for (auto& level : kRoutingLevels) {
+        const auto& routing = state.*level.routing;
+        if (!IsVideoLevel(level) && routing.empty()) continue;
+        auto& outLabels = state.*level.outputLabels;
+        auto& srcLabels = state.*level.sourceLabels;
+        std::cout << "\n--- " << (IsVideoLevel(level) ? std::string("Routing") : std::string(level.name) + " routing") << " ---\n";
+        std::cout << std::left << std::setw(8) << "OutIdx"
+            << std::setw(20) << "Output Label"
+            << std::setw(8) << "InIdx"
+            << "Input Label\n";
+        std::cout << "------------------------------------------------------------\n";
+        for (auto& kv : routing) {
+            std::string outName = outLabels.count(kv.first) ? outLabels[kv.first] : "(unknown)";
+            std::string inName = srcLabels.count(kv.second) ? srcLabels[kv.second] : "(unknown)";
+            std::cout << std::left << std::setw(8) << kv.first
+                << std::setw(20) << outName
+                << std::setw(8) << kv.second
+                << inName << "\n";
+        }
+    }
+    PrintSerialPorts(state);
+    gLoadedPreset = state.description; // store description or filename
+}
+
+// Main function
+// -----------------------------------------------------------
+// Functie: DeletePresetMenu
+// Doel:    Laat de gebruiker een preset selecteren en verwijderen.
+// Werking:
+//   1. Haalt lijst van beschikbare presets op (uit 'presets/' folder)
+//   2. Toont de zoekbare lijst (PickPreset): typen filtert op naam
+//      en beschrijving, Esc gaat terug naar het hoofdmenu
+//   3. De gebruiker kiest een preset met pijltjes + Enter
+//   4. Vraagt bevestiging (y/n)
+//   5. Probeert gekozen preset (.json bestand) te verwijderen
+//   6. Meldt succes of foutmelding
+// -----------------------------------------------------------
+void DeletePresetMenu() {
+    // Pick the preset to delete (filter while typing, Esc returns)
+    std::string name = PickPreset("Delete preset");
+    if (name.empty()) {
+        std::cout << "Returning to main menu...\n";
+        return;
+    }
+    std::string fname = "presets/" + name + ".json";
+
+    // Ask confirmation before deleting
+    std::cout << "Are you sure you want to delete '" << fname << "'? (y/n): ";
+    char confirm;
+    std::cin >> confirm;
+    if (confirm != 'y' && confirm != 'Y') {
+        std::cout << "Deletion canceled.\n";
+        return;
+    }
+
+    // Attempt to remove the file
+    try {
+        if (fs::remove(fname)) {
+            std::cout << "Preset deleted: " << fname << "\n";
+        }
+        else {
+            std::cout << "Error! Failed to delete preset: " << fname << "\n";
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception while deleting preset: " << e.what() << "\n";
+    }
+}
+
+// Main function
+// Function: CompareCurrentHub
+// Purpose:  Compares a loaded preset with the current Videohub status
+// Params:
+//   loadedPreset = VideoHubState of the loaded preset
+//   currentHub   = VideoHubState of the current hub status
+// Operation:
+//   1. Checks if a preset is loaded and if the hub has been read
+//   2. Compares for each output the preset input vs the hub input (CompareRouting),
+//      per routing level; further levels only when preset or hub has routes
+//   3. Prints a table with colors: green = match, red = difference
+//   5. Prints a legend at the bottom
+void CompareCurrentHub(VideoHubState& loadedPreset, VideoHubState& currentHub) {
+    if (loadedPreset.routing.empty()) {
+        std::cout << "\n!!! No preset loaded. Load a preset first.\n";
+        return;
+    }
+    if (!gVideoHubRead) {
+        std::cout << "\n!!! Videohub has not been read yet. Run 'Read Videohub' first.\n";
+        return;
+    }
+
+    std::cout << "\n=== Comparison: Loaded Preset vs Current Videohub ===\n";
+
+    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+
+    for (auto& level : kRoutingLevels) {
+        const auto& presetRouting = loadedPreset.*level.routing;
+        const auto& hubRouting = currentHub.*level.routing;
+        if (!IsVideoLevel(level) && presetRouting.empty() && hubRouting.empty()) continue;
+        auto& presetOutputs = loadedPreset.*level.outputLabels;
+        auto& hubOutputs = currentHub.*level.outputLabels;
+        auto& presetSources = loadedPreset.*level.sourceLabels;
+        auto& hubSources = currentHub.*level.sourceLabels;
+
+        std::cout << "\n" << (IsVideoLevel(level) ? "" : std::string(level.outputNoun) + "s:\n");
+        std::cout << std::left
+            << std::setw(20) << "Output Label"
+            << std::setw(20) << "Preset Input"
+            << std::setw(20) << "Hub Input"
+            << "Diff\n";
+        std::cout << "----------------------------------------------------------------\n";
+
+        for (auto& cmp : CompareRouting(presetRouting, hubRouting)) {
+            int outIdx = cmp.output;
+            int presetIn = cmp.presetInput;
+            int hubIn = cmp.hubInput;
+
+            std::string outLabel = presetOutputs.count(outIdx) ? presetOutputs[outIdx] :
+                hubOutputs.count(outIdx) ? hubOutputs[outIdx] : "(unknown)";
+            std::string presetInLabel = presetSources.count(presetIn) ? presetSources[presetIn] : "(none)";
+            std::string hubInLabel = hubSources.count(hubIn) ? hubSources[hubIn] : "(none)";
+
+            bool isDiff = cmp.differs();
+
+            // Set color (red for difference, green for match)
+            SetConsoleTextAttribute(hConsole, isDiff ? FOREGROUND_RED | FOREGROUND_INTENSITY
+                : FOREGROUND_GREEN | FOREGROUND_INTENSITY);
+
+            std::cout << std::left
+                << std::setw(20) << outLabel
+                << std::setw(20) << presetInLabel
+                << std::setw(20) << hubInLabel
+                << (isDiff ? "*" : "")
+                << "\n";
+        }
+    }
+
+    // Reset color
+    SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+
+    std::cout << "\nLegend:\n  Green = preset matches hub\n  Red = difference (*)\n\n";
+}
+
+
+// Main function
+// -----------------------------------------------------------
+// Function: SetVideoHubIP
+// Purpose:  Sets the VideoHub IP via a menu
+// Operation: 
+//   1. Show menu with 5 options (new IP, 12x12, 40x40, discover, known hubs)
+//   2. For choice 1: enter IP / host name and validate using IsValidHubAddress()
+//   3. For choice 2 or 3: set fixed IP
+//   4. For choice 4: scan address ranges (DiscoverVideoHubsMenu)
+//      For choice 5: pick a hub from the registry (SelectHubFromRegistry)
+//   5. Invalid choice -> error message, hubIP unchanged
+// Usage:    To be called from main menu via case 7
+// -----------------------------------------------------------
+void SetVideoHubIP() {
+    std::cout << "Choose an option:\n";
+    std::cout << "1) Enter new IP address or host name\n";
+    std::cout << "2) Videohub 12x12 (192.168.1.248)\n";
+    std::cout << "3) Videohub 40x40 (172.20.5.247)\n";
+    std::cout << "4) Discover Videohubs on the network\n";
+    std::cout << "5) Choose from known hubs (hubs.json)\n";
+    std::cout << "Enter choice (1-5): ";
+
+    int choice;
+    std::cin >> choice;
+
+    switch (choice) {
+    case 1: {
+        std::cout << "Enter new IP address (IPv4 / IPv6) or host name, optionally with :port: ";
+        std::string newIP;
+        std::cin >> newIP;
+
+        std::string host;
+        int port = 9990;   // no port given: the standard port, not the previous hub's
+        if (SplitHubAddress(newIP, host, port)) {
+            gResolver.prefetch(host); // resolve while the user continues
+            hubIP = host;
+            hubPort = port;
+            std::cout << "VideoHub IP set to: " << hubIP << (hubPort != 9990 ? ":" + std::to_string(hubPort) : "") << "\n";
+        }
+        else {
+            std::cout << "Invalid address: " << newIP << "\n";
+        }
+        break;
+    }
+    case 2:
+        hubIP = "192.168.1.248";
+        hubPort = 9990;
+        std::cout << "VideoHub 12x12 IP set to: " << hubIP << "\n";
+        break;
+    case 3:
+        hubIP = "172.20.5.247";
+        hubPort = 9990;
+        std::cout << "VideoHub 40x40 IP set to: " << hubIP << "\n";
+        break;
+    case 4:
+        DiscoverVideoHubsMenu();
+        break;
+    case 5:
+        SelectHubFromRegistry();
+        break;
+    default:
+        std::cout << "Invalid choice.\n";
+        break;
+    }
+}
+
+// --------------------- Allocation counter ---------------------
+// Global operator new counts every heap allocation, so the benchmark
+// suite can report allocations per operation. The cost is one relaxed
+// atomic increment per allocation.
+std::atomic<unsigned long long> gAllocCount{ 0 };
+
+void* operator new(std::size_t n) {
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// --------------------- Parser self-check / benchmark ---------------------
+// Command line mode "--bench-parse": feeds a synthetic 288x288 hub stream
+// (prelude, change notifications, ACK/NAK, CRLF line endings, labels with
+// dots and colons) through HubBlockReader + ApplyBlockToMirror at several
+// fragmentations, down to one byte per read. Every pass must end with the
+// expected mirror and ACK/NAK counts. Prints MB/s per fragmentation and
+// returns 1 on any mismatch, so it can run as a check in a build script.
+
+// Brief comment: synthetic stream and the state a correct parser ends with
+struct ParseBenchStream {
+    std::string bytes;
+    std::string prelude;       // expected captured prelude ('\r' removed)
+    VideoHubState expected;
+    int acks = 0;
+    int naks = 0;
+};
+
+// Brief comment: builds the synthetic stream (deterministic)
+ParseBenchStream BuildParseBenchStream(int size, int changeBlocks) {
+    ParseBenchStream st;
+    std::ostringstream pre;
+    pre << "PROTOCOL PREAMBLE:\nVersion: 2.8\n\n"
+        << "VIDEOHUB DEVICE:\nDevice present: true\nModel name: Blackmagic Universal Videohub 288\n"
+        << "Video inputs: " << size << "\nVideo outputs: " << size << "\n\n";
+    pre << "INPUT LABELS:\n";
+    for (int i = 0; i < size; ++i) {
+        std::string label = (i % 7 == 0) ? "" : "Cam " + std::to_string(i) + ".1: Studio " + std::to_string(i % 5);
+        pre << i << " " << label << "\n";
+        st.expected.inputLabels[i] = " " + label;   // parseLabelTokens keeps the separator space
+    }
+    pre << "\nOUTPUT LABELS:\n";
+    for (int i = 0; i < size; ++i) {
+        std::string label = "Monitor " + std::to_string(i + 1);
+        pre << i << " " << label << "\n";
+        st.expected.outputLabels[i] = " " + label;
+    }
+    pre << "\nVIDEO OUTPUT LOCKS:\n";
+    for (int i = 0; i < size; ++i) pre << i << " U\n";
+    pre << "\nVIDEO OUTPUT ROUTING:\n";
+    for (int i = 0; i < size; ++i) {
+        pre << i << " " << (i * 7) % size << "\n";
+        st.expected.routing[i] = (i * 7) % size;
+    }
+    pre << "\nCONFIGURATION:\nTake Mode: false\n\nEND PRELUDE:\n\n";
+    st.prelude = pre.str();
+    st.bytes = st.prelude;
+
+    // change notifications mixed with ACK/NAK, some with CRLF line endings
+    unsigned seed = 12345;
+    auto rnd = [&seed]() { seed = seed * 1103515245u + 12345u; return (seed >> 8) & 0xFFFF; };
+    for (int n = 0; n < changeBlocks; ++n) {
+        std::ostringstream blk;
+        if (n % 5 == 0) {
+            blk << "ACK\n\n";
+            ++st.acks;
+        }
+        else if (n % 17 == 0) {
+            blk << "NAK\n\n";
+            ++st.naks;
+        }
+        else if (n % 11 == 0) {
+            int o = rnd() % size;
+            std::string label = "Renamed " + std::to_string(n);
+            blk << "OUTPUT LABELS:\n" << o << " " << label << "\n\n";
+            st.expected.outputLabels[o] = " " + label;
+        }
+        else {
+            blk << "VIDEO OUTPUT ROUTING:\n";
+            int lines = 1 + rnd() % 3;
+            for (int l = 0; l < lines; ++l) {
+                int o = rnd() % size, i = rnd() % size;
+                blk << o << " " << i << "\n";
+                st.expected.routing[o] = i;
+            }
+            blk << "\n";
+        }
+        std::string text = blk.str();
+        if (n % 3 == 0) {
+            std::string crlf;
+            for (char c : text) {
+                if (c == '\n') crlf += '\r';
+                crlf += c;
+            }
+            text = crlf;
+        }
+        st.bytes += text;
+    }
+    return st;
+}
+
+// Brief comment: feeds the stream in fragments of chunk() bytes; true when the result is correct
+bool RunParsePass(const ParseBenchStream& st, const std::function<size_t()>& chunk) {
+    HubSession s;
+    HubBlock b;
+    int acks = 0, naks = 0;
+    Clock::time_point stamp;
+    bool acked = false;
+    size_t pos = 0;
+    while (pos < st.bytes.size()) {
+        size_t n = std::min(chunk(), st.bytes.size() - pos);
+        s.reader.feed(st.bytes.data() + pos, n);
+        pos += n;
+        while (s.reader.next(b)) {
+            if (PopHubAck(s, b, stamp, acked)) ++(acked ? acks : naks);
+            else ApplyBlockToMirror(s, b);
+        }
+    }
+    return s.preludeDone && s.prelude == st.prelude && acks == st.acks && naks == st.naks &&
+        s.mirror.routing == st.expected.routing &&
+        s.mirror.inputLabels == st.expected.inputLabels &&
+        s.mirror.outputLabels == st.expected.outputLabels;
+}
+
+// -----------------------------------------------------------
+// Function: RunParseBenchmark
+// Purpose:  Command line mode "--bench-parse" (see above).
+// Return:   process exit code, 0 = all passes correct
+// -----------------------------------------------------------
+int RunParseBenchmark() {
+    ParseBenchStream st = BuildParseBenchStream(288, 20000);
+    std::mt19937 rng(42);
+    struct Mode { std::string name; std::function<size_t()> chunk; int passes; };
+    std::vector<Mode> modes = {
+        { "whole stream", [&st]() { return st.bytes.size(); }, 20 },
+        { "1460 B (TCP segment)", []() { return size_t(1460); }, 20 },
+        { "97 B", []() { return size_t(97); }, 10 },
+        { "random 1..64 B", [&rng]() { return size_t(1 + rng() % 64); }, 10 },
+        { "7 B", []() { return size_t(7); }, 5 },
+        { "1 B", []() { return size_t(1); }, 3 },
+    };
+
+    std::cout << "Parser check: " << st.bytes.size() << " bytes per pass (288x288 prelude + 20000 blocks)\n";
+    std::cout << std::left << std::setw(24) << "Fragmentation" << std::setw(10) << "Result" << "MB/s\n";
+    std::cout << std::string(44, '-') << "\n";
+    bool allOk = true;
+    for (auto& m : modes) {
+        bool ok = true;
+        auto t0 = Clock::now();
+        for (int i = 0; i < m.passes; ++i) ok = RunParsePass(st, m.chunk) && ok;
+        double ms = ElapsedMs(t0, Clock::now());
+        double mbps = ms > 0 ? (double)st.bytes.size() * m.passes / (1024.0 * 1024.0) / (ms / 1000.0) : 0.0;
+        std::cout << std::left << std::setw(24) << m.name << std::setw(10) << (ok ? "OK" : "MISMATCH")
+            << std::fixed << std::setprecision(1) << mbps << "\n";
+        allOk = allOk && ok;
+    }
+    std::cout << (allOk ? "All passes correct.\n" : "Parser mismatch detected.\n");
+    return allOk ? 0 : 1;
+}
+
+// --------------------- Churn load generator ---------------------
+// Command line mode "--bench-churn": how many route changes per second
+// the live mirror (HubSession + ApplyBlockToMirror, the path used by
+// replication, failover and the background read) absorbs before it
+// falls behind. A driver connection plays the front panel and changes
+// routes at stepped rates, optionally in bursts; the hub pushes every
+// change to all clients, so a second, mirror connection sees exactly
+// what it would see for a front-panel change. Lag per change is the
+// time from the driver's send to the moment the mirror holds the new
+// route. Best run against VideoHubSim on the same machine.
+
+// Brief comment: percentile (0..100) of a list of values; sorts the list
+double Percentile(std::vector<double>& v, double p) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t idx = static_cast<size_t>(p / 100.0 * (v.size() - 1) + 0.5);
+    return v[std::min(idx, v.size() - 1)];
+}
+
+// Brief comment: settings of the churn load generator
+struct ChurnOptions {
+    std::string host;
+    int port = 9990;
+    std::vector<int> rates{ 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000 };  // changes per second
+    int stepSeconds = 3;
+    int burst = 1;         // changes sent back to back per burst
+    double maxLagMs = 50;  // p99 lag above this counts as saturated
+};
+
+// Brief comment: result of one rate step
+struct ChurnStep {
+    int rate = 0;
+    double sentRate = 0, mirroredRate = 0;   // changes per second actually sent / mirrored in time
+    double p50 = 0, p99 = 0, maxLag = 0;     // ms
+    size_t lost = 0;                         // changes never seen by the mirror
+    double applyUs = 0;                      // mirror CPU time per change (ApplyBlockToMirror)
+    bool saturated = false;
+};
+
+// -----------------------------------------------------------
+// Function: RunChurnStep
+// Purpose:  Drives one rate step and measures the mirror lag.
+// Operation:
+//   1. Every wakeup the driver sends all changes that are due
+//      (in whole bursts), each as its own routing block, to
+//      outputs in turn, always to a different input
+//   2. Both sessions are read; the mirror applies every block and
+//      matches routing lines against the outstanding changes
+//   3. After the step the mirror may catch up for up to 2 s;
+//      what is still outstanding then counts as lost
+// Notes:    Data still in flight from a previous (saturated) step is
+//           first drained until the mirror is quiet for 200 ms.
+// -----------------------------------------------------------
+ChurnStep RunChurnStep(HubSession& driver, HubSession& mirror, const ChurnOptions& opt, int rate,
+    std::map<int, int>& lastSent, int inputs) {
+    ChurnStep st;
+    st.rate = rate;
+    std::map<int, std::deque<std::pair<int, Clock::time_point>>> outstanding;  // output -> (input, sent)
+    std::vector<double> lags;
+    size_t sent = 0, mirroredInTime = 0, pendingCount = 0;
+    double applyMs = 0;
+    size_t applied = 0;
+    int nextOutput = 0;
+    int outputs = static_cast<int>(lastSent.size());
+    HubBlock b;
+
+    auto quietSince = Clock::now();
+    auto settleEnd = quietSince + std::chrono::seconds(10);
+    while (Clock::now() < settleEnd && ElapsedMs(quietSince, Clock::now()) < 200 && mirror.connected()) {
+        if (WaitForSessions({ &driver, &mirror }, 50) > 0) quietSince = Clock::now();
+        while (driver.reader.next(b)) {}
+        while (mirror.reader.next(b)) ApplyBlockToMirror(mirror, b);
+    }
+    driver.pendingAcks.clear();
+    for (auto& r : mirror.mirror.routing) lastSent[r.first] = r.second;
+
+    auto start = Clock::now();
+    auto stepEnd = start + std::chrono::seconds(opt.stepSeconds);
+    auto drainEnd = stepEnd + std::chrono::seconds(2);
+    while (true) {
+        auto now = Clock::now();
+        if (now >= drainEnd || (now >= stepEnd && pendingCount == 0)) break;
+        if (!driver.connected() || !mirror.connected()) break;
+
+        // 1. send what is due
+        if (now < stepEnd) {
+            size_t due = static_cast<size_t>(ElapsedMs(start, now) * rate / 1000.0);
+            due = due > sent ? due - sent : 0;
+            due -= due % opt.burst;
+            if (due > 0) {
+                std::string batch;
+                for (size_t k = 0; k < due; ++k) {
+                    int o = nextOutput;
+                    nextOutput = (nextOutput + 1) % outputs;
+                    int i = (lastSent[o] + 1) % inputs;
+                    lastSent[o] = i;
+                    batch += BuildRoutingBlock("VIDEO OUTPUT ROUTING", { { o, i } });
+                    outstanding[o].push_back({ i, now });
+                    driver.pendingAcks.push_back(now);
+                }
+                if (!sendAll(driver.sock, std::vector<unsigned char>(batch.begin(), batch.end()))) {
+                    CloseHubSession(driver);
+                    break;
+                }
+                sent += due;
+                pendingCount += due;
+            }
+        }
+
+        // 2. read both connections
+        WaitForSessions({ &driver, &mirror }, 1);
+        Clock::time_point stamp;
+        bool acked;
+        while (driver.reader.next(b)) PopHubAck(driver, b, stamp, acked);
+        while (mirror.reader.next(b)) {
+            auto t0 = Clock::now();
+            ApplyBlockToMirror(mirror, b);
+            auto t1 = Clock::now();
+            if (b.header != "VIDEO OUTPUT ROUTING") continue;
+            applyMs += ElapsedMs(t0, t1);
+            for (auto& r : ParseRoutingLines(b.lines)) {
+                ++applied;
+                auto it = outstanding.find(r.first);
+                if (it == outstanding.end()) continue;
+                auto& q = it->second;
+                // older changes to this output that never echoed were superseded
+                while (!q.empty() && q.front().first != r.second) {
+                    q.pop_front();
+                    --pendingCount;
+                    ++st.lost;
+                }
+                if (q.empty()) continue;
+                lags.push_back(ElapsedMs(q.front().second, t1));
+                if (t1 <= stepEnd) ++mirroredInTime;
+                q.pop_front();
+                --pendingCount;
+            }
+        }
+    }
+
+    st.lost += pendingCount;
+    double seconds = opt.stepSeconds;
+    st.sentRate = sent / seconds;
+    st.mirroredRate = mirroredInTime / seconds;
+    st.p50 = Percentile(lags, 50);
+    st.p99 = Percentile(lags, 99);
+    st.maxLag = lags.empty() ? 0 : lags.back();
+    st.applyUs = applied ? applyMs * 1000.0 / applied : 0;
+    st.saturated = st.lost > 0 || st.p99 > opt.maxLagMs ||
+        st.sentRate < 0.95 * rate || st.mirroredRate < 0.90 * rate;
+    return st;
+}
+
+// -----------------------------------------------------------
+// Function: RunChurnBenchmark
+// Purpose:  Command line mode "--bench-churn host[:port] [options]".
+// Options:  --rates 100,1000,...  changes per second per step
+//           --step S              seconds per step (default 3)
+//           --burst N             changes per burst (default 1 = evenly spaced)
+//           --max-lag MS          p99 lag that counts as saturated (default 50)
+// Return:   process exit code (1 = no connection or bad arguments)
+// Notes:    Stops after two saturated steps in a row and reports the
+//           highest rate that was still absorbed.
+// -----------------------------------------------------------
+int RunChurnBenchmark(const std::vector<std::string>& args) {
+    ChurnOptions opt;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            auto value = [&]() -> std::string {
+                if (a + 1 >= args.size()) throw std::invalid_argument(args[a]);
+                return args[++a];
+            };
+            if (args[a] == "--rates") {
+                opt.rates.clear();
+                std::istringstream iss(value());
+                std::string r;
+                while (std::getline(iss, r, ',')) opt.rates.push_back(std::stoi(r));
+            }
+            else if (args[a] == "--step") opt.stepSeconds = std::stoi(value());
+            else if (args[a] == "--burst") opt.burst = std::stoi(value());
+            else if (args[a] == "--max-lag") opt.maxLagMs = std::stod(value());
+            else if (opt.host.empty() && SplitHubAddress(args[a], opt.host, opt.port)) {}
+            else throw std::invalid_argument(args[a]);
+        }
+    }
+    catch (...) {
+        opt.host.clear();
+    }
+    if (opt.host.empty() || opt.rates.empty() || opt.stepSeconds < 1 || opt.burst < 1 ||
+        std::any_of(opt.rates.begin(), opt.rates.end(), [](int r) { return r < 1; })) {
+        std::cerr << "Usage: VideoHubHL --bench-churn host[:port] [--rates 100,1000,...] [--step S]"
+            << " [--burst N] [--max-lag MS]\n";
+        return 1;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+    HubSession driver, mirror;
+    driver.ip = mirror.ip = opt.host;
+    driver.port = mirror.port = opt.port;
+    if (!OpenHubSession(driver) || !OpenHubSession(mirror)) {
+        std::cerr << "Error: Cannot connect to Videohub " << opt.host << ":" << opt.port << ".\n";
+        CloseHubSession(driver);
+        CloseHubSession(mirror);
+        WSACleanup();
+        return 1;
+    }
+
+    int inputs = static_cast<int>(mirror.mirror.inputLabels.size());
+    std::map<int, int> lastSent = mirror.mirror.routing;
+    if (inputs < 2 || lastSent.empty()) {
+        std::cerr << "Error: hub reports no usable routing.\n";
+        CloseHubSession(driver);
+        CloseHubSession(mirror);
+        WSACleanup();
+        return 1;
+    }
+
+    std::cout << "Churn load on " << opt.host << ":" << opt.port << " (" << inputs << "x" << lastSent.size()
+        << "), " << opt.stepSeconds << " s per step, burst " << opt.burst << ", saturated above p99 "
+        << opt.maxLagMs << " ms\n\n";
+    std::cout << std::right << std::setw(8) << "Target" << std::setw(10) << "Sent/s" << std::setw(10) << "Mirror/s"
+        << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+        << std::setw(8) << "Lost" << std::setw(10) << "Apply us" << "\n";
+    std::cout << std::string(76, '-') << "\n";
+
+    int sustained = 0, firstSaturated = 0, saturatedInRow = 0;
+    for (int rate : opt.rates) {
+        ChurnStep st = RunChurnStep(driver, mirror, opt, rate, lastSent, inputs);
+        std::cout << std::fixed << std::setprecision(1) << std::setw(8) << st.rate << std::setw(10) << st.sentRate
+            << std::setw(10) << st.mirroredRate << std::setw(10) << st.p50 << std::setw(10) << st.p99
+            << std::setw(10) << st.maxLag << std::setw(8) << st.lost << std::setw(10) << std::setprecision(2)
+            << st.applyUs << (st.saturated ? "  SATURATED" : "") << "\n";
+        if (!driver.connected() || !mirror.connected()) {
+            std::cout << "Connection lost.\n";
+            break;
+        }
+        if (st.saturated) {
+            if (!firstSaturated) firstSaturated = rate;
+            if (++saturatedInRow == 2) break;
+            // reconnect so the backlog queued in the hub does not spill into the next step
+            if (!OpenHubSession(driver) || !OpenHubSession(mirror)) {
+                std::cout << "Connection lost.\n";
+                break;
+            }
+        }
+        else {
+            sustained = std::max(sustained, rate);
+            saturatedInRow = 0;
+        }
+    }
+
+    std::cout << "\nHighest rate absorbed: " << (sustained ? std::to_string(sustained) + " changes/s" : std::string("none"))
+        << "\nSaturation point:      " << (firstSaturated ? std::to_string(firstSaturated) + " changes/s" : std::string("not reached"))
+        << "\n";
+
+    CloseHubSession(driver);
+    CloseHubSession(mirror);
+    WSACleanup();
+    return 0;
+}
+
+// --------------------- Take-to-echo latency probe ---------------------
+// Command line mode "--probe-latency": what an operator feels is the time
+// from pressing take until the hub shows the new routing. The probe fires
+// calibrated takes (one at a time, to a different input each time, with
+// a pause in between so nothing queues) and timestamps per take:
+//   send -> ACK          hub accepted the command
+//   send -> echo         the routing block for an output came back
+//   send -> take done    the last output of the take was echoed
+// With a batch sweep each take routes B outputs in one block, to find
+// the batch size with the best throughput per hub model.
+
+// Brief comment: latencies of all takes with one batch size (ms)
+struct TakeProbeStats {
+    int batch = 1;
+    std::vector<double> ack, echo, take;
+    int naks = 0;
+    int timeouts = 0;
+};
+
+// -----------------------------------------------------------
+// Function: RunTakeProbe
+// Purpose:  Fires `takes` takes of `batch` outputs on an open session
+//           and collects ACK, per-output echo and take latencies.
+// Notes:    A take that is not complete within 2 s counts as timeout;
+//           outputs rotate so consecutive takes touch different outputs.
+// -----------------------------------------------------------
+TakeProbeStats RunTakeProbe(HubSession& s, int batch, int takes, int gapMs) {
+    int inputs = static_cast<int>(s.mirror.inputLabels.size());
+    std::vector<int> outputs;
+    for (auto& r : s.mirror.routing) outputs.push_back(r.first);
+    TakeProbeStats st;
+    st.batch = batch = std::min<int>(batch, static_cast<int>(outputs.size()));  // at most all outputs
+    size_t nextOutput = 0;
+    HubBlock b;
+
+    for (int t = 0; t < takes && s.connected(); ++t) {
+        std::map<int, int> take;
+        while (static_cast<int>(take.size()) < batch) {
+            int o = outputs[nextOutput++ % outputs.size()];
+            take[o] = (s.mirror.routing[o] + 1) % inputs;
+        }
+        std::map<int, int> waiting = take;
+
+        auto sentAt = Clock::now();
+        if (!SendHubCommand(s, BuildRoutingBlock("VIDEO OUTPUT ROUTING", take), sentAt)) break;
+        bool answered = false, acked = false;
+        auto deadline = sentAt + std::chrono::seconds(2);
+        while ((!answered || (acked && !waiting.empty())) && s.connected() && Clock::now() < deadline) {
+            WaitForSessions({ &s }, 1);
+            auto now = Clock::now();
+            while (s.reader.next(b)) {
+                Clock::time_point stamp;
+                bool wasAck;
+                if (PopHubAck(s, b, stamp, wasAck)) {
+                    answered = true;
+                    acked = wasAck;
+                    if (acked) st.ack.push_back(ElapsedMs(sentAt, now));
+                    continue;
+                }
+                for (auto& r : ApplyBlockToMirror(s, b)) {
+                    auto it = waiting.find(r.first);
+                    if (it == waiting.end() || it->second != r.second) continue;
+                    st.echo.push_back(ElapsedMs(sentAt, now));
+                    waiting.erase(it);
+                }
+            }
+        }
+
+        if (answered && !acked) ++st.naks;
+        else if (!waiting.empty()) ++st.timeouts;
+        else st.take.push_back(ElapsedMs(sentAt, Clock::now()));
+        Sleep(gapMs);
+    }
+    return st;
+}
+
+// Brief comment: "p50 / p99" of a list of latencies in ms
+std::string FormatLatency(std::vector<double> v) {
+    if (v.empty()) return "-";
+    std::ostringstream o;
+    o << std::fixed << std::setprecision(2) << Percentile(v, 50) << " / " << Percentile(v, 99);
+    return o.str();
+}
+
+// -----------------------------------------------------------
+// Function: RunLatencyProbe
+// Purpose:  Command line mode "--probe-latency host[:port] ... [options]".
+// Options:  --takes N             takes per batch size (default 200)
+//           --gap MS              pause between takes (default 20)
+//           --batch-sweep 1,4,..  batch sizes to try (default 1 only)
+// Operation:
+//   Hubs are probed one after the other so they do not disturb each
+//   other. Per hub and batch size it prints the ACK, echo and take
+//   latency distributions and routes per second (batch / mean take).
+//   With a sweep the batch size with the most routes per second is
+//   recommended for the hub's model. Afterwards the routing found at
+//   the start is restored as one salvo.
+// Return:   process exit code (1 = bad arguments or no hub reachable)
+// -----------------------------------------------------------
+int RunLatencyProbe(const std::vector<std::string>& args) {
+    std::vector<std::pair<std::string, int>> hubs;
+    std::vector<int> batches{ 1 };
+    int takes = 200, gapMs = 20;
+    bool ok = true;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            auto value = [&]() -> std::string {
+                if (a + 1 >= args.size()) throw std::invalid_argument(args[a]);
+                return args[++a];
+            };
+            std::string host;
+            int port = 9990;
+            if (args[a] == "--takes") takes = std::stoi(value());
+            else if (args[a] == "--gap") gapMs = std::stoi(value());
+            else if (args[a] == "--batch-sweep") {
+                batches.clear();
+                std::istringstream iss(value());
+                std::string v;
+                while (std::getline(iss, v, ',')) batches.push_back(std::stoi(v));
+            }
+            else if (SplitHubAddress(args[a], host, port)) hubs.push_back({ host, port });
+            else ok = false;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    if (!ok || hubs.empty() || batches.empty() || takes < 1 || gapMs < 0 ||
+        std::any_of(batches.begin(), batches.end(), [](int v) { return v < 1; })) {
+        std::cerr << "Usage: VideoHubHL --probe-latency host[:port] [host[:port] ...] [--takes N] [--gap MS]"
+            << " [--batch-sweep 1,2,4,...]\n";
+        return 1;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+    int reached = 0;
+    for (auto& h : hubs) {
+        HubSession s;
+        s.ip = h.first;
+        s.port = h.second;
+        std::cout << "\nHub " << h.first << ":" << h.second;
+        if (!OpenHubSession(s) || s.mirror.routing.empty() || s.mirror.inputLabels.size() < 2) {
+            std::cout << ": cannot connect or no usable routing.\n";
+            CloseHubSession(s);
+            continue;
+        }
+        ++reached;
+        VideoHubState original;   // routing to put back after the sweep
+        original.routing = s.mirror.routing;
+        std::string model = s.device.count("Model name") ? s.device["Model name"] : "unknown model";
+        std::cout << " (" << model << ", " << s.mirror.inputLabels.size() << "x" << s.mirror.routing.size()
+            << "), " << takes << " takes per batch size\n";
+        std::cout << std::left << std::setw(7) << "Batch" << std::setw(17) << "ACK p50/p99" << std::setw(17)
+            << "Echo p50/p99" << std::setw(17) << "Take p50/p99" << std::setw(10) << "Take max"
+            << std::setw(6) << "NAK" << std::setw(9) << "Timeout" << "Routes/s\n";
+        std::cout << std::string(92, '-') << "\n";
+
+        int bestBatch = 0;
+        double bestRate = 0;
+        for (int batch : batches) {
+            TakeProbeStats st = RunTakeProbe(s, batch, takes, gapMs);
+            double mean = 0;
+            for (double v : st.take) mean += v;
+            mean = st.take.empty() ? 0 : mean / st.take.size();
+            double rate = mean > 0 ? st.batch * 1000.0 / mean : 0;
+            std::vector<double> take = st.take;
+            double maxTake = take.empty() ? 0 : *std::max_element(take.begin(), take.end());
+            std::ostringstream maxText, rateText;
+            maxText << std::fixed << std::setprecision(2) << maxTake;
+            rateText << std::fixed << std::setprecision(0) << rate;
+            std::cout << std::left << std::setw(7) << st.batch << std::setw(17) << FormatLatency(st.ack)
+                << std::setw(17) << FormatLatency(st.echo) << std::setw(17) << FormatLatency(st.take)
+                << std::setw(10) << maxText.str() << std::setw(6) << st.naks << std::setw(9) << st.timeouts
+                << rateText.str() << "\n";
+            if (rate > bestRate && st.timeouts == 0) {
+                bestRate = rate;
+                bestBatch = st.batch;
+            }
+            if (!s.connected()) {
+                std::cout << "Connection lost.\n";
+                break;
+            }
+        }
+        if (batches.size() > 1 && bestBatch)
+            std::cout << "Best batch size for " << model << ": " << bestBatch << " (" << std::fixed
+            << std::setprecision(0) << bestRate << " routes/s)\n";
+
+        // restore the routing found before the sweep (one salvo of the routes that changed)
+        bool settled = s.connected() ? DrainHubAnswers(s, 2000) : OpenHubSession(s);
+        SalvoResult restore;
+        if (settled) restore = ApplySalvoOnSession(s, original);
+        if (settled && restore.applied)
+            std::cout << "Routing restored (" << (restore.levels.empty() ? 0 : restore.levels[0].routes.size())
+            << " routes).\n";
+        else
+            std::cout << "!!! Could not restore the original routing of " << h.first << ":" << h.second << ".\n";
+        CloseHubSession(s);
+    }
+    WSACleanup();
+    return reached ? 0 : 1;
+}
+
+// --------------------- Benchmark suite / regression gate ---------------------
+// Command line mode "--bench": measures the hot paths, writes the results
+// as JSON and compares them with a stored baseline. Every metric has a
+// tolerance (fraction); a metric worse than baseline by more than its
+// tolerance is a regression and the exit code is 1, so a release build
+// can be gated on it. Hub metrics (fetch, apply) are only measured when
+// a hub address is given - use VideoHubSim, apply changes the routing
+// (the original routing is restored afterwards). A baseline metric that
+// was not measured (no hub given) fails the gate as well, unless
+// --allow-skipped says that is intended.
+//
+// File layout (results and baseline are the same format; a results file
+// can be promoted to baseline with --save-baseline):
+//   { "version": "v1.0", "timestamp": "...", "hub": "127.0.0.1:9990",
+//     "metrics": { "parse_mb_s": { "value": 55.1, "unit": "MB/s",
+//                  "higherIsBetter": true, "tolerance": 0.15 }, ... } }
+
+// Brief comment: one measured value of the benchmark suite
+struct BenchMetric {
+    std::string name;
+    std::string unit;
+    double value = 0;
+    bool higherIsBetter = true;
+    double tolerance = 0.15;  // allowed relative deviation in the bad direction
+};
+
+// Brief comment: median duration (ms) of `runs` calls of fn
+double MedianMs(int runs, const std::function<void()>& fn) {
+    std::vector<double> t;
+    for (int i = 0; i < runs; ++i) {
+        auto t0 = Clock::now();
+        fn();
+        t.push_back(ElapsedMs(t0, Clock::now()));
+    }
+    return Percentile(t, 50);
+}
+
+// Brief comment: allocations made by one call of fn
+double AllocationsOf(const std::function<void()>& fn) {
+    unsigned long long before = gAllocCount.load(std::memory_order_relaxed);
+    fn();
+    return static_cast<double>(gAllocCount.load(std::memory_order_relaxed) - before);
+}
+
+// Brief comment: writes metrics in the results/baseline format
+bool SaveBenchResults(const std::string& filename, const std::string& hub, const std::vector<BenchMetric>& metrics) {
+    std::ofstream file(filename);
+    if (!file.is_open()) return false;
+    file << "{\n  \"version\": \"" << escapeJson(version) << "\",\n"
+        << "  \"timestamp\": \"" << CurrentTimestamp() << "\",\n"
+        << "  \"hub\": \"" << escapeJson(hub) << "\",\n"
+        << "  \"metrics\": {\n";
+    for (size_t i = 0; i < metrics.size(); ++i) {
+        auto& m = metrics[i];
+        file << "    \"" << m.name << "\": { \"value\": " << std::setprecision(6) << m.value
+            << ", \"unit\": \"" << m.unit << "\", \"higherIsBetter\": " << (m.higherIsBetter ? "true" : "false")
+            << ", \"tolerance\": " << m.tolerance << " }" << (i + 1 < metrics.size() ? "," : "") << "\n";
+    }
+    file << "  }\n}\n";
+    return true;
+}
+
+// Brief comment: reads metrics from a results/baseline file
+bool LoadBenchResults(const std::string& filename, std::vector<BenchMetric>& metrics) {
+    JsonValue root;
+    if (!fs::exists(filename) || !LoadJsonFile(filename, root)) return false;
+    const JsonValue* list = root.get("metrics");
+    if (!list) return false;
+    for (auto& kv : list->members) {
+        BenchMetric m;
+        m.name = kv.first;
+        if (auto* v = kv.second.get("value")) m.value = v->asNumber();
+        if (auto* v = kv.second.get("unit")) m.unit = v->asString();
+        if (auto* v = kv.second.get("higherIsBetter")) m.higherIsBetter = v->asBool(true);
+        if (auto* v = kv.second.get("tolerance")) m.tolerance = v->asNumber(m.tolerance);
+        metrics.push_back(m);
+    }
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: MeasureOfflineMetrics
+// Purpose:  Parser and compare metrics (no hub needed).
+//   parse_mb_s               HubBlockReader + mirror on a 288x288 stream in 1460 B segments
+//   parse_allocs_per_block   heap allocations per parsed block
+//   compare_per_s            CompareRouting of two 288x288 states per second
+//   compare_allocs_per_op    heap allocations per comparison
+// -----------------------------------------------------------
+void MeasureOfflineMetrics(std::vector<BenchMetric>& metrics) {
+    const int blocks = 20000;
+    ParseBenchStream st = BuildParseBenchStream(288, blocks);
+    auto segment = []() { return size_t(1460); };
+    RunParsePass(st, segment);  // warm up
+    double ms = MedianMs(7, [&]() { RunParsePass(st, segment); });
+    metrics.push_back({ "parse_mb_s", "MB/s", st.bytes.size() / (1024.0 * 1024.0) / (ms / 1000.0), true, 0.15 });
+    double allocs = AllocationsOf([&]() { RunParsePass(st, segment); });
+    metrics.push_back({ "parse_allocs_per_block", "allocs", allocs / (blocks + 8), false, 0.10 });
+
+    VideoHubState preset, hub;
+    for (int o = 0; o < 288; ++o) {
+        preset.routing[o] = o;
+        hub.routing[o] = (o % 10 == 0) ? (o + 1) % 288 : o;
+    }
+    size_t diffs = 0;
+    const int ops = 2000;
+    ms = MedianMs(5, [&]() {
+        for (int i = 0; i < ops; ++i)
+            for (auto& c : CompareRouting(preset.routing, hub.routing)) diffs += c.differs();
+    });
+    metrics.push_back({ "compare_per_s", "ops/s", ops / (ms / 1000.0), true, 0.15 });
+    allocs = AllocationsOf([&]() { diffs += CompareRouting(preset.routing, hub.routing).size(); });
+    metrics.push_back({ "compare_allocs_per_op", "allocs", allocs, false, 0.10 });
+}
+
+// -----------------------------------------------------------
+// Function: MeasureHubMetrics
+// Purpose:  Fetch and apply metrics against a (simulated) hub.
+//   fetch_ms   median FetchHubState (connect + full prelude)
+//   apply_ms   median time to take a preset touching every output as
+//              one salvo, confirmed by ACK (ApplySalvoOnSession, the
+//              path of the apply menu); after one untimed warm-up run
+// Return:    false when the hub cannot be reached
+// -----------------------------------------------------------
+bool MeasureHubMetrics(const std::string& host, int port, std::vector<BenchMetric>& metrics) {
+    VideoHubState state;
+    std::string prelude;
+    if (!FetchHubState(host, port, state, prelude) || state.routing.empty()) return false;
+
+    bool ok = true;
+    double ms = MedianMs(21, [&]() { ok = FetchHubState(host, port, state, prelude) && ok; });
+    if (!ok) return false;
+    metrics.push_back({ "fetch_ms", "ms", ms, false, 0.30 });
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return false;
+    HubSession s;
+    s.ip = host;
+    s.port = port;
+    if (!OpenHubSession(s)) {
+        WSACleanup();
+        return false;
+    }
+    VideoHubState original;
+    original.routing = s.mirror.routing;
+    int inputs = std::max<int>(1, static_cast<int>(s.mirror.inputLabels.size()));
+    std::vector<VideoHubState> presets(2);
+    for (auto& r : original.routing) {
+        presets[0].routing[r.first] = (r.second + 1) % inputs;
+        presets[1].routing[r.first] = r.second;
+    }
+    // the salvo does not touch the mirror and the echo stays unread: record the
+    // acknowledged routes, otherwise every other run finds nothing to send
+    auto take = [&s](const VideoHubState& target) {
+        SalvoResult r = ApplySalvoOnSession(s, target);
+        if (r.applied)
+            for (auto& sl : r.levels)
+                for (auto& kv : sl.routes) (s.mirror.*sl.level->routing)[kv.first] = kv.second;
+        return r.applied && !r.levels.empty();
+    };
+    int run = 0;
+    ok = take(presets[run++ % 2]);  // warm up (untimed)
+    ms = MedianMs(5, [&]() { ok = take(presets[run++ % 2]) && ok; });
+    take(original);
+    CloseHubSession(s);
+    WSACleanup();
+    if (!ok) return false;
+    metrics.push_back({ "apply_ms", "ms", ms, false, 0.30 });
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: RunBenchmarkSuite
+// Purpose:  Command line mode "--bench [host[:port]] [--out FILE]
+//           [--baseline FILE] [--save-baseline] [--allow-skipped]".
+// Operation:
+//   1. Measures the offline metrics and, with a hub, fetch/apply
+//   2. Writes the results (default bench_results.json)
+//   3. With --save-baseline the results become the new baseline;
+//      otherwise each baseline metric is compared with its result,
+//      using the tolerance stored in the baseline; a baseline metric
+//      without result is "missing" (a failure) or, with
+//      --allow-skipped, "skipped"
+// Return:   0 = no regression (or no baseline yet), 1 = regression,
+//           missing metric or error
+// -----------------------------------------------------------
+int RunBenchmarkSuite(const std::vector<std::string>& args) {
+    std::string host, outFile = "bench_results.json", baselineFile = "bench_baseline.json";
+    int port = 9990;
+    bool saveBaseline = false, allowSkipped = false, ok = true;
+    for (size_t a = 0; a < args.size(); ++a) {
+        if (args[a] == "--out" && a + 1 < args.size()) outFile = args[++a];
+        else if (args[a] == "--baseline" && a + 1 < args.size()) baselineFile = args[++a];
+        else if (args[a] == "--save-baseline") saveBaseline = true;
+        else if (args[a] == "--allow-skipped") allowSkipped = true;
+        else if (host.empty() && SplitHubAddress(args[a], host, port)) {}
+        else ok = false;
+    }
+    if (!ok) {
+        std::cerr << "Usage: VideoHubHL --bench [host[:port]] [--out FILE] [--baseline FILE] [--save-baseline]"
+            " [--allow-skipped]\n";
+        return 1;
+    }
+
+    std::vector<BenchMetric> results;
+    std::cout << "Measuring parser and compare...\n";
+    MeasureOfflineMetrics(results);
+    std::string hubText = host.empty() ? "" : host + ":" + std::to_string(port);
+    if (!host.empty()) {
+        std::cout << "Measuring fetch and apply on " << hubText << "...\n";
+        if (!MeasureHubMetrics(host, port, results)) {
+            std::cerr << "Error: hub " << hubText << " not reachable or did not answer.\n";
+            return 1;
+        }
+    }
+
+    if (!SaveBenchResults(outFile, hubText, results)) {
+        std::cerr << "Error: cannot write " << outFile << "\n";
+        return 1;
+    }
+    std::cout << "Results written to " << outFile << "\n";
+    if (saveBaseline) {
+        if (!SaveBenchResults(baselineFile, hubText, results)) {
+            std::cerr << "Error: cannot write " << baselineFile << "\n";
+            return 1;
+        }
+        std::cout << "Baseline saved to " << baselineFile << "\n";
+    }
+
+    std::vector<BenchMetric> baseline;
+    bool haveBaseline = !saveBaseline && LoadBenchResults(baselineFile, baseline);
+    if (!saveBaseline && !haveBaseline)
+        std::cout << "No baseline (" << baselineFile << "); run with --save-baseline to create one.\n";
+
+    std::cout << "\n" << std::left << std::setw(26) << "Metric" << std::right << std::setw(14) << "Baseline"
+        << std::setw(14) << "Result" << std::setw(10) << "Change" << std::setw(8) << "Tol" << "  Status\n";
+    std::cout << std::string(80, '-') << "\n";
+    int regressions = 0;
+    auto number = [](const BenchMetric* m) {
+        if (!m) return std::string("-");
+        std::ostringstream o;
+        o << std::fixed << std::setprecision(3) << m->value;
+        return o.str();
+    };
+    auto row = [&number](const BenchMetric* base, const BenchMetric* res, const std::string& name, const std::string& status) {
+        std::ostringstream line;
+        line << std::fixed << std::left << std::setw(26) << name << std::right
+            << std::setw(14) << number(base) << std::setw(14) << number(res);
+        if (base && res && base->value != 0)
+            line << std::setw(9) << std::setprecision(2) << std::showpos << (res->value / base->value - 1.0) * 100.0
+            << std::noshowpos << "%";
+        else
+            line << std::setw(10) << "-";
+        line << std::setw(7) << std::setprecision(0) << (base ? base->tolerance : res->tolerance) * 100.0 << "%  " << status;
+        std::cout << line.str() << "\n";
+    };
+    for (auto& r : results) {
+        const BenchMetric* base = nullptr;
+        for (auto& b : baseline)
+            if (b.name == r.name) base = &b;
+        std::string status = "new";
+        if (base) {
+            bool worse = base->higherIsBetter ? r.value < base->value * (1.0 - base->tolerance)
+                : r.value > base->value * (1.0 + base->tolerance);
+            status = worse ? "REGRESSION" : "ok";
+            if (worse) ++regressions;
+        }
+        row(base, &r, r.name, saveBaseline ? "baseline" : status);
+    }
+    int missing = 0;
+    for (auto& b : baseline) {
+        bool measured = std::any_of(results.begin(), results.end(), [&b](const BenchMetric& r) { return r.name == b.name; });
+        if (measured) continue;
+        row(&b, nullptr, b.name, allowSkipped ? "skipped" : "MISSING");
+        if (!allowSkipped) ++missing;
+    }
+
+    if (regressions) std::cout << "\n" << regressions << " metric(s) regressed beyond tolerance.\n";
+    if (missing)
+        std::cout << (regressions ? "" : "\n") << missing << " baseline metric(s) not measured"
+            << (host.empty() ? " (no hub given)" : "") << "; pass --allow-skipped if intended.\n";
+    if (!regressions && !missing && haveBaseline) std::cout << "\nNo regressions.\n";
+    return regressions || missing ? 1 : 0;
+}
+
+// --------------------- Status watch ---------------------
+// Command line mode "--watch": keeps sessions to one or more hubs open,
+// polls their configuration and alarms and prints every change as one
+// JSON line on stdout, as an event feed for scripts and monitoring.
+// Nothing is printed while nothing changes.
+
+// Brief comment: prints one event of a hub as a JSON line
+void PrintHubEventJson(const HubSession& s, const HubEvent& e) {
+    std::cout << "{ \"time\": \"" << CurrentTimestamp() << "\", \"hub\": \"" << escapeJson(s.ip) << ":" << s.port
+        << "\", \"kind\": \"" << e.kind << "\", \"key\": \"" << escapeJson(e.key)
+        << "\", \"previous\": \"" << escapeJson(e.previous) << "\", \"value\": \"" << escapeJson(e.value) << "\" }"
+        << std::endl;
+}
+
+// -----------------------------------------------------------
+// Function: RunStatusWatch
+// Purpose:  Command line mode "--watch host[:port] ... [--poll MS] [--duration S]".
+// Operation:
+//   1. Opens a session per hub; lost hubs are reconnected every 2 s
+//      (connection changes are events of kind "connection")
+//   2. Every poll interval asks each hub for CONFIGURATION and, when the
+//      model reported it in its prelude, ALARM STATUS (PollHubStatus)
+//   3. Answers and pushed blocks go through the normal mirror update;
+//      TrackStatusBlock queues an event per changed value
+//   4. Queued events are printed as JSON lines
+//   Runs until a key is pressed or the duration has passed.
+// -----------------------------------------------------------
+int RunStatusWatch(const std::vector<std::string>& args) {
+    std::vector<std::pair<std::string, int>> hubs;
+    int pollMs = 1000, durationS = 0;
+    bool ok = true;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            auto value = [&]() -> std::string {
+                if (a + 1 >= args.size()) throw std::invalid_argument(args[a]);
+                return args[++a];
+            };
+            std::string host;
+            int port = 9990;
+            if (args[a] == "--poll") pollMs = std::stoi(value());
+            else if (args[a] == "--duration") durationS = std::stoi(value());
+            else if (SplitHubAddress(args[a], host, port)) hubs.push_back({ host, port });
+            else ok = false;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    if (!ok || hubs.empty() || pollMs < 10 || durationS < 0) {
+        std::cerr << "Usage: VideoHubHL --watch host[:port] [host[:port] ...] [--poll MS] [--duration S]\n";
+        return 1;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+
+    std::vector<HubSession> sessions(hubs.size());
+    std::vector<HubSession*> ptrs;
+    std::vector<Clock::time_point> reconnectAt(hubs.size(), Clock::now());
+    std::vector<bool> wasUp(hubs.size(), false);
+    for (size_t i = 0; i < hubs.size(); ++i) {
+        sessions[i].ip = hubs[i].first;
+        sessions[i].port = hubs[i].second;
+        ptrs.push_back(&sessions[i]);
+        gResolver.prefetch(hubs[i].first);
+    }
+
+    std::cerr << "Watching " << hubs.size() << " hub(s), poll every " << pollMs << " ms. Press any key to stop.\n";
+    auto end = Clock::now() + std::chrono::seconds(durationS);
+    auto nextPoll = Clock::now();
+    HubBlock b;
+    while (!(durationS > 0 && Clock::now() >= end)) {
+        if (_kbhit()) {
+            _getch();
+            break;
+        }
+        auto now = Clock::now();
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            HubSession& s = sessions[i];
+            if (!s.connected() && now >= reconnectAt[i] && gResolver.ready(s.ip)) {
+                reconnectAt[i] = now + std::chrono::milliseconds(2000);
+                if (OpenHubSession(s, 1500)) {
+                    s.events.push_back({ now, "connection", "state", wasUp[i] ? "up" : "", "up" });
+                    wasUp[i] = true;
+                }
+            }
+        }
+        if (now >= nextPoll) {
+            nextPoll = now + std::chrono::milliseconds(pollMs);
+            for (auto& s : sessions)
+                if (s.connected()) PollHubStatus(s);
+        }
+
+        WaitForSessions(ptrs, 50);
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            HubSession& s = sessions[i];
+            while (s.reader.next(b)) {
+                Clock::time_point stamp;
+                bool acked;
+                if (!PopHubAck(s, b, stamp, acked)) ApplyBlockToMirror(s, b);
+            }
+            if (wasUp[i] && !s.connected()) {
+                wasUp[i] = false;
+                s.events.push_back({ Clock::now(), "connection", "state", "up", "down" });
+            }
+            for (auto& e : s.events) PrintHubEventJson(s, e);
+            s.events.clear();
+        }
+    }
+
+    for (auto& s : sessions) CloseHubSession(s);
+    WSACleanup();
+    return 0;
+}
+
+// --------------------- Shared-memory export ---------------------
+// Command line mode "--publish": keeps a session to one hub and copies
+// its live mirror into a named shared memory segment (layout and seqlock
+// in VideoHubShm.h) on every change, so local programs read the current
+// routing and labels without their own hub connection.
+
+// Brief comment: the mapped segment of a publisher
+struct ShmPublisher {
+    HANDLE writer = NULL;    // named mutex "<segment>.publisher": exists while a publisher runs
+    HANDLE mapping = NULL;
+    VhShmLayout* shm = nullptr;
+};
+
+// Brief comment: unmaps the segment (it disappears when the last reader closes it too)
+void CloseShmPublisher(ShmPublisher& p) {
+    if (p.shm) UnmapViewOfFile(p.shm);
+    if (p.mapping) CloseHandle(p.mapping);
+    if (p.writer) CloseHandle(p.writer);
+    p = ShmPublisher{};
+}
+
+// -----------------------------------------------------------
+// Function: OpenShmPublisher
+// Purpose:  Creates (or opens) the named segment and initialises the header.
+// Operation:
+//   - the seqlock allows one writer only: a named mutex marks the running
+//     publisher, a second one is refused (the system drops the mutex when
+//     the process ends, also after a crash)
+//   - the segment itself may still exist, kept by readers of a publisher
+//     that ended; a crash there can have left 'sequence' odd mid-write.
+//     The first update therefore only makes it odd when it is even, so a
+//     torn state never becomes readable
+// Return:   false when another publisher runs or the segment cannot be mapped
+// -----------------------------------------------------------
+bool OpenShmPublisher(ShmPublisher& p, const std::string& name) {
+    p.writer = CreateMutexA(NULL, FALSE, (name + ".publisher").c_str());
+    if (p.writer == NULL || GetLastError() == ERROR_ALREADY_EXISTS) {
+        if (p.writer) CloseHandle(p.writer);
+        p.writer = NULL;
+        return false;
+    }
+    p.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0,
+        static_cast<DWORD>(sizeof(VhShmLayout)), name.c_str());
+    if (p.mapping == NULL) {
+        CloseShmPublisher(p);
+        return false;
+    }
+    p.shm = static_cast<VhShmLayout*>(MapViewOfFile(p.mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(VhShmLayout)));
+    if (!p.shm) {
+        CloseShmPublisher(p);
+        return false;
+    }
+    // odd: a crashed publisher stopped mid-write; it stays odd until the state below is rewritten
+    if (p.shm->sequence.load(std::memory_order_relaxed) % 2 == 0) VhShmBeginWrite(p.shm);
+    std::memset(&p.shm->state, 0, sizeof(VhShmState));
+    p.shm->magic = kVhShmMagic;
+    p.shm->layoutVersion = kVhShmLayoutVersion;
+    p.shm->stateBytes = sizeof(VhShmState);
+    VhShmEndWrite(p.shm);
+    return true;
+}
+
+// Brief comment: copies a label into a fixed, zero-terminated slot (cut at the slot size)
+void CopyShmLabel(char* slot, const std::string& label) {
+    std::string text = LabelForProtocol(label);
+    size_t n = std::min(text.size(), static_cast<size_t>(kVhShmLabelBytes - 1));
+    std::memcpy(slot, text.data(), n);
+    std::memset(slot + n, 0, kVhShmLabelBytes - n);
+}
+
+// -----------------------------------------------------------
+// Function: PublishHubState
+// Purpose:  Writes the mirror of a session into the segment as one
+//           seqlock update and increments the version.
+// Notes:    Port counts come from VIDEOHUB DEVICE where present, else
+//           from the mirror; unknown routes are kVhShmNoRoute.
+// -----------------------------------------------------------
+void PublishHubState(ShmPublisher& p, const HubSession& s) {
+    if (!p.shm) return;
+    VhShmState& st = p.shm->state;
+    const VideoHubState& m = s.mirror;
+    auto count = [&s](const char* key, size_t fallback) {
+        auto it = s.device.find(key);
+        int n = static_cast<int>(fallback);
+        if (it != s.device.end()) {
+            try { n = std::stoi(it->second); } catch (...) {}
+        }
+        return static_cast<uint32_t>(std::max(0, std::min(n, kVhShmMaxPorts)));
+    };
+    auto copyRouting = [](uint16_t* dst, const std::map<int, int>& routing) {
+        std::fill(dst, dst + kVhShmMaxPorts, kVhShmNoRoute);
+        for (auto& kv : routing)
+            if (kv.first >= 0 && kv.first < kVhShmMaxPorts && kv.second >= 0 && kv.second < kVhShmNoRoute)
+                dst[kv.first] = static_cast<uint16_t>(kv.second);
+    };
+    auto copyLabels = [](char (*dst)[kVhShmLabelBytes], const std::map<int, std::string>& labels) {
+        std::memset(dst, 0, sizeof(char) * kVhShmMaxPorts * kVhShmLabelBytes);
+        for (auto& kv : labels)
+            if (kv.first >= 0 && kv.first < kVhShmMaxPorts) CopyShmLabel(dst[kv.first], kv.second);
+    };
+    std::string hub = s.ip + ":" + std::to_string(s.port);
+    auto model = s.device.find("Model name");
+
+    VhShmBeginWrite(p.shm);
+    ++st.version;
+    st.updatedUnixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    st.connected = s.connected() ? 1 : 0;
+    st.inputs = count("Video inputs", m.inputLabels.size());
+    st.outputs = count("Video outputs", m.routing.size());
+    st.monitorOutputs = count("Video monitoring outputs", m.monitorRouting.size());
+    st.serialPorts = count("Serial ports", m.serialRouting.size());
+    std::snprintf(st.hub, sizeof(st.hub), "%s", hub.c_str());
+    std::snprintf(st.model, sizeof(st.model), "%s", model != s.device.end() ? model->second.c_str() : "");
+    copyRouting(st.routing, m.routing);
+    copyRouting(st.monitorRouting, m.monitorRouting);
+    copyRouting(st.serialRouting, m.serialRouting);
+    copyLabels(st.inputLabels, m.inputLabels);
+    copyLabels(st.outputLabels, m.outputLabels);
+    copyLabels(st.monitorLabels, m.monitorLabels);
+    copyLabels(st.serialLabels, m.serialLabels);
+    VhShmEndWrite(p.shm);
+}
+
+// -----------------------------------------------------------
+// Function: RunShmPublish
+// Purpose:  Command line mode "--publish host[:port] [--name NAME] [--duration S]".
+// Operation:
+//   1. Creates the segment (default name kVhShmDefaultName)
+//   2. Opens a session to the hub (retried every 2 s) and publishes
+//      its prelude state
+//   3. Publishes again after every wakeup in which the hub pushed a
+//      change; a lost connection is published as connected = 0 with
+//      the last-known state left in place
+//   Runs until a key is pressed or the duration has passed.
+// -----------------------------------------------------------
+int RunShmPublish(const std::vector<std::string>& args) {
+    std::string host, name = kVhShmDefaultName;
+    int port = 9990, durationS = 0;
+    bool ok = true;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            auto value = [&]() -> std::string {
+                if (a + 1 >= args.size()) throw std::invalid_argument(args[a]);
+                return args[++a];
+            };
+            if (args[a] == "--name") name = value();
+            else if (args[a] == "--duration") durationS = std::stoi(value());
+            else if (host.empty() && SplitHubAddress(args[a], host, port)) {}
+            else ok = false;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    if (!ok || host.empty() || name.empty() || durationS < 0) {
+        std::cerr << "Usage: VideoHubHL --publish host[:port] [--name NAME] [--duration S]\n";
+        return 1;
+    }
+
+    ShmPublisher pub;
+    if (!OpenShmPublisher(pub, name)) {
+        std::cerr << "Cannot create shared memory '" << name << "' (is another --publish running?).\n";
+        return 1;
+    }
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        CloseShmPublisher(pub);
+        return 1;
+    }
+
+    HubSession s;
+    s.ip = host;
+    s.port = port;
+    std::cout << "Publishing " << host << ":" << port << " to shared memory '" << name << "' ("
+        << sizeof(VhShmLayout) << " bytes). Press any key to stop.\n";
+    auto end = Clock::now() + std::chrono::seconds(durationS);
+    auto reconnectAt = Clock::now();
+    bool wasUp = false;
+    HubBlock b;
+    while (!(durationS > 0 && Clock::now() >= end)) {
+        if (_kbhit()) {
+            _getch();
+            break;
+        }
+        if (!s.connected() && Clock::now() >= reconnectAt) {
+            reconnectAt = Clock::now() + std::chrono::milliseconds(2000);
+            if (OpenHubSession(s, 1500)) {
+                wasUp = true;
+                PublishHubState(pub, s);
+                std::cout << "Connected, " << s.mirror.routing.size() << " outputs published.\n";
+            }
+        }
+
+        WaitForSessions({ &s }, 50);
+        bool changed = false;
+        while (s.reader.next(b)) {
+            Clock::time_point stamp;
+            bool acked;
+            if (PopHubAck(s, b, stamp, acked)) continue;
+            ApplyBlockToMirror(s, b);
+            changed = true;
+        }
+        if (wasUp && !s.connected()) {
+            wasUp = false;
+            changed = true;
+            std::cout << "Hub lost; last-known state stays published.\n";
+        }
+        if (changed) PublishHubState(pub, s);
+    }
+
+    CloseHubSession(s);
+    PublishHubState(pub, s);
+    WSACleanup();
+    CloseShmPublisher(pub);
+    return 0;
+}
+
+// -----------------------------------------------------------
+// Function: RunShmDump
+// Purpose:  Command line mode "--shm-dump [--name NAME]": reads the
+//           segment once like any local consumer and prints it.
+// -----------------------------------------------------------
+int RunShmDump(const std::vector<std::string>& args) {
+    std::string name = kVhShmDefaultName;
+    if (args.size() == 2 && args[0] == "--name") name = args[1];
+    else if (!args.empty()) {
+        std::cerr << "Usage: VideoHubHL --shm-dump [--name NAME]\n";
+        return 1;
+    }
+
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+    const VhShmLayout* shm = mapping ?
+        static_cast<const VhShmLayout*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(VhShmLayout))) : nullptr;
+    auto state = std::make_unique<VhShmState>();
+    bool read = shm && VhShmRead(shm, *state);
+    if (shm) UnmapViewOfFile(shm);
+    if (mapping) CloseHandle(mapping);
+    if (!read) {
+        std::cerr << "No published hub state in '" << name << "'.\n";
+        return 1;
+    }
+
+    const VhShmState& st = *state;
+    std::cout << "Hub " << st.hub << " (" << st.model << ")" << (st.connected ? "" : " [DISCONNECTED]")
+        << ", version " << st.version << ", " << st.inputs << "x" << st.outputs
+        << ", monitoring " << st.monitorOutputs << ", serial " << st.serialPorts << "\n";
+    auto dump = [](const char* title, uint32_t count, const uint16_t* routing,
+        const char (*outLabels)[kVhShmLabelBytes], const char (*srcLabels)[kVhShmLabelBytes]) {
+        if (count == 0) return;
+        std::cout << title << ":\n";
+        for (uint32_t o = 0; o < count; ++o) {
+            std::cout << "  " << std::left << std::setw(5) << (o + 1) << std::setw(22) << outLabels[o] << "<- ";
+            if (routing[o] == kVhShmNoRoute) std::cout << "-\n";
+            else std::cout << (routing[o] + 1) << " " << (routing[o] < kVhShmMaxPorts ? srcLabels[routing[o]] : "") << "\n";
+        }
+    };
+    dump("Video routing", st.outputs, st.routing, st.outputLabels, st.inputLabels);
+    dump("Monitoring routing", st.monitorOutputs, st.monitorRouting, st.monitorLabels, st.inputLabels);
+    dump("Serial routing", st.serialPorts, st.serialRouting, st.serialLabels, st.serialLabels);
+    return 0;
+}
+
+// --------------------- TSL UMD output ---------------------
+// Command line mode "--tsl": keeps a session to one hub and drives the
+// under-monitor displays (UMD) of multiviewers over UDP with the TSL
+// protocol (v3.1 or v5.0). Each hub output is one display: its text is
+// the label of the source routed to it, its tally is red when that
+// source is also routed to one of the --program outputs, green for the
+// --preview outputs. Only displays whose text or tally changed are sent,
+// at most once per --interval.
+
+// Brief comment: what one UMD display shows
+struct UmdDisplay {
+    std::string text;
+    int tally = 0;   // 0 = off, 1 = program (red), 2 = preview (green)
+
+    bool operator==(const UmdDisplay& o) const { return tally == o.tally && text == o.text; }
+    bool operator!=(const UmdDisplay& o) const { return !(*this == o); }
+};
+
+// Brief comment: settings of the TSL sender
+struct TslOptions {
+    std::string hubHost;
+    int hubPort = 9990;
+    std::string destHost;
+    int destPort = 8900;
+    int version = 5;                // 3 = TSL 3.1, 5 = TSL 5.0
+    int screen = 0;                 // TSL 5 screen index
+    int indexOffset = 0;            // display index of output 1
+    bool outputText = false;        // show the output label instead of the source label
+    std::set<int> outputs;          // outputs with a display (0-based), empty = all
+    std::set<int> program;          // outputs that put their source on air
+    std::set<int> preview;          // outputs that put their source on preview
+    int intervalMs = 100;           // minimum time between two sends
+    int durationS = 0;
+};
+
+// Brief comment: parses a 1-based list like "1-16,20" into 0-based numbers
+bool ParsePortList(const std::string& spec, std::set<int>& out) {
+    std::istringstream iss(spec);
+    std::string part;
+    while (std::getline(iss, part, ',')) {
+        size_t dash = part.find('-');
+        int first = std::stoi(part.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+        if (first < 1 || last < first || last > 4096) return false;
+        for (int n = first; n <= last; ++n) out.insert(n - 1);
+    }
+    return !out.empty();
+}
+
+// -----------------------------------------------------------
+// Function: BuildUmdDisplays
+// Purpose:  Derives the text and tally of every display from the mirror.
+// Operation:
+//   - a reverse index source -> tally is built from the program and
+//     preview outputs first (program wins), so each display is one
+//     lookup instead of a search over all outputs
+//   - outputs without a known route show an empty text and no tally
+// Return:   display per output (0-based)
+// -----------------------------------------------------------
+std::map<int, UmdDisplay> BuildUmdDisplays(const VideoHubState& m, const TslOptions& opt) {
+    std::map<int, int> sourceTally;
+    for (int o : opt.preview) {
+        auto it = m.routing.find(o);
+        if (it != m.routing.end()) sourceTally[it->second] = 2;
+    }
+    for (int o : opt.program) {
+        auto it = m.routing.find(o);
+        if (it != m.routing.end()) sourceTally[it->second] = 1;
+    }
+
+    std::map<int, UmdDisplay> displays;
+    auto add = [&](int output) {
+        UmdDisplay& d = displays[output];
+        auto route = m.routing.find(output);
+        if (opt.outputText) {
+            auto label = m.outputLabels.find(output);
+            if (label != m.outputLabels.end()) d.text = LabelForProtocol(label->second);
+        }
+        if (route == m.routing.end()) return;
+        if (!opt.outputText) {
+            auto label = m.inputLabels.find(route->second);
+            if (label != m.inputLabels.end()) d.text = LabelForProtocol(label->second);
+        }
+        auto t = sourceTally.find(route->second);
+        if (t != sourceTally.end()) d.tally = t->second;
+    };
+    if (opt.outputs.empty())
+        for (auto& kv : m.routing) add(kv.first);
+    else
+        for (int o : opt.outputs) add(o);
+    return displays;
+}
+
+// Brief comment: appends one TSL 3.1 display message (18 bytes: address, control, 16 characters)
+void AppendTsl31Message(std::string& out, int address, const UmdDisplay& d) {
+    out += static_cast<char>(0x80 + address);
+    // tally 1 = program, tally 2 = preview, brightness 3 (bits 4-5)
+    out += static_cast<char>((d.tally == 1 ? 0x01 : 0) | (d.tally == 2 ? 0x02 : 0) | 0x30);
+    std::string text;
+    for (unsigned char c : d.text) {
+        if (text.size() == 16) break;
+        if (c >= 0x80 && c < 0xC0) continue;        // UTF-8 continuation: one '?' per character
+        text += (c >= 0x20 && c < 0x7F) ? static_cast<char>(c) : '?';
+    }
+    text.resize(16, ' ');
+    out += text;
+}
+
+// Brief comment: UTF-8 text as UTF-16LE bytes (TSL 5 unicode strings); invalid bytes become '?'
+std::string Utf8ToUtf16Le(const std::string& s) {
+    std::string out;
+    auto put = [&out](unsigned v) {
+        out += static_cast<char>(v & 0xFF);
+        out += static_cast<char>(v >> 8);
+    };
+    for (size_t i = 0; i < s.size();) {
+        unsigned char c = s[i];
+        int extra = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xE ? 2 : (c >> 3) == 0x1E ? 3 : -1;
+        unsigned cp = extra == 0 ? c : extra == 1 ? (c & 0x1F) : extra == 2 ? (c & 0x0F) : (c & 0x07);
+        bool valid = extra >= 0 && i + extra < s.size();
+        for (int k = 1; valid && k <= extra; ++k) {
+            unsigned char cc = s[i + k];
+            if ((cc & 0xC0) != 0x80) valid = false;
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        if (!valid) {
+            put('?');
+            ++i;
+            continue;
+        }
+        i += extra + 1;
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            put(0xD800 + (cp >> 10));
+            put(0xDC00 + (cp & 0x3FF));
+        }
+        else put(cp);
+    }
+    return out;
+}
+
+// Brief comment: UTF-16LE bytes as UTF-8 (for printing received TSL 5 texts)
+std::string Utf16LeToUtf8(const std::string& s) {
+    std::string out;
+    for (size_t i = 0; i + 1 < s.size(); i += 2) {
+        unsigned cp = static_cast<unsigned char>(s[i]) | (static_cast<unsigned char>(s[i + 1]) << 8);
+        if (cp >= 0xD800 && cp < 0xDC00 && i + 3 < s.size()) {
+            unsigned lo = static_cast<unsigned char>(s[i + 2]) | (static_cast<unsigned char>(s[i + 3]) << 8);
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            i += 2;
+        }
+        if (cp < 0x80) out += static_cast<char>(cp);
+        else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    return out;
+}
+
+// -----------------------------------------------------------
+// Function: EncodeTsl5Packets
+// Purpose:  Encodes displays as TSL 5.0 packets of at most 2048 bytes.
+// Params:   displays = (index, display) pairs to send
+// Notes:    Packet: PBC (bytes that follow), VER 0, FLAGS, SCREEN, then
+//           per display INDEX, CONTROL, LENGTH, TEXT (all 16-bit LE).
+//           FLAGS bit 0 (UTF-16LE text) is per packet, so texts with
+//           non-ASCII characters go into packets of their own.
+//           CONTROL: right, text and left tally (2 bits each: 1 red,
+//           2 green), brightness 3 in bits 6-7.
+// -----------------------------------------------------------
+std::vector<std::string> EncodeTsl5Packets(int screen, const std::vector<std::pair<int, const UmdDisplay*>>& displays) {
+    const size_t kMaxPacket = 2048;
+    std::vector<std::string> packets;
+    auto put16 = [](std::string& p, unsigned v) {
+        p += static_cast<char>(v & 0xFF);
+        p += static_cast<char>((v >> 8) & 0xFF);
+    };
+    auto start = [&](bool unicode) {
+        std::string p;
+        put16(p, 0);                            // PBC, set when the packet is complete
+        p += '\0';                              // VER
+        p += static_cast<char>(unicode ? 0x01 : 0x00);
+        put16(p, static_cast<unsigned>(screen));
+        return p;
+    };
+    auto finish = [&](std::string& p) {
+        if (p.size() <= 6) return;
+        unsigned pbc = static_cast<unsigned>(p.size() - 2);
+        p[0] = static_cast<char>(pbc & 0xFF);
+        p[1] = static_cast<char>(pbc >> 8);
+        packets.push_back(std::move(p));
+    };
+
+    for (int pass = 0; pass < 2; ++pass) {
+        bool unicode = pass == 1;
+        std::string packet = start(unicode);
+        for (auto& entry : displays) {
+            const UmdDisplay& d = *entry.second;
+            bool ascii = std::all_of(d.text.begin(), d.text.end(), [](char c) { return static_cast<unsigned char>(c) < 0x80; });
+            if (ascii == unicode) continue;
+            std::string text = unicode ? Utf8ToUtf16Le(d.text) : d.text;
+            if (text.size() > 256) text.resize(256);
+            unsigned color = d.tally == 1 ? 1 : d.tally == 2 ? 2 : 0;
+            if (packet.size() + 6 + text.size() > kMaxPacket) {
+                finish(packet);
+                packet = start(unicode);
+            }
+            put16(packet, static_cast<unsigned>(entry.first));
+            put16(packet, color | (color << 2) | (color << 4) | (3 << 6));
+            put16(packet, static_cast<unsigned>(text.size()));
+            packet += text;
+        }
+        finish(packet);
+    }
+    return packets;
+}
+
+// -----------------------------------------------------------
+// Function: RunTslSender
+// Purpose:  Command line mode "--tsl host[:port] --to host[:port] [options]".
+// Operation:
+//   1. Resolves the UMD receiver and opens a UDP socket
+//   2. Opens a session to the hub (retried every 2 s); after every
+//      (re)connect all displays are sent once
+//   3. After every wakeup in which the hub pushed a change, the displays
+//      are derived again (BuildUmdDisplays) and those that differ from
+//      what was last sent are marked
+//   4. Marked displays are sent together when --interval has passed since
+//      the last send (changes in between are merged, only the latest
+//      text and tally of a display go out)
+//   Runs until a key is pressed or the duration has passed.
+// -----------------------------------------------------------
+int RunTslSender(const std::vector<std::string>& args) {
+    TslOptions opt;
+    bool ok = true;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            auto value = [&]() -> std::string {
+                if (a + 1 >= args.size()) throw std::invalid_argument(args[a]);
+                return args[++a];
+            };
+            if (args[a] == "--to") ok = SplitHubAddress(value(), opt.destHost, opt.destPort) && ok;
+            else if (args[a] == "--version") opt.version = std::stoi(value());
+            else if (args[a] == "--screen") opt.screen = std::stoi(value());
+            else if (args[a] == "--index-offset") opt.indexOffset = std::stoi(value());
+            else if (args[a] == "--text") {
+                std::string v = value();
+                if (v == "output") opt.outputText = true;
+                else if (v != "source") ok = false;
+            }
+            else if (args[a] == "--outputs") ok = ParsePortList(value(), opt.outputs) && ok;
+            else if (args[a] == "--program") ok = ParsePortList(value(), opt.program) && ok;
+            else if (args[a] == "--preview") ok = ParsePortList(value(), opt.preview) && ok;
+            else if (args[a] == "--interval") opt.intervalMs = std::stoi(value());
+            else if (args[a] == "--duration") opt.durationS = std::stoi(value());
+            else if (opt.hubHost.empty() && SplitHubAddress(args[a], opt.hubHost, opt.hubPort)) {}
+            else ok = false;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    if (!ok || opt.hubHost.empty() || opt.destHost.empty() || (opt.version != 3 && opt.version != 5) ||
+        opt.screen < 0 || opt.screen > 65535 || opt.indexOffset < 0 || opt.intervalMs < 0 || opt.durationS < 0) {
+        std::cerr << "Usage: VideoHubHL --tsl host[:port] --to host[:port] [--version 3|5] [--screen N]\n"
+            << "       [--index-offset N] [--text source|output] [--outputs 1-16,...] [--program 1,...]\n"
+            << "       [--preview 2,...] [--interval MS] [--duration S]\n";
+        return 1;
+    }
+    const int maxIndex = opt.version == 3 ? 126 : 65535;
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+    std::vector<ResolvedAddress> addrs;
+    if (!gResolver.resolve(opt.destHost, addrs, 3000) || addrs.empty()) {
+        std::cerr << "Cannot resolve " << opt.destHost << ".\n";
+        WSACleanup();
+        return 1;
+    }
+    ResolvedAddress dest = addrs.front();
+    SetAddressPort(dest, opt.destPort);
+    SOCKET udp = socket(dest.addr.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp == INVALID_SOCKET) {
+        WSACleanup();
+        return 1;
+    }
+
+    HubSession s;
+    s.ip = opt.hubHost;
+    s.port = opt.hubPort;
+    std::cout << "TSL " << (opt.version == 3 ? "3.1" : "5.0") << " to " << opt.destHost << ":" << opt.destPort
+        << " from " << opt.hubHost << ":" << opt.hubPort << ". Press any key to stop.\n";
+
+    std::map<int, UmdDisplay> sent;      // per output, as last sent
+    std::map<int, UmdDisplay> displays;  // per output, as derived from the mirror
+    std::set<int> dirty;
+    size_t packets = 0, messages = 0;
+    auto lastSend = Clock::now() - std::chrono::milliseconds(opt.intervalMs);
+    auto end = Clock::now() + std::chrono::seconds(opt.durationS);
+    auto reconnectAt = Clock::now();
+    bool wasUp = false;
+    HubBlock b;
+
+    auto derive = [&]() {
+        displays = BuildUmdDisplays(s.mirror, opt);
+        for (auto& kv : displays) {
+            auto it = sent.find(kv.first);
+            if (it == sent.end() || it->second != kv.second) dirty.insert(kv.first);
+            else dirty.erase(kv.first);   // changed back before it was sent
+        }
+    };
+    auto flush = [&]() {
+        std::vector<std::pair<int, const UmdDisplay*>> batch;
+        for (int o : dirty) {
+            int index = o + opt.indexOffset;
+            if (index <= maxIndex) batch.push_back({ index, &displays[o] });
+            sent[o] = displays[o];
+        }
+        dirty.clear();
+        std::vector<std::string> out;
+        if (opt.version == 3) {
+            for (auto& entry : batch) {
+                out.emplace_back();
+                AppendTsl31Message(out.back(), entry.first, *entry.second);
+            }
+        }
+        else out = EncodeTsl5Packets(opt.screen, batch);
+        for (auto& p : out)
+            sendto(udp, p.data(), static_cast<int>(p.size()), 0, (const sockaddr*)&dest.addr, dest.len);
+        packets += out.size();
+        messages += batch.size();
+        lastSend = Clock::now();
+    };
+
+    while (!(opt.durationS > 0 && Clock::now() >= end)) {
+        if (_kbhit()) {
+            _getch();
+            break;
+        }
+        if (!s.connected() && Clock::now() >= reconnectAt) {
+            reconnectAt = Clock::now() + std::chrono::milliseconds(2000);
+            if (OpenHubSession(s, 1500)) {
+                wasUp = true;
+                sent.clear();
+                derive();
+                std::cout << "Connected, " << displays.size() << " display(s).\n";
+            }
+        }
+
+        WaitForSessions({ &s }, 20);
+        bool changed = false;
+        while (s.reader.next(b)) {
+            Clock::time_point stamp;
+            bool acked;
+            if (PopHubAck(s, b, stamp, acked)) continue;
+            ApplyBlockToMirror(s, b);
+            changed = true;
+        }
+        if (wasUp && !s.connected()) {
+            wasUp = false;
+            std::cout << "Hub lost; the displays keep their last text.\n";
+        }
+        if (changed) derive();
+        if (!dirty.empty() && ElapsedMs(lastSend, Clock::now()) >= opt.intervalMs) flush();
+    }
+
+    std::cout << messages << " display update(s) in " << packets << " packet(s) sent.\n";
+    closesocket(udp);
+    CloseHubSession(s);
+    WSACleanup();
+    return 0;
+}
+
+// -----------------------------------------------------------
+// Function: RunTslListen
+// Purpose:  Command line mode "--tsl-listen [port] [--duration S]": a
+//           local UMD receiver that prints every TSL 3.1 or 5.0 display
+//           message it gets (for testing --tsl without a multiviewer).
+// Notes:    The version is recognised per packet: TSL 5 starts with its
+//           byte count and version 0, TSL 3.1 is a multiple of 18 bytes
+//           starting with an address byte (bit 7 set).
+// -----------------------------------------------------------
+int RunTslListen(const std::vector<std::string>& args) {
+    int port = 8900, durationS = 0;
+    bool ok = true;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            if (args[a] == "--duration" && a + 1 < args.size()) durationS = std::stoi(args[++a]);
+            else if (a == 0) port = std::stoi(args[a]);
+            else ok = false;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    if (!ok || port < 1 || port > 65535 || durationS < 0) {
+        std::cerr << "Usage: VideoHubHL --tsl-listen [port] [--duration S]\n";
+        return 1;
+    }
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+    SOCKET udp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(static_cast<u_short>(port));
+    if (udp == INVALID_SOCKET || bind(udp, (sockaddr*)&local, sizeof(local)) != 0) {
+        std::cerr << "Cannot listen on UDP port " << port << ".\n";
+        if (udp != INVALID_SOCKET) closesocket(udp);
+        WSACleanup();
+        return 1;
+    }
+
+    std::cout << "Listening for TSL on UDP port " << port << ". Press any key to stop.\n";
+    static const char* const kTally[] = { "off", "red", "green", "amber" };
+    auto end = Clock::now() + std::chrono::seconds(durationS);
+    char buf[4096];
+    while (!(durationS > 0 && Clock::now() >= end)) {
+        if (_kbhit()) {
+            _getch();
+            break;
+        }
+        WSAPOLLFD fd{};
+        fd.fd = udp;
+        fd.events = POLLRDNORM;
+        if (WSAPoll(&fd, 1, 50) <= 0) continue;
+        int n = recv(udp, buf, (int)sizeof(buf), 0);
+        if (n <= 0) continue;
+        auto u8 = [&](int i) { return static_cast<unsigned>(static_cast<unsigned char>(buf[i])); };
+        auto u16 = [&](int i) { return u8(i) | (u8(i + 1) << 8); };
+
+        if (n >= 6 && static_cast<int>(u16(0)) + 2 == n && buf[2] == 0) {
+            bool unicode = (u8(3) & 0x01) != 0;
+            unsigned screen = u16(4);
+            for (int i = 6; i + 6 <= n;) {
+                unsigned index = u16(i), control = u16(i + 2), length = u16(i + 4);
+                i += 6;
+                if (i + static_cast<int>(length) > n) break;
+                std::string text(buf + i, length);
+                i += length;
+                std::cout << "TSL5 screen " << screen << " display " << index << ": \""
+                    << (unicode ? Utf16LeToUtf8(text) : text) << "\" tally " << kTally[(control >> 2) & 3]
+                    << " (left " << kTally[(control >> 4) & 3] << ", right " << kTally[control & 3] << ")\n";
+            }
+        }
+        else if (n % 18 == 0 && (u8(0) & 0x80)) {
+            for (int i = 0; i < n; i += 18) {
+                std::string text(buf + i + 2, 16);
+                text.erase(text.find_last_not_of(' ') + 1);
+                unsigned control = u8(i + 1);
+                std::cout << "TSL3.1 display " << (u8(i) & 0x7F) << ": \"" << text << "\" tally"
+                    << ((control & 0x01) ? " 1" : "") << ((control & 0x02) ? " 2" : "")
+                    << ((control & 0x03) ? "" : " off") << "\n";
+            }
+        }
+        else std::cout << "Unknown packet (" << n << " bytes).\n";
     }
+    closesocket(udp);
+    WSACleanup();
+    return 0;
+}
 
+// --------------------- OSC control ---------------------
+// Command line mode "--osc": listens for OSC messages over UDP (lighting
+// and show-control desks) and turns them into hub commands. The mapping
+// comes from 'osc.json' and is compiled once at start: exact addresses
+// go into a hash table, addresses with '*' segments into a short pattern
+// list, fixed takes are encoded into their routing block bytes, preset
+// files are loaded and macros refer to their steps by index. A packet is
+// therefore one lookup and one write to the hub: the commands go through
+// the core scheduler in the Take class (ahead of anything else on the
+// session) and the hub's answer is reported back to the sender over OSC.
+//
+// osc.json:
+//   {
+//     "port": 9000,                                   (UDP port to listen on)
+//     "replyPort": 9001,                              (optional, default = sender's port)
+//     "map": [
+//       { "address": "/videohub/route", "action": "route" },         (args: output, source)
+//       { "address": "/videohub/route/*/*", "action": "route" },     (output, source from the path)
+//       { "address": "/mon/route", "action": "route", "level": "monitoring" },
+//       { "address": "/cam1/pgm", "action": "take", "routes": { "1": 1, "5": 1 } },
+//       { "address": "/videohub/preset", "action": "preset" },        (arg: preset name)
+//       { "address": "/show/open", "action": "preset", "preset": "opening" },
+//       { "address": "/show/start", "action": "macro", "steps": [ "/cam1/pgm", "/show/open" ] }
+//     ]
+//   }
+// Numbers are 1-based as on the hub. A take, preset or macro message
+// whose first argument is 0 (button released) is ignored. Replies:
+// "/videohub/status" (address, "ack" | "nak" | "nak-rollback-failed" |
+// "lost" | "error", ms from packet to hub answer) and
+// "/videohub/connected" (1 / 0) on hub changes.
+
+// Brief comment: one OSC argument (i, f, s, T/F, h, d; T/F and h are kept as numbers)
+struct OscArg {
+    char type = 'i';
+    double number = 0.0;
+    std::string str;
+
+    bool isNumber() const { return type != 's'; }
+};
 
-    // Ask for preset number
-    std::cout << "\nEnter preset number: ";
-    int choice = 0;
-    std::cin >> choice;
+// Brief comment: one OSC message
+struct OscMessage {
+    std::string address;
+    std::vector<OscArg> args;
+};
 
-    if (choice == 0) {
-        std::cout << "Returning to main menu...\n";
-        return;
-    }
+// -----------------------------------------------------------
+// Function: ParseOscPacket
+// Purpose:  Decodes an OSC packet (a message or a bundle, bundles
+//           nested) into messages, in packet order.
+// Notes:    Bundle time tags are ignored: everything runs on arrival.
+// Return:   false when the packet is malformed (messages decoded
+//           before the error stay in out)
+// -----------------------------------------------------------
+bool ParseOscPacket(const char* data, size_t size, std::vector<OscMessage>& out) {
+    auto u32 = [data](size_t p) {
+        return (static_cast<uint32_t>(static_cast<unsigned char>(data[p])) << 24) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(data[p + 1])) << 16) |
+            (static_cast<uint32_t>(static_cast<unsigned char>(data[p + 2])) << 8) |
+            static_cast<uint32_t>(static_cast<unsigned char>(data[p + 3]));
+    };
+    auto readString = [&](size_t& p, std::string& s) {
+        size_t end = p;
+        while (end < size && data[end] != '\0') ++end;
+        if (end >= size) return false;
+        s.assign(data + p, end - p);
+        p = (end + 4) & ~static_cast<size_t>(3);   // behind the terminator, padded to 4
+        return p <= size;
+    };
 
-    if (choice < 1 || choice > static_cast<int>(presets.size())) {
-        std::cout << "Error! Invalid preset number.\n";
-        return;
+    if (size >= 16 && std::memcmp(data, "#bundle", 8) == 0) {
+        size_t p = 16;   // "#bundle\0" + time tag
+        while (p + 4 <= size) {
+            size_t len = u32(p);
+            p += 4;
+            if (len > size - p || !ParseOscPacket(data + p, len, out)) return false;
+            p += len;
+        }
+        return p == size;
     }
 
-    // Map number to filename
-    std::string name = presets[choice - 1].first;
-    std::string fname = "presets/" + name + ".json";
+    OscMessage m;
+    size_t p = 0;
+    std::string types;
+    if (size < 4 || data[0] != '/' || !readString(p, m.address)) return false;
+    if (p < size && !readString(p, types)) return false;
+    if (!types.empty() && types[0] != ',') return false;
+    for (size_t t = 1; t < types.size(); ++t) {
+        OscArg a;
+        a.type = types[t];
+        switch (a.type) {
+        case 'i':
+            if (p + 4 > size) return false;
+            a.number = static_cast<int32_t>(u32(p));
+            p += 4;
+            break;
+        case 'f': {
+            if (p + 4 > size) return false;
+            uint32_t bits = u32(p);
+            float f;
+            std::memcpy(&f, &bits, 4);
+            a.number = f;
+            p += 4;
+            break;
+        }
+        case 'h':
+        case 'd': {
+            if (p + 8 > size) return false;
+            uint64_t bits = (static_cast<uint64_t>(u32(p)) << 32) | u32(p + 4);
+            if (a.type == 'h') a.number = static_cast<double>(static_cast<int64_t>(bits));
+            else std::memcpy(&a.number, &bits, 8);
+            p += 8;
+            break;
+        }
+        case 's':
+            if (!readString(p, a.str)) return false;
+            break;
+        case 'T': a.number = 1; break;
+        case 'F': a.number = 0; break;
+        default: return false;
+        }
+        m.args.push_back(std::move(a));
+    }
+    out.push_back(std::move(m));
+    return true;
+}
 
-    if (!LoadPreset(fname, state)) {
-        std::cout << "Error! Failed to load preset: " << fname << "\n";
-        return;
+// Brief comment: encodes an OSC message with string ('s'), int ('i') and float ('f') arguments
+std::string EncodeOscMessage(const std::string& address, const std::vector<OscArg>& args) {
+    auto putString = [](std::string& p, const std::string& s) {
+        p += s;
+        p.append(4 - s.size() % 4, '\0');
+    };
+    auto put32 = [](std::string& p, uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8) p += static_cast<char>((v >> shift) & 0xFF);
+    };
+    std::string types = ",";
+    for (auto& a : args) types += a.type;
+    std::string p;
+    putString(p, address);
+    putString(p, types);
+    for (auto& a : args) {
+        if (a.type == 's') putString(p, a.str);
+        else if (a.type == 'f') {
+            float f = static_cast<float>(a.number);
+            uint32_t bits;
+            std::memcpy(&bits, &f, 4);
+            put32(p, bits);
+        }
+        else put32(p, static_cast<uint32_t>(static_cast<int32_t>(a.number)));
     }
+    return p;
+}
 
-    // Display loaded preset info
-    std::cout << "\nLoaded preset: " << fname << "\n";
-    std::cout << "Description: " << state.description << "\n";
+// Brief comment: one compiled mapping entry of osc.json
+struct OscAction {
+    enum class Kind { Route, Take, Preset, Macro };
+    Kind kind = Kind::Route;
+    std::string address;
+    const RoutingLevel* level = &kRoutingLevels[0];
+    std::string block;                  // Take: the routing block, encoded at load
+    std::string preset;                 // Preset: fixed preset name ("" = first string argument)
+    std::vector<size_t> steps;          // Macro: indexes of the actions to run, in order
+    std::vector<std::string> pattern;   // address segments when the address contains '*'
+};
 
-    // Inputs
-    std::cout << "\n--- Inputs ---\n";
-    std::cout << std::left << std::setw(6) << "Index" << "Label\n";
-    std::cout << "-------------------------\n";
-    for (auto& kv : state.inputLabels)
-        std::cout << std::left << std::setw(6) << kv.first << kv.second << "\n";
+// Brief comment: the compiled mapping (dispatch tables) and the preloaded presets
+struct OscDispatch {
+    int port = 9000;
+    int replyPort = 0;                                  // 0 = reply to the sender's port
+    std::vector<OscAction> actions;
+    std::unordered_map<std::string, size_t> exact;      // address -> action
+    std::vector<size_t> patterns;                       // actions with '*' segments, in file order
+    std::map<std::string, VideoHubState> presets;       // preset name -> content
+};
 
-    // Outputs
-    std::cout << "\n--- Outputs ---\n";
-    std::cout << std::left << std::setw(6) << "Index" << "Label\n";
-    std::cout << "-------------------------\n";
-    for (auto& kv : state.outputLabels)
-        std::cout << std::left << std::setw(6) << kv.first << kv.second << "\n";
+// Brief comment: splits an OSC address into its segments ("/a/b" -> a, b)
+std::vector<std::string> SplitOscAddress(const std::string& address) {
+    std::vector<std::string> parts;
+    std::istringstream iss(address.substr(1));
+    std::string part;
+    while (std::getline(iss, part, '/')) parts.push_back(part);
+    return parts;
+}
 
-    // Routing
-    std::cout << "\n--- Routing ---\n";
-    std::cout << std::left << std::setw(8) << "OutIdx"
-        << std::setw(20) << "Output Label"
-        << std::setw(8) << "InIdx"
-        << "Input Label\n";
-    std::cout << "------------------------------------------------------------\n";
-    for (auto& kv : state.routing) {
-        std::string outName = state.outputLabels.count(kv.first) ? state.outputLabels[kv.first] : "(unknown)";
-        std::string inName = state.inputLabels.count(kv.second) ? state.inputLabels[kv.second] : "(unknown)";
-        std::cout << std::left << std::setw(8) << kv.first
-            << std::setw(20) << outName
-            << std::setw(8) << kv.second
-            << inName << "\n";
-    }
-    gLoadedPreset = state.description; // store description or filename
+// Brief comment: loads a preset into the dispatch cache once; false when the file cannot be read
+bool CacheOscPreset(OscDispatch& d, const std::string& name) {
+    if (d.presets.count(name)) return true;
+    VideoHubState state;
+    if (name.empty() || name.find_first_of("/\\") != std::string::npos ||
+        !LoadPreset("presets/" + name + ".json", state))
+        return false;
+    d.presets[name] = std::move(state);
+    return true;
 }
 
-// Main function
 // -----------------------------------------------------------
-// Functie: DeletePresetMenu
-// Doel:    Laat de gebruiker een preset selecteren en verwijderen.
-// Werking:
-//   1. Haalt lijst van beschikbare presets op (uit 'presets/' folder)
-//   2. Toont menu met presetnummers + return optie
-//   3. Vraagt de gebruiker een presetnummer te kiezen
-//   4. Controleert keuze en vraagt bevestiging (y/n)
-//   5. Probeert gekozen preset (.json bestand) te verwijderen
-//   6. Meldt succes of foutmelding
+// Function: LoadOscConfig
+// Purpose:  Reads osc.json (format above) and compiles the dispatch
+//           tables: take blocks are encoded, fixed presets loaded and
+//           macro steps resolved to action indexes.
+// Return:   false with a message in error when the file is missing or
+//           an entry is invalid
 // -----------------------------------------------------------
-void DeletePresetMenu() {
-    // Get the list of available presets (pair: filename, description)
-    auto presets = ListPresets();
-    if (presets.empty()) {
-        std::cout << "Error! No presets found in the 'presets/' folder.\n";
-        return;
+bool LoadOscConfig(const std::string& filename, OscDispatch& d, std::string& error) {
+    JsonValue root;
+    if (!LoadJsonFile(filename, root)) {
+        error = "cannot read " + filename;
+        return false;
     }
+    if (auto* p = root.get("port")) d.port = p->asInt(d.port);
+    if (auto* p = root.get("replyPort")) d.replyPort = p->asInt(0);
 
-    // Display menu options
-    std::cout << "  0. Return to main menu\n";
-    std::cout << "Available presets in 'presets/':\n";
-    for (size_t i = 0; i < presets.size(); ++i) {
-        std::cout << "  " << (i + 1) << ". " << presets[i].first
-            << " : " << presets[i].second << "\n";
+    const JsonValue* list = root.get("map");
+    if (!list || list->items.empty()) {
+        error = "no \"map\" entries";
+        return false;
     }
+    std::vector<std::vector<std::string>> macroSteps(list->items.size());
+    for (auto& item : list->items) {
+        OscAction a;
+        if (auto* v = item.get("address")) a.address = v->asString();
+        std::string kind = item.get("action") ? item.get("action")->asString() : "";
+        std::string where = "entry '" + a.address + "': ";
+        if (a.address.size() < 2 || a.address[0] != '/') {
+            error = where + "address must start with '/'";
+            return false;
+        }
+        if (auto* v = item.get("level")) {
+            a.level = nullptr;
+            std::string name = v->asString();
+            for (auto& level : kRoutingLevels) {
+                std::string levelName = level.name;
+                std::transform(levelName.begin(), levelName.end(), levelName.begin(),
+                    [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                if (levelName == name) a.level = &level;
+            }
+            if (!a.level) {
+                error = where + "unknown level '" + name + "'";
+                return false;
+            }
+        }
 
-    // Ask user for a choice
-    std::cout << "\nEnter preset number to delete: ";
-    int choice = 0;
-    std::cin >> choice;
+        if (kind == "route") a.kind = OscAction::Kind::Route;
+        else if (kind == "take") {
+            a.kind = OscAction::Kind::Take;
+            std::map<int, int> routes;
+            if (auto* obj = item.get("routes")) {
+                for (auto& kv : obj->members) {
+                    int out = 0;
+                    try { out = std::stoi(kv.first); }
+                    catch (...) {}
+                    int in = kv.second.asInt(0);
+                    if (out >= 1 && in >= 1) routes[out - 1] = in - 1;
+                }
+            }
+            if (routes.empty()) {
+                error = where + "take without \"routes\"";
+                return false;
+            }
+            a.block = BuildRoutingBlock(a.level->routingHeader, routes);
+        }
+        else if (kind == "preset") {
+            a.kind = OscAction::Kind::Preset;
+            if (auto* v = item.get("preset")) a.preset = v->asString();
+            if (!a.preset.empty() && !CacheOscPreset(d, a.preset)) {
+                error = where + "cannot load preset '" + a.preset + "'";
+                return false;
+            }
+        }
+        else if (kind == "macro") {
+            a.kind = OscAction::Kind::Macro;
+            if (auto* steps = item.get("steps"))
+                for (auto& s : steps->items) macroSteps[d.actions.size()].push_back(s.asString());
+            if (macroSteps[d.actions.size()].empty()) {
+                error = where + "macro without \"steps\"";
+                return false;
+            }
+        }
+        else {
+            error = where + "unknown action '" + kind + "'";
+            return false;
+        }
 
-    // Handle return option
-    if (choice == 0) {
-        std::cout << "Returning to main menu...\n";
-        return;
+        size_t index = d.actions.size();
+        if (a.address.find('*') != std::string::npos) {
+            a.pattern = SplitOscAddress(a.address);
+            d.patterns.push_back(index);
+        }
+        else d.exact[a.address] = index;
+        d.actions.push_back(std::move(a));
     }
 
-    // Validate user input
-    if (choice < 1 || choice > static_cast<int>(presets.size())) {
-        std::cout << "Error! Invalid preset number.\n";
-        return;
+    // macro steps: plain addresses of other entries (no macros, no arguments)
+    for (size_t i = 0; i < d.actions.size(); ++i) {
+        for (auto& step : macroSteps[i]) {
+            auto it = d.exact.find(step);
+            if (it == d.exact.end() || d.actions[it->second].kind == OscAction::Kind::Macro ||
+                d.actions[it->second].kind == OscAction::Kind::Route ||
+                (d.actions[it->second].kind == OscAction::Kind::Preset && d.actions[it->second].preset.empty())) {
+                error = "macro '" + d.actions[i].address + "': step '" + step + "' is not a take or fixed preset";
+                return false;
+            }
+            d.actions[i].steps.push_back(it->second);
+        }
     }
+    return true;
+}
 
-    // Map chosen number to filename
-    std::string name = presets[choice - 1].first;
-    std::string fname = "presets/" + name + ".json";
+// Brief comment: state of the OSC mode shared by the dispatch and the answer callbacks
+struct OscServer {
+    OscDispatch dispatch;
+    HubSession session;
+    HubCommandScheduler scheduler;
+    SOCKET udp = INVALID_SOCKET;
+    std::map<std::string, ResolvedAddress> clients;   // "ip:port" -> reply address
+    long messages = 0;
+    long ignored = 0;
+};
 
-    // Ask confirmation before deleting
-    std::cout << "Are you sure you want to delete '" << fname << "'? (y/n): ";
-    char confirm;
-    std::cin >> confirm;
-    if (confirm != 'y' && confirm != 'Y') {
-        std::cout << "Deletion canceled.\n";
+// Brief comment: where a message came from and when it arrived (for the reply)
+struct OscOrigin {
+    ResolvedAddress reply;
+    std::string address;
+    Clock::time_point received;
+};
+
+// Brief comment: sends one OSC message to a client
+void SendOsc(OscServer& srv, const ResolvedAddress& to, const std::string& address, const std::vector<OscArg>& args) {
+    std::string p = EncodeOscMessage(address, args);
+    sendto(srv.udp, p.data(), static_cast<int>(p.size()), 0, (const sockaddr*)&to.addr, to.len);
+}
+
+// Brief comment: "/videohub/status" reply: address, status, ms from packet to answer
+void ReplyOscStatus(OscServer& srv, const OscOrigin& o, const std::string& status, double ms) {
+    OscArg addr, st, t;
+    addr.type = 's';
+    addr.str = o.address;
+    st.type = 's';
+    st.str = status;
+    t.type = 'f';
+    t.number = ms;
+    SendOsc(srv, o.reply, "/videohub/status", { addr, st, t });
+}
+
+// Brief comment: "/videohub/connected" to every client seen so far
+void BroadcastOscConnected(OscServer& srv, bool up) {
+    OscArg a;
+    a.number = up ? 1 : 0;
+    for (auto& kv : srv.clients) SendOsc(srv, kv.second, "/videohub/connected", { a });
+}
+
+// -----------------------------------------------------------
+// Function: RecallOscPreset
+// Purpose:  Takes a preset as one Take-class block per changed level.
+//           When every block is answered: "ack", or on a NAK the
+//           previous routes of all levels are sent back (as the menu
+//           salvo does) and, once the rollback is answered, "nak"
+//           (rolled back) or "nak-rollback-failed" is reported.
+// -----------------------------------------------------------
+void RecallOscPreset(OscServer& srv, const VideoHubState& preset, const OscOrigin& origin) {
+    struct Recall {
+        std::vector<SalvoLevel> levels;
+        size_t remaining = 0;
+        bool allAcked = true;
+        bool lost = false;
+    };
+    auto rc = std::make_shared<Recall>();
+    rc->levels = BuildSalvo(preset, srv.session.mirror);
+    if (rc->levels.empty()) {
+        ReplyOscStatus(srv, origin, "ack", ElapsedMs(origin.received, Clock::now()));
         return;
     }
+    rc->remaining = rc->levels.size();
+    for (auto& sl : rc->levels) {
+        auto done = [&srv, rc, origin](bool acked, double ms) {
+            if (ms < 0) rc->lost = true;
+            else if (!acked) rc->allAcked = false;
+            if (--rc->remaining > 0) return;
+            if (rc->lost) ReplyOscStatus(srv, origin, "lost", 0.0);
+            else if (rc->allAcked) ReplyOscStatus(srv, origin, "ack", ms);
+            else {
+                // report when every rollback block is answered
+                auto back = std::make_shared<Recall>();
+                for (auto& level : rc->levels)
+                    if (!level.previous.empty()) ++back->remaining;
+                if (back->remaining == 0) {
+                    ReplyOscStatus(srv, origin, "nak", ms);
+                    return;
+                }
+                auto rolledBack = [&srv, back, origin](bool acked, double backMs) {
+                    if (backMs < 0) back->lost = true;
+                    else if (!acked) back->allAcked = false;
+                    if (--back->remaining > 0) return;
+                    ReplyOscStatus(srv, origin, back->allAcked && !back->lost ? "nak" : "nak-rollback-failed",
+                        back->lost ? 0.0 : backMs);
+                };
+                for (auto& level : rc->levels)
+                    if (!level.previous.empty())
+                        ScheduleCommand(srv.scheduler, CommandClass::Take,
+                            BuildRoutingBlock(level.level->routingHeader, level.previous), rolledBack, origin.received);
+            }
+        };
+        ScheduleCommand(srv.scheduler, CommandClass::Take, BuildRoutingBlock(sl.level->routingHeader, sl.routes),
+            done, origin.received);
+    }
+}
 
-    // Attempt to remove the file
-    try {
-        if (fs::remove(fname)) {
-            std::cout << "Preset deleted: " << fname << "\n";
+// -----------------------------------------------------------
+// Function: RunOscAction
+// Purpose:  Runs one compiled action for a message.
+// Params:   numbers = '*' segments of the address (as numbers) followed
+//                     by the numeric arguments of the message
+//           text    = first string argument ("" if none)
+// -----------------------------------------------------------
+void RunOscAction(OscServer& srv, const OscAction& a, const std::vector<double>& numbers, const std::string& text,
+    const OscOrigin& origin) {
+    auto reply = [&srv, origin](bool acked, double ms) {
+        ReplyOscStatus(srv, origin, ms < 0 ? "lost" : acked ? "ack" : "nak", ms < 0 ? 0.0 : ms);
+    };
+    switch (a.kind) {
+    case OscAction::Kind::Route: {
+        // output/input are 1-based; NaN, inf or out-of-range floats must not reach the int cast
+        auto isIndex = [](double v) { return std::isfinite(v) && v >= 1 && v <= 65535; };
+        if (numbers.size() < 2 || !isIndex(numbers[0]) || !isIndex(numbers[1]) || (numbers.size() > 2 && numbers[2] == 0)) {
+            if (numbers.size() > 2 && numbers[2] == 0) ++srv.ignored;
+            else ReplyOscStatus(srv, origin, "error", 0.0);
+            return;
         }
-        else {
-            std::cout << "Error! Failed to delete preset: " << fname << "\n";
+        int out = static_cast<int>(numbers[0]) - 1, in = static_cast<int>(numbers[1]) - 1;
+        ScheduleCommand(srv.scheduler, CommandClass::Take, BuildRoutingBlock(a.level->routingHeader, { { out, in } }),
+            reply, origin.received);
+        break;
+    }
+    case OscAction::Kind::Take:
+        ScheduleCommand(srv.scheduler, CommandClass::Take, a.block, reply, origin.received);
+        break;
+    case OscAction::Kind::Preset: {
+        std::string name = a.preset.empty() ? text : a.preset;
+        if (!CacheOscPreset(srv.dispatch, name)) {
+            ReplyOscStatus(srv, origin, "error", 0.0);
+            return;
         }
+        RecallOscPreset(srv, srv.dispatch.presets[name], origin);
+        break;
     }
-    catch (const std::exception& e) {
-        std::cout << "Exception while deleting preset: " << e.what() << "\n";
+    case OscAction::Kind::Macro:
+        for (size_t step : a.steps) RunOscAction(srv, srv.dispatch.actions[step], {}, "", origin);
+        break;
     }
 }
 
-// Main function
-// Function: CompareCurrentHub
-// Purpose:  Compares a loaded preset with the current Videohub status
-// Params:
-//   loadedPreset = VideoHubState of the loaded preset
-//   currentHub   = VideoHubState of the current hub status
-// Operation:
-//   1. Checks if a preset is loaded and if the hub has been read
-//   2. Collects all output indices
-//   3. Compares for each output the preset input vs the hub input
-//   4. Prints a table with colors: green = match, red = difference
-//   5. Prints a legend at the bottom
-void CompareCurrentHub(VideoHubState& loadedPreset, VideoHubState& currentHub) {
-    if (loadedPreset.routing.empty()) {
-        std::cout << "\n!!! No preset loaded. Load a preset first.\n";
-        return;
+// -----------------------------------------------------------
+// Function: DispatchOscMessage
+// Purpose:  Finds the action of a message (hash lookup, then the '*'
+//           patterns) and runs it; the commands leave for the hub at once.
+// -----------------------------------------------------------
+void DispatchOscMessage(OscServer& srv, const OscMessage& m, OscOrigin origin) {
+    ++srv.messages;
+    origin.address = m.address;
+    const OscAction* action = nullptr;
+    std::vector<double> numbers;
+    auto it = srv.dispatch.exact.find(m.address);
+    if (it != srv.dispatch.exact.end()) action = &srv.dispatch.actions[it->second];
+    else {
+        std::vector<std::string> parts = SplitOscAddress(m.address);
+        for (size_t index : srv.dispatch.patterns) {
+            const OscAction& a = srv.dispatch.actions[index];
+            if (a.pattern.size() != parts.size()) continue;
+            std::vector<double> captured;
+            bool match = true;
+            for (size_t i = 0; match && i < parts.size(); ++i) {
+                if (a.pattern[i] == "*") {
+                    // the whole segment must be a number ("1abc" is no match)
+                    size_t used = 0;
+                    try { captured.push_back(std::stod(parts[i], &used)); }
+                    catch (...) { match = false; }
+                    if (used != parts[i].size()) match = false;
+                }
+                else match = a.pattern[i] == parts[i];
+            }
+            if (match) {
+                action = &a;
+                numbers = std::move(captured);
+                break;
+            }
+        }
     }
-    if (!gVideoHubRead) {
-        std::cout << "\n!!! Videohub has not been read yet. Run 'Read Videohub' first.\n";
+    if (!action) {
+        ++srv.ignored;
         return;
     }
 
-    std::cout << "\n=== Comparison: Loaded Preset vs Current Videohub ===\n\n";
-
-    std::cout << std::left
-        << std::setw(20) << "Output Label"
-        << std::setw(20) << "Preset Input"
-        << std::setw(20) << "Hub Input"
-        << "Diff\n";
-    std::cout << "----------------------------------------------------------------\n";
-
-    // Collect all output indices
-    std::set<int> allOutputs;
-    for (auto& kv : loadedPreset.routing) allOutputs.insert(kv.first);
-    for (auto& kv : currentHub.routing) allOutputs.insert(kv.first);
-
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-
-    for (int outIdx : allOutputs) {
-        int presetIn = loadedPreset.routing.count(outIdx) ? loadedPreset.routing[outIdx] : -1;
-        int hubIn = currentHub.routing.count(outIdx) ? currentHub.routing[outIdx] : -1;
-
-        std::string outLabel = loadedPreset.outputLabels.count(outIdx) ? loadedPreset.outputLabels[outIdx] :
-            currentHub.outputLabels.count(outIdx) ? currentHub.outputLabels[outIdx] : "(unknown)";
-        std::string presetInLabel = loadedPreset.inputLabels.count(presetIn) ? loadedPreset.inputLabels[presetIn] : "(none)";
-        std::string hubInLabel = currentHub.inputLabels.count(hubIn) ? currentHub.inputLabels[hubIn] : "(none)";
-
-        bool isDiff = (presetIn != hubIn);
-
-        // Set color (red for difference, green for match)
-        SetConsoleTextAttribute(hConsole, isDiff ? FOREGROUND_RED | FOREGROUND_INTENSITY
-            : FOREGROUND_GREEN | FOREGROUND_INTENSITY);
-
-        std::cout << std::left
-            << std::setw(20) << outLabel
-            << std::setw(20) << presetInLabel
-            << std::setw(20) << hubInLabel
-            << (isDiff ? "*" : "")
-            << "\n";
+    std::string text;
+    for (auto& arg : m.args) {
+        if (arg.isNumber()) numbers.push_back(arg.number);
+        else if (text.empty()) text = arg.str;
     }
-
-    // Reset color
-    SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
-
-    std::cout << "\nLegend:\n  Green = preset matches hub\n  Red = difference (*)\n\n";
+    if (action->kind != OscAction::Kind::Route && !m.args.empty() && m.args[0].isNumber() && m.args[0].number == 0) {
+        ++srv.ignored;   // button released
+        return;
+    }
+    if (!srv.session.connected()) {
+        ReplyOscStatus(srv, origin, "error", 0.0);
+        return;
+    }
+    RunOscAction(srv, *action, numbers, text, origin);
+    PumpScheduler(srv.scheduler, srv.session);
 }
 
 // -----------------------------------------------------------
-// Function: ResetVideoHubState
-// Purpose:  Resets a VideoHubState struct completely to an empty state
-// Param:    state = reference to the VideoHubState to reset
+// Function: RunOscControl
+// Purpose:  Command line mode "--osc host[:port] [--config FILE] [--port N] [--duration S]".
 // Operation:
-//   - Clears all vectors and strings in the struct:
-//        inputLabels, outputLabels, routing, description
-//   - Useful for initialization or after loading a new preset
+//   1. Compiles osc.json (LoadOscConfig) and binds the UDP port
+//   2. Keeps a session to the hub (reconnect every 2 s; commands lost
+//      with the connection are reported as "lost")
+//   3. Waits on the UDP socket and the hub socket together (WSAPoll);
+//      every OSC packet is dispatched as soon as it arrives, and answers
+//      from the hub are matched to their command by the scheduler
+//   4. At the end prints the time from packet to hub write and to the
+//      hub's answer
+//   Runs until a key is pressed or the duration has passed.
 // -----------------------------------------------------------
-void ResetVideoHubState(VideoHubState& state) {
-    state.inputLabels.clear();
-    state.outputLabels.clear();
-    state.routing.clear();
-    state.description.clear();
-}
+int RunOscControl(const std::vector<std::string>& args) {
+    std::string host, configFile = "osc.json";
+    int port = 9990, listenPort = 0, durationS = 0;
+    bool ok = true;
+    try {
+        for (size_t a = 0; a < args.size(); ++a) {
+            auto value = [&]() -> std::string {
+                if (a + 1 >= args.size()) throw std::invalid_argument(args[a]);
+                return args[++a];
+            };
+            if (args[a] == "--config") configFile = value();
+            else if (args[a] == "--port") listenPort = std::stoi(value());
+            else if (args[a] == "--duration") durationS = std::stoi(value());
+            else if (host.empty() && SplitHubAddress(args[a], host, port)) {}
+            else ok = false;
+        }
+    }
+    catch (...) {
+        ok = false;
+    }
+    if (!ok || host.empty() || listenPort < 0 || listenPort > 65535 || durationS < 0) {
+        std::cerr << "Usage: VideoHubHL --osc host[:port] [--config FILE] [--port N] [--duration S]\n";
+        return 1;
+    }
 
-// Main function
-// -----------------------------------------------------------
-// Function: SetVideoHubIP
-// Purpose:  Sets the VideoHub IP via a menu
-// Operation: 
-//   1. Show menu with 3 options (new IP, 12x12, 40x40)
-//   2. For choice 1: enter IP and validate using IsValidIPv4()
-//   3. For choice 2 or 3: set fixed IP
-//   4. Invalid choice -> error message, hubIP unchanged
-// Usage:    To be called from main menu via case 7
-// -----------------------------------------------------------
-void SetVideoHubIP() {
-    std::cout << "Choose an option:\n";
-    std::cout << "1) Enter new IP address\n";
-    std::cout << "2) Videohub 12x12 (192.168.1.248)\n";
-    std::cout << "3) Videohub 40x40 (172.20.5.247)\n";
-    std::cout << "Enter choice (1-3): ";
+    OscServer srv;
+    std::string error;
+    if (!LoadOscConfig(configFile, srv.dispatch, error)) {
+        std::cerr << "OSC configuration: " << error << "\n";
+        return 1;
+    }
+    if (listenPort > 0) srv.dispatch.port = listenPort;
 
-    int choice;
-    std::cin >> choice;
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+    srv.udp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(static_cast<u_short>(srv.dispatch.port));
+    if (srv.udp == INVALID_SOCKET || bind(srv.udp, (sockaddr*)&local, sizeof(local)) != 0) {
+        std::cerr << "Cannot listen on UDP port " << srv.dispatch.port << ".\n";
+        if (srv.udp != INVALID_SOCKET) closesocket(srv.udp);
+        WSACleanup();
+        return 1;
+    }
 
-    switch (choice) {
-    case 1: {
-        std::cout << "Enter new IP address: ";
-        std::string newIP;
-        std::cin >> newIP;
+    srv.session.ip = host;
+    srv.session.port = port;
+    std::cout << "OSC on UDP port " << srv.dispatch.port << " (" << srv.dispatch.actions.size() << " mapping(s), "
+        << srv.dispatch.presets.size() << " preset(s) loaded) -> " << host << ":" << port
+        << ". Press any key to stop.\n";
 
-        if (IsValidIPv4(newIP)) {
-            hubIP = newIP;
-            std::cout << "VideoHub IP set to: " << hubIP << "\n";
+    auto end = Clock::now() + std::chrono::seconds(durationS);
+    auto reconnectAt = Clock::now();
+    bool wasUp = false;
+    HubBlock b;
+    char buf[8192];
+    std::vector<OscMessage> messages;
+    while (!(durationS > 0 && Clock::now() >= end)) {
+        if (_kbhit()) {
+            _getch();
+            break;
         }
-        else {
-            std::cout << "Invalid IP address format: " << newIP << "\n";
+        if (!srv.session.connected() && Clock::now() >= reconnectAt) {
+            reconnectAt = Clock::now() + std::chrono::milliseconds(2000);
+            if (OpenHubSession(srv.session, 1500)) {
+                wasUp = true;
+                std::cout << "Connected to " << host << ".\n";
+                BroadcastOscConnected(srv, true);
+            }
+        }
+
+        WSAPOLLFD fds[2] = {};
+        fds[0].fd = srv.udp;
+        fds[0].events = POLLRDNORM;
+        ULONG count = 1;
+        if (srv.session.connected()) {
+            fds[1].fd = srv.session.sock;
+            fds[1].events = POLLRDNORM;
+            count = 2;
+        }
+        WSAPoll(fds, count, 50);
+
+        // OSC first: a take never waits behind the processing of hub echoes
+        if (fds[0].revents & (POLLRDNORM | POLLERR)) {
+            for (int n = 0; n < 64; ++n) {   // drain what arrived, bounded
+                sockaddr_storage from{};
+                socklen_t fromLen = sizeof(from);
+                int rec = recvfrom(srv.udp, buf, (int)sizeof(buf), 0, (sockaddr*)&from, &fromLen);
+                if (rec <= 0) break;
+                OscOrigin origin;
+                origin.received = Clock::now();
+                std::memcpy(&origin.reply.addr, &from, fromLen);
+                origin.reply.len = fromLen;
+                if (srv.dispatch.replyPort > 0) SetAddressPort(origin.reply, srv.dispatch.replyPort);
+                char text[INET6_ADDRSTRLEN] = "";
+                const void* ip = from.ss_family == AF_INET6 ? (const void*)&((sockaddr_in6*)&origin.reply.addr)->sin6_addr
+                    : (const void*)&((sockaddr_in*)&origin.reply.addr)->sin_addr;
+                inet_ntop(from.ss_family, ip, text, sizeof(text));
+                int replyPort = ntohs(from.ss_family == AF_INET6 ? ((sockaddr_in6*)&origin.reply.addr)->sin6_port
+                    : ((sockaddr_in*)&origin.reply.addr)->sin_port);
+                srv.clients[std::string(text) + ":" + std::to_string(replyPort)] = origin.reply;
+
+                messages.clear();
+                if (!ParseOscPacket(buf, static_cast<size_t>(rec), messages)) ++srv.ignored;
+                for (auto& m : messages) DispatchOscMessage(srv, m, origin);
+
+                WSAPOLLFD more{};
+                more.fd = srv.udp;
+                more.events = POLLRDNORM;
+                if (WSAPoll(&more, 1, 0) <= 0) break;
+            }
+        }
+
+        if (count == 2 && (fds[1].revents & (POLLRDNORM | POLLERR | POLLHUP))) ReadIntoSession(srv.session);
+        while (srv.session.reader.next(b)) {
+            if (HandleScheduledAnswer(srv.scheduler, srv.session, b)) continue;
+            ApplyBlockToMirror(srv.session, b);
+        }
+        PumpScheduler(srv.scheduler, srv.session);   // rollbacks queued by answers
+        if (wasUp && !srv.session.connected()) {
+            wasUp = false;
+            DropScheduledCommands(srv.scheduler);
+            std::cout << "Hub lost; reconnecting.\n";
+            BroadcastOscConnected(srv, false);
         }
-        break;
     }
-    case 2:
-        hubIP = "192.168.1.248";
-        std::cout << "VideoHub 12x12 IP set to: " << hubIP << "\n";
-        break;
-    case 3:
-        hubIP = "172.20.5.247";
-        std::cout << "VideoHub 40x40 IP set to: " << hubIP << "\n";
-        break;
-    default:
-        std::cout << "Invalid choice.\n";
-        break;
+
+    const CommandClassStats& st = srv.scheduler.stats[static_cast<int>(CommandClass::Take)];
+    long sent = st.acked + st.naked + st.lost;
+    std::cout << srv.messages << " OSC message(s), " << srv.ignored << " ignored, " << sent << " command(s) ("
+        << st.naked << " NAK, " << st.lost << " lost).\n";
+    if (sent > 0) {
+        std::cout << std::fixed << std::setprecision(3)
+            << "Packet to hub write: avg " << st.sumWaitMs / sent << " ms, max " << st.maxWaitMs << " ms\n"
+            << "Packet to hub answer: p50 " << CommandLatencyPercentile(st, 50) << " ms, p99 "
+            << CommandLatencyPercentile(st, 99) << " ms, max " << st.maxLatencyMs << " ms\n" << std::defaultfloat;
     }
+    closesocket(srv.udp);
+    CloseHubSession(srv.session);
+    WSACleanup();
+    return 0;
 }
 
 // --------------------- MAIN ---------------------
-int main() {
+int main(int argc, char* argv[]) {
+    // command line modes (no menu)
+    if (argc > 1) {
+        std::string mode = argv[1];
+        std::vector<std::string> args(argv + 2, argv + argc);
+        if (mode == "--bench-parse") return RunParseBenchmark();
+        if (mode == "--bench-churn") return RunChurnBenchmark(args);
+        if (mode == "--probe-latency") return RunLatencyProbe(args);
+        if (mode == "--bench") return RunBenchmarkSuite(args);
+        if (mode == "--watch") return RunStatusWatch(args);
+        if (mode == "--publish") return RunShmPublish(args);
+        if (mode == "--shm-dump") return RunShmDump(args);
+        if (mode == "--tsl") return RunTslSender(args);
+        if (mode == "--tsl-listen") return RunTslListen(args);
+        if (mode == "--osc") return RunOscControl(args);
+        std::cerr << "Usage: VideoHubHL [--bench [host[:port]] ... | --bench-parse | --bench-churn host[:port] ..."
+            << " | --probe-latency host[:port] ... | --watch host[:port] ... | --publish host[:port] | --shm-dump"
+            << " | --tsl host[:port] --to host[:port] ... | --tsl-listen [port] | --osc host[:port] ...]\n";
+        return 1;
+    }
+
     VideoHubState loadedPreset; // struct containing input, output, routing labels, description, and filename
     VideoHubState currentHub;
     ResetVideoHubState(loadedPreset); // completely reset at start
@@ -1340,7 +5707,16 @@ int main() {
     int choice = -1;
     gVideoHubRead = false;
 
+    // warm start: last used hub and its last-known state from the registry
+    std::unique_ptr<BackgroundRead> refresh;
+    if (LoadHubRegistry(gHubRegistry) && !gHubRegistry.currentIp.empty()) {
+        hubIP = gHubRegistry.currentIp;
+        hubPort = gHubRegistry.currentPort;
+        WarmStartCurrentHub(currentHub, refresh);
+    }
+
     while (choice != 0) {
+        PollBackgroundRead(currentHub, refresh);
         std::cout << "\n--- Videohub Preset Manager --- " << version <<"\n";
         std::cout << "0 = Exit\n";
         std::cout << "1 = Read VideoHub\n";
@@ -1350,8 +5726,14 @@ int main() {
         std::cout << "5 = Compare loaded preset with current Videohub\n";
         std::cout << "6 = Write displayed preset to VideoHub\n";
         std::cout << "7 = Read VideoHub display all data with preamble\n";
-        std::cout << "8 = Set VideoHub IP Address (current: " << hubIP << ")\n";
-        std::cout << "\nVideohub Status: " << (gVideoHubRead ? "up-to-date" : "not read") << "\n";
+        std::cout << "8 = Set VideoHub IP Address (current: " << hubIP
+            << (hubPort != 9990 ? ":" + std::to_string(hubPort) : "") << ")\n";
+        std::cout << "9 = Replicate routing to backup hub(s)\n";
+        std::cout << "10 = Failover: keep spare hub in sync, switch on primary loss\n";
+        std::cout << "11 = Route by name (e.g. PGM 2 <- CAM 3)\n";
+        std::cout << "12 = Crosspoint grid (live, scrollable)\n";
+        std::cout << "\nVideohub Status: "
+            << (gVideoHubRead ? "up-to-date" : gVideoHubStale ? "last-known state (stale)" : "not read") << "\n";
         std::cout << "Loaded Preset: " << (gLoadedPreset.empty() ? "(none)" : gLoadedPreset) << "\n";
         std::cout << "\nChoice: ";
         std::cin >> choice;
@@ -1382,14 +5764,35 @@ int main() {
             ReadVideoHubFullDisplay(currentHub);
             break;
         case 8: {
+            std::string previousIP = hubIP;
+            int previousPort = hubPort;
             SetVideoHubIP();
+            if (hubIP != previousIP || hubPort != previousPort) {
+                ResetVideoHubState(currentHub);
+                gVideoHubRead = false;
+                gVideoHubStale = false;
+                WarmStartCurrentHub(currentHub, refresh);
+            }
             break;
         }
+        case 9:
+            ReplicateRoutingMenu();
+            break;
+        case 10:
+            FailoverMenu();
+            break;
+        case 11:
+            RouteByNameMenu(currentHub);
+            break;
+        case 12:
+            CrosspointGridMenu(loadedPreset);
+            break;
         default:
             std::cout << "Invalid choice, try again.\n";
             break;
         }
 
     }
+    StopBackgroundRead(refresh);   // a read still running must not outlive main
     return 0;
 }
@@ -0,0 +1,131 @@
+﻿// VideoHubShm.h
+// Compile as x64 with C++17. Shared-memory layout of the live hub state for local consumers.
+
+/*
+===============================================================================
+Videohub state in shared memory
+===============================================================================
+
+Description:
+VideoHubHL --publish keeps one session to a hub open and copies its live
+mirror (port counts, routing of all levels, labels) into a named shared
+memory segment on every change. Local programs (tally, multiviewer label
+feeds, logging) include this header and read the state straight from the
+mapped memory: no hub connection of their own and no system call per read.
+
+Consistency (seqlock):
+- the writer makes 'sequence' odd, writes the state, and makes it even
+  again; 'version' in the state counts the published changes
+- a reader copies the state between two reads of 'sequence' and retries
+  when the value was odd or changed (VhShmRead does this)
+- readers never block the writer; a reader that only wants to know
+  whether anything changed compares VhShmSequence with its last value
+- there is one writer per segment: a second publisher is refused, and
+  a publisher that finds 'sequence' odd (a crashed writer) keeps it odd
+  until it has rewritten the whole state
+
+Layout:
+- fixed size, fixed-width types, capacity kVhShmMaxPorts per table
+  (288, the largest Videohub); larger tables are cut off
+- labels are UTF-8, zero terminated, at most kVhShmLabelBytes - 1 bytes
+- routing entries are source indexes (0-based), kVhShmNoRoute = unknown
+
+Usage (consumer):
+   HANDLE h = OpenFileMappingA(FILE_MAP_READ, FALSE, kVhShmDefaultName);
+   auto* shm = (const VhShmLayout*)MapViewOfFile(h, FILE_MAP_READ, 0, 0, sizeof(VhShmLayout));
+   VhShmState state;
+   if (VhShmRead(shm, state)) ... state.routing[output] ...
+
+Version: 1.0
+===============================================================================
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+
+const char* const kVhShmDefaultName = "Local\\VideoHubHL";
+const uint32_t kVhShmMagic = 0x4D534856;   // "VHSM"
+const uint32_t kVhShmLayoutVersion = 1;
+const int kVhShmMaxPorts = 288;
+const int kVhShmLabelBytes = 64;
+const uint16_t kVhShmNoRoute = 0xFFFF;
+
+// Brief comment: the published hub state (plain data, copied as a whole by readers)
+struct VhShmState {
+    uint64_t version;                 // published changes since the publisher started
+    int64_t updatedUnixMs;            // time of the last change (ms since 1970)
+    uint32_t connected;               // 1 while the publisher has a session to the hub
+    uint32_t inputs;                  // port counts as known from the hub (cut to kVhShmMaxPorts)
+    uint32_t outputs;
+    uint32_t monitorOutputs;
+    uint32_t serialPorts;
+    uint32_t reserved;
+    char hub[64];                     // "ip:port"
+    char model[64];                   // model name from VIDEOHUB DEVICE
+    uint16_t routing[kVhShmMaxPorts];         // video output -> input
+    uint16_t monitorRouting[kVhShmMaxPorts];  // monitoring output -> input
+    uint16_t serialRouting[kVhShmMaxPorts];   // serial port -> serial port
+    char inputLabels[kVhShmMaxPorts][kVhShmLabelBytes];
+    char outputLabels[kVhShmMaxPorts][kVhShmLabelBytes];
+    char monitorLabels[kVhShmMaxPorts][kVhShmLabelBytes];
+    char serialLabels[kVhShmMaxPorts][kVhShmLabelBytes];
+};
+
+// Brief comment: the whole shared memory segment
+struct VhShmLayout {
+    uint32_t magic;                   // kVhShmMagic once the publisher initialised the segment
+    uint32_t layoutVersion;           // kVhShmLayoutVersion
+    std::atomic<uint32_t> sequence;   // seqlock: odd while the publisher writes
+    uint32_t stateBytes;              // sizeof(VhShmState) of the publisher
+    VhShmState state;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "seqlock needs a lock-free 32-bit atomic");
+
+// Brief comment: current sequence; unchanged means the state did not change
+inline uint32_t VhShmSequence(const VhShmLayout* shm) {
+    return shm->sequence.load(std::memory_order_acquire);
+}
+
+// -----------------------------------------------------------
+// Function: VhShmRead
+// Purpose:  Copies a consistent snapshot of the state (seqlock read).
+// Params:   shm = mapped segment, out = receives the state
+//           maxTries = attempts before giving up (writer very busy)
+// Return:   false when the segment is not (yet) initialised, has another
+//           layout, or no consistent copy was made within maxTries
+// -----------------------------------------------------------
+inline bool VhShmRead(const VhShmLayout* shm, VhShmState& out, int maxTries = 1000) {
+    if (!shm || shm->magic != kVhShmMagic || shm->layoutVersion != kVhShmLayoutVersion ||
+        shm->stateBytes != sizeof(VhShmState))
+        return false;
+    for (int attempt = 0; attempt < maxTries; ++attempt) {
+        uint32_t before = shm->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::memcpy(&out, &shm->state, sizeof(VhShmState));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shm->sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
+
+// -----------------------------------------------------------
+// Function: VhShmBeginWrite / VhShmEndWrite
+// Purpose:  Publisher side of the seqlock; all changes to shm->state
+//           go between these two calls (one writer only).
+// -----------------------------------------------------------
+inline void VhShmBeginWrite(VhShmLayout* shm) {
+    shm->sequence.store(shm->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline void VhShmEndWrite(VhShmLayout* shm) {
+    shm->sequence.store(shm->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,768 @@
+﻿// VideoHubSim.cpp
+// Compile as x64 with C++17. Uses Winsock. Local Videohub simulator for testing and benchmarks.
+
+/*
+===============================================================================
+Blackmagic Videohub Simulator
+===============================================================================
+
+Description:
+This C++17 console program simulates one or many Blackmagic Videohubs
+on the local machine. Each virtual hub listens on its own TCP port and
+speaks the Videohub Ethernet protocol closely enough for the Preset
+Manager (VideoHubHL) to read, write, replicate and discover it.
+
+Features:
+1. Many virtual hubs in one process:
+   - one WSAPoll loop serves all listeners and all client connections
+   - hub i listens on basePort + i
+   - per hub only the routing table and changed labels are stored,
+     so thousands of 40x40 hubs fit comfortably on a laptop
+2. Configurable matrix sizes (one size, or a list cycled over the hubs)
+3. Independent random front-panel switching per hub:
+   - every hub changes one random output at random intervals
+     (exponential distribution with the given mean)
+   - changes are pushed to all connected clients like a real hub
+4. Protocol support:
+   - prelude on connect (PROTOCOL PREAMBLE, VIDEOHUB DEVICE,
+     INPUT LABELS, OUTPUT LABELS, VIDEO OUTPUT LOCKS,
+     VIDEO OUTPUT ROUTING, CONFIGURATION, END PRELUDE)
+   - optional monitoring outputs (Smart Videohub): MONITORING OUTPUT
+     LABELS, MONITORING OUTPUT LOCKS, VIDEO MONITORING OUTPUT ROUTING
+   - optional RS-422 serial ports: SERIAL PORT LABELS, SERIAL PORT
+     ROUTING (port -> port), SERIAL PORT LOCKS, SERIAL PORT DIRECTIONS
+   - CONFIGURATION (Take Mode) can be changed by clients
+   - optional ALARM STATUS (fans, power supplies, temperature); alarms
+     flip at random and are not pushed, so clients have to poll them
+   - routing and label changes: ACK, then broadcast to all clients
+   - PING: ACK
+   - a header with an empty body: ACK followed by the current block
+   - anything else: NAK
+5. Adversarial network mode (parser stress):
+   - output split into fragments of random size (1 = byte at a time)
+   - a delay between fragments
+   - output held back for a while so unrelated blocks (ACK, change
+     notifications, front-panel changes) leave in one send
+   - a fraction of valid commands answered with NAK (and not applied)
+
+Usage:
+   VideoHubSim [--hubs N] [--base-port P] [--bind IP] [--size 40x40[,12x12...]]
+               [--churn MS] [--seed S] [--monitor N] [--serial N] [--alarms MS]
+               [--fragment N] [--fragment-delay MS] [--coalesce MS] [--nak-rate P]
+
+   --hubs       number of virtual hubs (default 1)
+   --base-port  port of the first hub (default 9990)
+   --bind       listen address (default 127.0.0.1)
+   --size       matrix size(s) inputs x outputs (default 40x40)
+   --churn      mean ms between front-panel changes per hub, 0 = off (default 0)
+   --seed       random seed (default: time based)
+   --monitor    monitoring outputs per hub (default 0)
+   --serial     serial ports per hub (default 0)
+   --alarms     report ALARM STATUS; mean ms between random alarm flips
+                per hub (default 0 = no alarm reporting)
+   --fragment        max bytes per send, random 1..N (default 0 = off, 1 = byte at a time)
+   --fragment-delay  ms between fragments of one client (default 0)
+   --coalesce        ms output is held so blocks are sent together (default 0)
+   --nak-rate        fraction 0..1 of valid commands answered with NAK (default 0)
+
+   Press any key to stop. Statistics are printed every 5 seconds.
+
+Example:
+   VideoHubSim --hubs 2000 --base-port 10000 --size 40x40 --churn 5000
+   then discover them in VideoHubHL with the range 127.0.0.1:10000-11999
+
+Author: [Henk Levels with a lot of help from ChatGPT]
+Version: 1.0
+===============================================================================
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <queue>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <conio.h>     // _kbhit / _getch to stop the simulator
+
+
+#pragma comment(lib, "Ws2_32.lib")
+std::string version = "v1.0";
+
+using Clock = std::chrono::steady_clock;
+
+// --------------------- Data structures ---------------------
+
+// Brief comment: one virtual hub
+struct SimHub {
+    int index = 0;
+    int port = 0;
+    int inputs = 40;
+    int outputs = 40;
+    SOCKET listener = INVALID_SOCKET;
+    int monitors = 0;
+    std::vector<uint16_t> routing;            // output -> input
+    std::vector<char> locks;                  // output -> 'U', 'L' or 'O'
+    std::vector<uint16_t> monitorRouting;     // monitoring output -> input
+    std::vector<char> monitorLocks;
+    int serials = 0;
+    std::vector<uint16_t> serialRouting;      // serial port -> serial port
+    std::vector<char> serialLocks;
+    std::vector<std::string> serialDirections; // "control", "slave" or "auto"
+    std::map<int, std::string> inputLabels;   // only labels changed by clients
+    std::map<int, std::string> outputLabels;
+    std::map<int, std::string> monitorLabels;
+    std::map<int, std::string> serialLabels;
+    bool takeMode = false;                    // CONFIGURATION: Take Mode
+    std::map<std::string, std::string> alarms; // ALARM STATUS; empty = not reported
+    std::vector<size_t> clients;              // indices into the client table
+};
+
+// Brief comment: one client connection to a virtual hub
+struct SimClient {
+    SOCKET sock = INVALID_SOCKET;
+    int hub = -1;
+    std::string in;    // received bytes not yet parsed ('\r' removed)
+    std::string out;   // bytes waiting to be sent
+    size_t outPos = 0; // first unsent byte in out
+    Clock::time_point nextSendAt;   // adversarial: next fragment not before this time
+    Clock::time_point holdUntil;    // adversarial: coalescing window of the pending output
+    bool holding = false;
+};
+
+// Brief comment: command line settings
+struct SimOptions {
+    int hubs = 1;
+    int basePort = 9990;
+    std::string bindIp = "127.0.0.1";
+    std::vector<std::pair<int, int>> sizes{ { 40, 40 } };
+    int churnMs = 0;
+    unsigned seed = 0;
+    int monitors = 0;
+    int serials = 0;
+    int alarmMs = 0;
+    // adversarial network mode
+    int fragment = 0;          // max bytes per send, 0 = off
+    int fragmentDelayMs = 0;   // delay between fragments
+    int coalesceMs = 0;        // hold output so blocks leave together
+    double nakRate = 0.0;      // fraction of valid commands answered with NAK
+};
+
+// Brief comment: running totals for the statistics line
+struct SimStats {
+    long long frontPanelChanges = 0;
+    long long commands = 0;
+    long long bytesOut = 0;
+    long long accepted = 0;
+    long long fragments = 0;
+    long long naks = 0;
+};
+
+std::vector<SimHub> gHubs;
+std::vector<SimClient> gClients;   // closed clients keep sock == INVALID_SOCKET and are reused
+SimStats gStats;
+SimOptions gOpt;
+std::mt19937 gRng;
+
+// --------------------- Protocol text ---------------------
+
+// Brief comment: label of an input/output (changed label or the default)
+std::string SimLabel(const std::map<int, std::string>& overrides, const char* prefix, int idx) {
+    auto it = overrides.find(idx);
+    if (it != overrides.end()) return it->second;
+    return std::string(prefix) + " " + std::to_string(idx + 1);
+}
+
+// Brief comment: the table of a hub a labels / locks / routing block refers to
+struct SimTable {
+    std::vector<uint16_t>* routing = nullptr;    // routing block: entry -> source
+    std::vector<char>* locks = nullptr;          // locks block
+    std::vector<std::string>* words = nullptr;   // directions block
+    std::map<int, std::string>* labels = nullptr; // labels block
+    const char* labelPrefix = "";
+    int count = 0;    // entries; 0 = the hub has no such table
+    int sources = 0;  // valid sources of a routing table
+};
+
+// Brief comment: resolves a block header to the hub table it reads or writes
+SimTable ResolveTable(SimHub& h, const std::string& header) {
+    SimTable t;
+    if (header == "INPUT LABELS") { t.labels = &h.inputLabels; t.labelPrefix = "Input"; t.count = h.inputs; }
+    else if (header == "OUTPUT LABELS") { t.labels = &h.outputLabels; t.labelPrefix = "Output"; t.count = h.outputs; }
+    else if (header == "MONITORING OUTPUT LABELS") { t.labels = &h.monitorLabels; t.labelPrefix = "Monitor"; t.count = h.monitors; }
+    else if (header == "VIDEO OUTPUT LOCKS") { t.locks = &h.locks; t.count = h.outputs; }
+    else if (header == "MONITORING OUTPUT LOCKS") { t.locks = &h.monitorLocks; t.count = h.monitors; }
+    else if (header == "VIDEO OUTPUT ROUTING") { t.routing = &h.routing; t.count = h.outputs; t.sources = h.inputs; }
+    else if (header == "VIDEO MONITORING OUTPUT ROUTING") { t.routing = &h.monitorRouting; t.count = h.monitors; t.sources = h.inputs; }
+    else if (header == "SERIAL PORT LABELS") { t.labels = &h.serialLabels; t.labelPrefix = "Deck"; t.count = h.serials; }
+    else if (header == "SERIAL PORT LOCKS") { t.locks = &h.serialLocks; t.count = h.serials; }
+    else if (header == "SERIAL PORT ROUTING") { t.routing = &h.serialRouting; t.count = h.serials; t.sources = h.serials; }
+    else if (header == "SERIAL PORT DIRECTIONS") { t.words = &h.serialDirections; t.count = h.serials; }
+    return t;
+}
+
+// Brief comment: text of one state block of a hub (header + body + blank line)
+std::string SimBlock(SimHub& h, const std::string& header) {
+    std::ostringstream o;
+    o << header << ":\n";
+    SimTable t = ResolveTable(h, header);
+    if (t.count > 0) {
+        for (int i = 0; i < t.count; ++i) {
+            o << i << " ";
+            if (t.routing) o << (*t.routing)[i];
+            else if (t.locks) o << (*t.locks)[i];
+            else if (t.words) o << (*t.words)[i];
+            else o << SimLabel(*t.labels, t.labelPrefix, i);
+            o << "\n";
+        }
+    }
+    else if (header == "VIDEOHUB DEVICE") {
+        o << "Device present: true\n"
+            << "Model name: Blackmagic Videohub Simulator " << h.inputs << "x" << h.outputs << "\n"
+            << "Friendly name: SimHub " << (h.index + 1) << "\n"
+            << "Unique ID: 5A1B00" << std::setw(6) << std::setfill('0') << h.index << std::setfill(' ') << "\n"
+            << "Video inputs: " << h.inputs << "\n"
+            << "Video processing units: 0\n"
+            << "Video outputs: " << h.outputs << "\n"
+            << "Video monitoring outputs: " << h.monitors << "\n"
+            << "Serial ports: " << h.serials << "\n";
+    }
+    else if (header == "PROTOCOL PREAMBLE") {
+        o << "Version: 2.8\n";
+    }
+    else if (header == "CONFIGURATION") {
+        o << "Take Mode: " << (h.takeMode ? "true" : "false") << "\n";
+    }
+    else if (header == "ALARM STATUS") {
+        for (auto& kv : h.alarms) o << kv.first << ": " << kv.second << "\n";
+    }
+    o << "\n";
+    return o.str();
+}
+
+// Brief comment: full prelude a hub sends to a new client (tables the hub lacks are left out)
+std::string SimPrelude(SimHub& h) {
+    static const char* order[] = {
+        "PROTOCOL PREAMBLE", "VIDEOHUB DEVICE", "INPUT LABELS", "OUTPUT LABELS", "MONITORING OUTPUT LABELS",
+        "SERIAL PORT LABELS", "VIDEO OUTPUT LOCKS", "MONITORING OUTPUT LOCKS", "SERIAL PORT LOCKS",
+        "VIDEO OUTPUT ROUTING", "VIDEO MONITORING OUTPUT ROUTING", "SERIAL PORT ROUTING", "SERIAL PORT DIRECTIONS",
+        "CONFIGURATION", "ALARM STATUS" };
+    std::string text;
+    for (const char* header : order) {
+        if (std::string(header) == "ALARM STATUS" && h.alarms.empty()) continue;
+        SimTable t = ResolveTable(h, header);
+        if ((t.routing || t.locks || t.labels || t.words) && t.count == 0) continue;
+        text += SimBlock(h, header);
+    }
+    return text + "END PRELUDE:\n\n";
+}
+
+// --------------------- Client output ---------------------
+
+// Brief comment: closes a client and removes it from its hub
+void CloseClient(size_t ci) {
+    SimClient& c = gClients[ci];
+    if (c.sock == INVALID_SOCKET) return;
+    closesocket(c.sock);
+    c.sock = INVALID_SOCKET;
+    auto& list = gHubs[c.hub].clients;
+    list.erase(std::remove(list.begin(), list.end(), ci), list.end());
+    c.in.clear();
+    c.out.clear();
+    c.outPos = 0;
+    c.holding = false;
+}
+
+// Brief comment: true when the client has output that may be sent now; else dueAt
+//                tells when it may (adversarial delays)
+bool ClientSendDue(SimClient& c, Clock::time_point now, Clock::time_point& dueAt) {
+    if (c.sock == INVALID_SOCKET || c.outPos >= c.out.size()) return false;
+    if (gOpt.coalesceMs > 0 && !c.holding) {
+        c.holding = true;
+        c.holdUntil = now + std::chrono::milliseconds(gOpt.coalesceMs);
+    }
+    dueAt = std::max(c.nextSendAt, c.holding ? c.holdUntil : Clock::time_point{});
+    return dueAt <= now;
+}
+
+// -----------------------------------------------------------
+// Function: FlushClient
+// Purpose:  Sends as much queued output as the socket takes without
+//           blocking. In adversarial mode the output is cut into
+//           random fragments, spaced by the fragment delay and held
+//           for the coalescing window first.
+// -----------------------------------------------------------
+void FlushClient(size_t ci) {
+    SimClient& c = gClients[ci];
+    Clock::time_point dueAt;
+    auto now = Clock::now();
+    if (!ClientSendDue(c, now, dueAt)) return;
+
+    while (c.sock != INVALID_SOCKET && c.outPos < c.out.size()) {
+        size_t n = c.out.size() - c.outPos;
+        if (gOpt.fragment > 0) n = std::min<size_t>(n, 1 + gRng() % gOpt.fragment);
+        int sent = send(c.sock, c.out.data() + c.outPos, (int)n, 0);
+        if (sent == SOCKET_ERROR) {
+            if (WSAGetLastError() != WSAEWOULDBLOCK) CloseClient(ci);
+            return;
+        }
+        c.outPos += sent;
+        gStats.bytesOut += sent;
+        ++gStats.fragments;
+        if (gOpt.fragmentDelayMs > 0 && c.outPos < c.out.size()) {
+            c.nextSendAt = now + std::chrono::milliseconds(gOpt.fragmentDelayMs);
+            return;
+        }
+    }
+    if (c.outPos == c.out.size()) {
+        c.out.clear();
+        c.outPos = 0;
+        c.holding = false;
+    }
+}
+
+// Brief comment: queues text for one client and tries to send it right away
+void SendToClient(size_t ci, const std::string& text) {
+    gClients[ci].out += text;
+    FlushClient(ci);
+}
+
+// Brief comment: sends a block to every client of a hub (state change notification)
+void Broadcast(SimHub& h, const std::string& text) {
+    auto clients = h.clients; // FlushClient may close (and unlist) a client
+    for (size_t ci : clients) SendToClient(ci, text);
+}
+
+// --------------------- Command handling ---------------------
+
+// -----------------------------------------------------------
+// Function: HandleBlock
+// Purpose:  Executes one command block received from a client.
+// Operation:
+//   - ROUTING / LABELS / LOCKS / DIRECTIONS with body: apply, ACK to the sender,
+//     then broadcast the changed lines to all clients of the hub
+//   - header with empty body: ACK + current block (query)
+//   - PING: ACK
+//   - anything else: NAK; a block with an invalid line is NAKed as a
+//     whole and changes nothing (no line of it is applied or broadcast)
+// -----------------------------------------------------------
+void HandleBlock(size_t ci, const std::string& header, const std::vector<std::string>& lines) {
+    SimHub& h = gHubs[gClients[ci].hub];
+    ++gStats.commands;
+
+    if (header == "PING") {
+        SendToClient(ci, "ACK\n\n");
+        return;
+    }
+
+    SimTable t = ResolveTable(h, header);
+    bool known = t.count > 0;
+    bool query = lines.empty() && (known || header == "VIDEOHUB DEVICE" ||
+        header == "PROTOCOL PREAMBLE" || header == "CONFIGURATION" || (header == "ALARM STATUS" && !h.alarms.empty()));
+    if (query) {
+        SendToClient(ci, "ACK\n\n" + SimBlock(h, header));
+        return;
+    }
+    if (header == "CONFIGURATION") {
+        for (auto& line : lines) {
+            if (line != "Take Mode: true" && line != "Take Mode: false") {
+                SendToClient(ci, "NAK\n\n");
+                return;
+            }
+            h.takeMode = (line == "Take Mode: true");
+        }
+        SendToClient(ci, "ACK\n\n");
+        Broadcast(h, SimBlock(h, header));
+        return;
+    }
+    if (!known) {
+        SendToClient(ci, "NAK\n\n");
+        return;
+    }
+    if (gOpt.nakRate > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(gRng) < gOpt.nakRate) {
+        ++gStats.naks;
+        SendToClient(ci, "NAK\n\n"); // injected: the command is not applied
+        return;
+    }
+
+    // check every line first: like a real hub, a NAKed block changes nothing
+    std::vector<std::pair<int, std::string>> parsed;   // port, value
+    for (auto& line : lines) {
+        std::istringstream iss(line);
+        int idx;
+        std::string value;
+        if (!(iss >> idx) || idx < 0 || idx >= t.count) { SendToClient(ci, "NAK\n\n"); return; }
+        if (t.routing) {
+            int in;
+            if (!(iss >> in) || in < 0 || in >= t.sources) {
+                SendToClient(ci, "NAK\n\n");
+                return;
+            }
+            value = std::to_string(in);
+        }
+        else if (t.locks) {
+            if (!(iss >> value)) { SendToClient(ci, "NAK\n\n"); return; }
+        }
+        else if (t.words) {
+            if (!(iss >> value) || (value != "control" && value != "slave" && value != "auto")) {
+                SendToClient(ci, "NAK\n\n");
+                return;
+            }
+        }
+        else {
+            std::getline(iss, value);
+            if (!value.empty() && value[0] == ' ') value.erase(0, 1);
+        }
+        parsed.emplace_back(idx, value);
+    }
+
+    std::ostringstream changed;
+    for (auto& p : parsed) {
+        int idx = p.first;
+        if (t.routing) {
+            (*t.routing)[idx] = static_cast<uint16_t>(std::stoi(p.second));
+            changed << idx << " " << p.second << "\n";
+        }
+        else if (t.locks) {
+            (*t.locks)[idx] = (p.second == "O" || p.second == "L") ? 'L' : 'U';
+            changed << idx << " " << (*t.locks)[idx] << "\n";
+        }
+        else if (t.words) {
+            (*t.words)[idx] = p.second;
+            changed << idx << " " << p.second << "\n";
+        }
+        else {
+            (*t.labels)[idx] = p.second;
+            changed << idx << " " << p.second << "\n";
+        }
+    }
+
+    SendToClient(ci, "ACK\n\n");
+    Broadcast(h, header + ":\n" + changed.str() + "\n");
+}
+
+// Brief comment: splits the client's input into blocks and handles each complete one
+void ProcessClientInput(size_t ci) {
+    while (gClients[ci].sock != INVALID_SOCKET) {
+        std::string& in = gClients[ci].in;
+        size_t start = in.find_first_not_of('\n');
+        if (start == std::string::npos) { in.clear(); return; }
+        size_t end = in.find("\n\n", start);
+        if (end == std::string::npos) {
+            in.erase(0, start);
+            return;
+        }
+
+        std::istringstream iss(in.substr(start, end - start));
+        in.erase(0, end + 2);
+        std::string header, line;
+        std::getline(iss, header);
+        if (!header.empty() && header.back() == ':') header.pop_back();
+        std::vector<std::string> lines;
+        while (std::getline(iss, line)) lines.push_back(line);
+        HandleBlock(ci, header, lines);
+    }
+}
+
+// --------------------- Setup ---------------------
+
+// Brief comment: parses "40x40" into (inputs, outputs)
+bool ParseSize(const std::string& s, std::pair<int, int>& out) {
+    size_t x = s.find_first_of("xX");
+    if (x == std::string::npos) return false;
+    try {
+        out.first = std::stoi(s.substr(0, x));
+        out.second = std::stoi(s.substr(x + 1));
+    }
+    catch (...) { return false; }
+    return out.first > 0 && out.second > 0 && out.first <= 4096 && out.second <= 4096;
+}
+
+// Brief comment: reads the command line; false (after printing usage) on errors
+bool ParseOptions(int argc, char* argv[], SimOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto value = [&]() -> std::string { return (i + 1 < argc) ? argv[++i] : ""; };
+        try {
+            if (a == "--hubs") opt.hubs = std::stoi(value());
+            else if (a == "--base-port") opt.basePort = std::stoi(value());
+            else if (a == "--bind") opt.bindIp = value();
+            else if (a == "--churn") opt.churnMs = std::stoi(value());
+            else if (a == "--seed") opt.seed = static_cast<unsigned>(std::stoul(value()));
+            else if (a == "--monitor") opt.monitors = std::stoi(value());
+            else if (a == "--serial") opt.serials = std::stoi(value());
+            else if (a == "--alarms") opt.alarmMs = std::stoi(value());
+            else if (a == "--fragment") opt.fragment = std::stoi(value());
+            else if (a == "--fragment-delay") opt.fragmentDelayMs = std::stoi(value());
+            else if (a == "--coalesce") opt.coalesceMs = std::stoi(value());
+            else if (a == "--nak-rate") opt.nakRate = std::stod(value());
+            else if (a == "--size") {
+                opt.sizes.clear();
+                std::istringstream iss(value());
+                std::string part;
+                while (std::getline(iss, part, ',')) {
+                    std::pair<int, int> sz;
+                    if (!ParseSize(part, sz)) throw std::invalid_argument(part);
+                    opt.sizes.push_back(sz);
+                }
+                if (opt.sizes.empty()) throw std::invalid_argument("size");
+            }
+            else throw std::invalid_argument(a);
+        }
+        catch (...) {
+            std::cerr << "Invalid argument: " << a << "\n"
+                << "Usage: VideoHubSim [--hubs N] [--base-port P] [--bind IP] [--size 40x40[,12x12...]]\n"
+                << "                   [--churn MS] [--seed S] [--monitor N] [--serial N] [--alarms MS]\n"
+                << "                   [--fragment N] [--fragment-delay MS] [--coalesce MS] [--nak-rate P]\n";
+            return false;
+        }
+    }
+    if (opt.fragment < 0 || opt.fragmentDelayMs < 0 || opt.coalesceMs < 0 || opt.nakRate < 0 || opt.nakRate > 1) {
+        std::cerr << "Invalid adversarial network settings.\n";
+        return false;
+    }
+    if (opt.monitors < 0 || opt.monitors > 4096) {
+        std::cerr << "Invalid monitoring output count.\n";
+        return false;
+    }
+    if (opt.alarmMs < 0) {
+        std::cerr << "Invalid alarm interval.\n";
+        return false;
+    }
+    if (opt.serials < 0 || opt.serials > 4096) {
+        std::cerr << "Invalid serial port count.\n";
+        return false;
+    }
+    if (opt.hubs < 1 || opt.basePort < 1 || opt.basePort + opt.hubs - 1 > 65535) {
+        std::cerr << "Invalid hub count / port range.\n";
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------
+// Function: CreateHubs
+// Purpose:  Creates the virtual hubs and their listening sockets.
+// Return:   false when a port cannot be bound
+// -----------------------------------------------------------
+bool CreateHubs(const SimOptions& opt) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    if (inet_pton(AF_INET, opt.bindIp.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Invalid bind address: " << opt.bindIp << "\n";
+        return false;
+    }
+
+    gHubs.resize(opt.hubs);
+    for (int i = 0; i < opt.hubs; ++i) {
+        SimHub& h = gHubs[i];
+        h.index = i;
+        h.port = opt.basePort + i;
+        h.inputs = opt.sizes[i % opt.sizes.size()].first;
+        h.outputs = opt.sizes[i % opt.sizes.size()].second;
+        h.routing.resize(h.outputs);
+        for (int o = 0; o < h.outputs; ++o) h.routing[o] = static_cast<uint16_t>(o % h.inputs);
+        h.locks.assign(h.outputs, 'U');
+        h.monitors = opt.monitors;
+        h.monitorRouting.resize(h.monitors);
+        for (int o = 0; o < h.monitors; ++o) h.monitorRouting[o] = static_cast<uint16_t>(o % h.inputs);
+        h.monitorLocks.assign(h.monitors, 'U');
+        h.serials = opt.serials;
+        h.serialRouting.resize(h.serials);
+        for (int p = 0; p < h.serials; ++p) // ports routed in pairs (0 <-> 1, 2 <-> 3, ...)
+            h.serialRouting[p] = static_cast<uint16_t>((p ^ 1) < h.serials ? (p ^ 1) : p);
+        h.serialLocks.assign(h.serials, 'U');
+        h.serialDirections.assign(h.serials, "auto");
+        if (opt.alarmMs > 0)
+            h.alarms = { { "Fan 1", "ok" }, { "Fan 2", "ok" }, { "Power supply 1", "ok" },
+                { "Power supply 2", "ok" }, { "Temperature", "ok" } };
+
+        h.listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (h.listener == INVALID_SOCKET) {
+            std::cerr << "Cannot create socket for hub " << (i + 1) << "\n";
+            return false;
+        }
+        addr.sin_port = htons(static_cast<u_short>(h.port));
+        if (bind(h.listener, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+            listen(h.listener, 16) == SOCKET_ERROR) {
+            std::cerr << "Cannot listen on " << opt.bindIp << ":" << h.port << "\n";
+            return false;
+        }
+        u_long nonBlocking = 1;
+        ioctlsocket(h.listener, FIONBIO, &nonBlocking);
+    }
+    return true;
+}
+
+// Brief comment: accepts all pending connections of a hub
+void AcceptClients(SimHub& h) {
+    while (true) {
+        SOCKET s = accept(h.listener, NULL, NULL);
+        if (s == INVALID_SOCKET) return;
+        u_long nonBlocking = 1;
+        ioctlsocket(s, FIONBIO, &nonBlocking);
+        int noDelay = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+        size_t ci = 0;
+        while (ci < gClients.size() && gClients[ci].sock != INVALID_SOCKET) ++ci;
+        if (ci == gClients.size()) gClients.emplace_back();
+        gClients[ci].sock = s;
+        gClients[ci].hub = h.index;
+        h.clients.push_back(ci);
+        ++gStats.accepted;
+        SendToClient(ci, SimPrelude(h));
+    }
+}
+
+// Brief comment: reads what a client sent and handles complete blocks
+void ReadClient(size_t ci) {
+    char buf[8192];
+    while (gClients[ci].sock != INVALID_SOCKET) {
+        int rec = recv(gClients[ci].sock, buf, (int)sizeof(buf), 0);
+        if (rec == 0 || (rec == SOCKET_ERROR && WSAGetLastError() != WSAEWOULDBLOCK)) {
+            CloseClient(ci);
+            return;
+        }
+        if (rec == SOCKET_ERROR) break;
+        for (int i = 0; i < rec; ++i)
+            if (buf[i] != '\r') gClients[ci].in.push_back(buf[i]);
+    }
+    ProcessClientInput(ci);
+}
+
+// --------------------- MAIN ---------------------
+int main(int argc, char* argv[]) {
+    SimOptions& opt = gOpt;
+    if (!ParseOptions(argc, argv, opt)) return 1;
+
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+    if (!CreateHubs(opt)) {
+        WSACleanup();
+        return 1;
+    }
+
+    gRng.seed(opt.seed ? opt.seed : static_cast<unsigned>(Clock::now().time_since_epoch().count()));
+    std::mt19937& rng = gRng;
+
+    // front-panel changes: min-heap of (due time, hub) so only due hubs are touched
+    using Due = std::pair<Clock::time_point, int>;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> churn;
+    std::exponential_distribution<double> interval(opt.churnMs > 0 ? 1.0 / opt.churnMs : 1.0);
+    auto nextChange = [&]() { return Clock::now() + std::chrono::microseconds(static_cast<long long>(interval(rng) * 1000.0)); };
+    if (opt.churnMs > 0)
+        for (int i = 0; i < opt.hubs; ++i) churn.push({ nextChange(), i });
+
+    // alarm flips: same scheme, not pushed to clients
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> alarmFlips;
+    std::exponential_distribution<double> alarmInterval(opt.alarmMs > 0 ? 1.0 / opt.alarmMs : 1.0);
+    auto nextFlip = [&]() { return Clock::now() + std::chrono::microseconds(static_cast<long long>(alarmInterval(rng) * 1000.0)); };
+    if (opt.alarmMs > 0)
+        for (int i = 0; i < opt.hubs; ++i) alarmFlips.push({ nextFlip(), i });
+
+    std::cout << "--- Videohub Simulator --- " << version << "\n"
+        << opt.hubs << " hub(s) on " << opt.bindIp << ":" << opt.basePort << "-" << (opt.basePort + opt.hubs - 1)
+        << ", front-panel churn " << (opt.churnMs > 0 ? std::to_string(opt.churnMs) + " ms mean" : std::string("off"))
+        << "\n";
+    if (opt.fragment || opt.fragmentDelayMs || opt.coalesceMs || opt.nakRate > 0)
+        std::cout << "Adversarial network: fragment " << opt.fragment << " B, fragment delay " << opt.fragmentDelayMs
+        << " ms, coalesce " << opt.coalesceMs << " ms, NAK rate " << opt.nakRate << "\n";
+    std::cout << "Press any key to stop.\n";
+
+    std::vector<WSAPOLLFD> fds;
+    std::vector<size_t> fdClient; // client index per fd behind the listeners
+    auto nextStats = Clock::now() + std::chrono::seconds(5);
+    SimStats last;
+
+    while (!_kbhit()) {
+        // one poll over all listeners and clients
+        fds.clear();
+        fdClient.clear();
+        auto pollStart = Clock::now();
+        Clock::time_point wakeAt = pollStart + std::chrono::milliseconds(50);
+        if (!churn.empty()) wakeAt = std::min(wakeAt, churn.top().first);
+        if (!alarmFlips.empty()) wakeAt = std::min(wakeAt, alarmFlips.top().first);
+        for (auto& h : gHubs) fds.push_back({ h.listener, POLLRDNORM, 0 });
+        for (size_t ci = 0; ci < gClients.size(); ++ci) {
+            if (gClients[ci].sock == INVALID_SOCKET) continue;
+            short events = POLLRDNORM;
+            Clock::time_point dueAt;
+            if (ClientSendDue(gClients[ci], pollStart, dueAt)) events |= POLLWRNORM;
+            else if (gClients[ci].outPos < gClients[ci].out.size()) wakeAt = std::min(wakeAt, dueAt);
+            fds.push_back({ gClients[ci].sock, events, 0 });
+            fdClient.push_back(ci);
+        }
+
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - pollStart).count();
+        int timeoutMs = static_cast<int>(std::max<long long>(0, wait));
+        int ready = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeoutMs);
+
+        if (ready > 0) {
+            for (size_t i = 0; i < gHubs.size(); ++i)
+                if (fds[i].revents & POLLRDNORM) AcceptClients(gHubs[i]);
+            for (size_t k = 0; k < fdClient.size(); ++k) {
+                short re = fds[gHubs.size() + k].revents;
+                size_t ci = fdClient[k];
+                if (re & POLLWRNORM) FlushClient(ci);
+                if (re & (POLLRDNORM | POLLERR | POLLHUP)) ReadClient(ci);
+            }
+        }
+
+        // delayed adversarial output that became due while polling
+        auto now = Clock::now();
+        for (size_t ci = 0; ci < gClients.size(); ++ci) {
+            Clock::time_point dueAt;
+            if (ClientSendDue(gClients[ci], now, dueAt)) FlushClient(ci);
+        }
+
+        // due front-panel changes
+        while (!churn.empty() && churn.top().first <= now) {
+            SimHub& h = gHubs[churn.top().second];
+            churn.pop();
+            int out = static_cast<int>(rng() % h.outputs);
+            int in = static_cast<int>(rng() % h.inputs);
+            h.routing[out] = static_cast<uint16_t>(in);
+            ++gStats.frontPanelChanges;
+            if (!h.clients.empty())
+                Broadcast(h, "VIDEO OUTPUT ROUTING:\n" + std::to_string(out) + " " + std::to_string(in) + "\n\n");
+            churn.push({ nextChange(), h.index });
+        }
+
+        // due alarm flips (ok <-> fail / high)
+        while (!alarmFlips.empty() && alarmFlips.top().first <= now) {
+            SimHub& h = gHubs[alarmFlips.top().second];
+            alarmFlips.pop();
+            auto it = std::next(h.alarms.begin(), static_cast<long>(rng() % h.alarms.size()));
+            it->second = it->second != "ok" ? "ok" : it->first == "Temperature" ? "high" : "fail";
+            alarmFlips.push({ nextFlip(), h.index });
+        }
+
+        if (now >= nextStats) {
+            nextStats = now + std::chrono::seconds(5);
+            size_t connected = 0;
+            for (auto& c : gClients) if (c.sock != INVALID_SOCKET) ++connected;
+            std::cout << "clients " << connected
+                << " | front-panel changes/s " << (gStats.frontPanelChanges - last.frontPanelChanges) / 5
+                << " | commands/s " << (gStats.commands - last.commands) / 5
+                << " | KB/s out " << (gStats.bytesOut - last.bytesOut) / 5 / 1024
+                << " | sends/s " << (gStats.fragments - last.fragments) / 5
+                << " | NAKs injected " << gStats.naks
+                << "\n";
+            last = gStats;
+        }
+    }
+    _getch();
+
+    for (size_t ci = 0; ci < gClients.size(); ++ci) CloseClient(ci);
+    for (auto& h : gHubs) closesocket(h.listener);
+    WSACleanup();
+    std::cout << "Simulator stopped.\n";
+    return 0;
+}